@@ -0,0 +1,61 @@
+#ifndef HYBIRT_BENCH_UTILS_HPP
+#define HYBIRT_BENCH_UTILS_HPP
+
+#include "vecfield.hpp"
+#include "gridlayout.hpp"
+#include "interpolator.hpp"
+#include "particle.hpp"
+#include "timers.hpp"
+
+#include <array>
+#include <cstddef>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// parses "1,2,4" into {1, 2, 4}
+inline std::vector<std::size_t> parse_list(std::string const& arg)
+{
+    std::vector<std::size_t> values;
+    std::stringstream stream{arg};
+    std::string item;
+    while (std::getline(stream, item, ','))
+        values.push_back(std::stoul(item));
+    if (values.empty())
+        throw std::runtime_error("empty list: " + arg);
+    return values;
+}
+
+
+
+// The Boris rotation is still a TODO in pusher.hpp, timing the pusher would time an empty
+// loop. The benchmarks time the gather instead, the part of the push that reads the fields:
+// E and B interpolated at every particle.
+inline constexpr char const* push_note
+    = "the Boris pusher is not implemented (pusher.hpp): no push is timed, the gather "
+      "phase interpolates E and B at the particles as the push will";
+
+template<std::size_t dimension>
+void gather_fields(ParticleArray<dimension> const& particles, VecField<dimension> const& E,
+                   VecField<dimension> const& B, GridLayout<dimension> const& layout,
+                   std::vector<std::array<double, 6>>& at_particles)
+{
+    HYBIRT_TIME_SCOPE("gather");
+    at_particles.resize(particles.size());
+    auto const nbr_particles = static_cast<std::ptrdiff_t>(particles.size());
+
+#pragma omp parallel for
+    for (std::ptrdiff_t iPart = 0; iPart < nbr_particles; ++iPart)
+    {
+        auto const& position = particles[iPart].position;
+        auto const at        = [&](Field<dimension> const& field) {
+            return interpolate<interp_order>(field, layout, position);
+        };
+        at_particles[iPart] = {at(E.x), at(E.y), at(E.z), at(B.x), at(B.y), at(B.z)};
+    }
+}
+
+
+#endif // HYBIRT_BENCH_UTILS_HPP
@@ -0,0 +1,263 @@
+// kernel micro-benchmarks
+//
+//   hybirt-bench --nx 100,1000 --ppc 10,100 --threads 1,2,4 --repeat 10 --output bench.json
+//
+// every kernel is run `repeat` times for each (nx, ppc, threads) combination and reported
+// as JSON with particles/s, cells/s and an estimate of the bytes/s it moves.
+// The estimate counts the minimal traffic of each kernel (particles and fields read and
+// written once), it is a lower bound on what the memory system actually does.
+// There is no push kernel until the Boris pusher is implemented, see push_note.
+
+#include "vecfield.hpp"
+#include "field.hpp"
+#include "ampere.hpp"
+#include "ohm.hpp"
+#include "gridlayout.hpp"
+#include "boundary_condition.hpp"
+#include "filter.hpp"
+#include "moments.hpp"
+#include "diagnostics.hpp"
+#include "population.hpp"
+#include "parallel.hpp"
+
+#include "bench_utils.hpp"
+
+#include "highfive/highfive.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+struct BenchOptions
+{
+    std::vector<std::size_t> nx{100, 1000};
+    std::vector<std::size_t> ppc{100};
+    std::vector<std::size_t> threads{1};
+    std::size_t repeat = 10;
+    std::string output{"bench.json"};
+};
+
+
+struct BenchResult
+{
+    std::string kernel;
+    std::size_t nx;
+    std::size_t ppc;
+    std::size_t threads;
+    std::vector<double> seconds;
+    double particles; // per call
+    double cells;     // per call
+    double bytes;     // per call, estimated
+};
+
+
+BenchOptions parse_options(int argc, char** argv)
+{
+    BenchOptions options;
+    options.threads = {static_cast<std::size_t>(max_threads())};
+
+    for (int iArg = 1; iArg < argc; ++iArg)
+    {
+        std::string const key = argv[iArg];
+        if (iArg + 1 >= argc)
+            throw std::runtime_error("missing value for " + key);
+        std::string const value = argv[++iArg];
+
+        if (key == "--nx")
+            options.nx = parse_list(value);
+        else if (key == "--ppc")
+            options.ppc = parse_list(value);
+        else if (key == "--threads")
+            options.threads = parse_list(value);
+        else if (key == "--repeat")
+            options.repeat = std::stoul(value);
+        else if (key == "--output")
+            options.output = value;
+        else
+            throw std::runtime_error("unknown option " + key);
+    }
+
+    if (options.repeat == 0)
+        throw std::runtime_error("--repeat must be at least 1");
+    return options;
+}
+
+
+template<typename Kernel>
+std::vector<double> time_kernel(std::size_t repeat, Kernel&& kernel)
+{
+    std::vector<double> seconds;
+    seconds.reserve(repeat);
+    for (auto iRepeat = 0u; iRepeat < repeat; ++iRepeat)
+    {
+        auto const start = std::chrono::steady_clock::now();
+        kernel(iRepeat);
+        auto const stop = std::chrono::steady_clock::now();
+        seconds.push_back(std::chrono::duration<double>(stop - start).count());
+    }
+    return seconds;
+}
+
+
+void run_case(std::size_t nx, std::size_t ppc, std::size_t threads, std::size_t repeat,
+              std::vector<BenchResult>& results)
+{
+    std::size_t constexpr dimension = 1;
+    set_threads(static_cast<int>(threads));
+
+    std::array<std::size_t, dimension> grid_size = {nx};
+    std::array<double, dimension> cell_size      = {0.2};
+    auto constexpr nbr_ghosts                    = Shape<interp_order>::nbr_ghosts;
+    auto layout = std::make_shared<GridLayout<dimension>>(grid_size, cell_size, nbr_ghosts);
+
+    VecField<dimension> E{layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
+    VecField<dimension> B{layout, {Quantity::Bx, Quantity::By, Quantity::Bz}};
+    VecField<dimension> J{layout, {Quantity::Jx, Quantity::Jy, Quantity::Jz}};
+    VecField<dimension> V{layout, {Quantity::Vx, Quantity::Vy, Quantity::Vz}};
+    Field<dimension> N{layout->allocate(Quantity::N), Quantity::N};
+    for (auto& n : N)
+        n = 1.0;
+
+    auto boundary_condition = BoundaryConditionFactory<dimension>::create("periodic", layout);
+    auto const uniform      = [](double) { return 1.0; };
+
+    std::vector<Population<dimension>> populations;
+    populations.emplace_back("main", layout);
+    populations[0].load_particles(ppc, uniform);
+    auto& particles = populations[0].particles();
+
+    Ampere<dimension> ampere{layout};
+    Ohm<dimension> ohm{layout};
+
+    double const nbr_particles = particles.size();
+    double const nbr_cells     = nx;
+    double const node_bytes    = (nx + 2 * nbr_ghosts + 1) * sizeof(double);
+    double const part_bytes    = sizeof(Particle<dimension>);
+
+    auto add = [&](std::string kernel, std::vector<double> seconds, double part, double cells,
+                   double bytes) {
+        results.push_back({kernel, nx, ppc, threads, seconds, part, cells, bytes});
+    };
+
+    // 6 values written per particle
+    std::vector<std::array<double, 6>> at_particles;
+    add("gather", time_kernel(repeat, [&](auto) {
+            gather_fields(particles, E, B, *layout, at_particles);
+        }),
+        nbr_particles, 0, nbr_particles * (part_bytes + 6 * sizeof(double)) + 6 * node_bytes);
+
+    add("particle_bc",
+        time_kernel(repeat, [&](auto) { boundary_condition->particles(particles); }),
+        nbr_particles, 0, 2 * nbr_particles * part_bytes);
+
+    add("deposit", time_kernel(repeat, [&](auto) { populations[0].deposit(); }), nbr_particles,
+        nbr_cells, nbr_particles * part_bytes + 4 * node_bytes);
+
+    // ghost nodes are read and written on both sides of the 3 components
+    add("field_bc_fill", time_kernel(repeat, [&](auto) { boundary_condition->fill(E); }), 0, 0,
+        3 * 2 * 2 * (nbr_ghosts + 1) * sizeof(double));
+
+    add("ampere", time_kernel(repeat, [&](auto) { ampere(B, J); }), 0, nbr_cells,
+        6 * node_bytes);
+
+    add("ohm", time_kernel(repeat, [&](auto) { ohm(B, J, N, V, E); }), 0, nbr_cells,
+        13 * node_bytes);
+
+    // two passes and the compensation on each component, a copy and a write per pass
+    BinomialFilter<dimension> filter{layout, 2, true};
+    add("binomial_filter", time_kernel(repeat, [&](auto) { filter(J, *boundary_condition); }), 0,
+        nbr_cells, 3 * 3 * 4 * node_bytes);
+
+    add("total_density", time_kernel(repeat, [&](auto) { total_density(populations, N); }), 0,
+        nbr_cells, (populations.size() + 1) * node_bytes);
+
+    add("bulk_velocity",
+        time_kernel(repeat, [&](auto) { bulk_velocity<dimension>(populations, N, V); }), 0,
+        nbr_cells, (3 * populations.size() + 1 + 3) * node_bytes);
+
+    // every population straight into N and V, then the division: the whole particle to bulk
+    // velocity path, to compare with deposit + total_density + bulk_velocity per population
+    add("single_pass_moments", time_kernel(repeat, [&](auto) {
+            accumulate_moments(populations, N, V);
+            finalize_moments(N, V);
+        }),
+        nbr_particles, nbr_cells, nbr_particles * part_bytes + (4 + 4 + 3) * node_bytes);
+
+    add("load_particles", time_kernel(repeat, [&](auto) {
+            Population<dimension> pop{"load", layout};
+            pop.load_particles(ppc, uniform);
+        }),
+        nbr_particles, nbr_cells, nbr_particles * part_bytes);
+
+    // written to the temporary directory, not to where the benchmark runs
+    auto const prefix = (std::filesystem::temp_directory_path() / "hybirt_bench_").string();
+    add("diags_write_fields", time_kernel(repeat, [&](auto iRepeat) {
+            auto const mode = iRepeat == 0 ? HighFive::File::Truncate : HighFive::File::ReadWrite;
+            diags_write_fields(B, E, V, N, static_cast<double>(iRepeat), mode, prefix);
+        }),
+        0, nbr_cells, 10 * node_bytes);
+}
+
+
+void write_json(std::ostream& out, BenchOptions const& options,
+                std::vector<BenchResult> const& results)
+{
+    out << "{\n  \"note\": \"" << push_note << "\",\n"
+        << "  \"max_threads\": " << max_threads() << ",\n"
+        << "  \"repeat\": " << options.repeat << ",\n  \"results\": [\n";
+
+    for (auto iResult = 0u; iResult < results.size(); ++iResult)
+    {
+        auto const& result = results[iResult];
+        auto const min     = *std::min_element(result.seconds.begin(), result.seconds.end());
+        double mean        = 0.;
+        for (auto const s : result.seconds)
+            mean += s;
+        mean /= result.seconds.size();
+
+        // rates are computed from the fastest repetition
+        auto const rate = [min](double per_call) { return min > 0 ? per_call / min : 0.; };
+
+        out << "    {\"kernel\": \"" << result.kernel << "\", \"nx\": " << result.nx
+            << ", \"ppc\": " << result.ppc << ", \"threads\": " << result.threads
+            << ", \"seconds_min\": " << min << ", \"seconds_mean\": " << mean
+            << ", \"particles_per_s\": " << rate(result.particles)
+            << ", \"cells_per_s\": " << rate(result.cells)
+            << ", \"bytes_per_s\": " << rate(result.bytes) << "}"
+            << (iResult + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+}
+
+
+int main(int argc, char** argv)
+{
+    auto const options = parse_options(argc, argv);
+    std::cerr << "note: " << push_note << "\n";
+
+    std::vector<BenchResult> results;
+    for (auto const threads : options.threads)
+        for (auto const nx : options.nx)
+            for (auto const ppc : options.ppc)
+            {
+                std::cerr << "bench nx=" << nx << " ppc=" << ppc << " threads=" << threads
+                          << "\n";
+                run_case(nx, ppc, threads, options.repeat, results);
+            }
+
+    std::ofstream out{options.output};
+    write_json(out, options, results);
+    std::cerr << "results written to " << options.output << "\n";
+
+    return 0;
+}
@@ -0,0 +1,307 @@
+// strong and weak scaling driver
+//
+//   hybirt-scaling --mode strong --threads 1,2,4,8 --nx 1000 --ppc 100 --steps 50
+//   hybirt-scaling --mode weak   --threads 1,2,4,8 --nx 1000 --ppc 100 --steps 50
+//   hybirt-scaling --mode strong --threads 1,2,4,8 --nx 1000 --ppc 100 --patches 16
+//   hybirt-scaling --mode strong --threads 1,2,4,8 --patches 16 --beam 0.25 --balance-every 10
+//
+// runs `steps` steps for every (nx, ppc) and thread count. In strong mode the problem is
+// the same for every thread count, in weak mode the domain holds nx cells per thread.
+// Time per step, speedup and efficiency with respect to the first thread count of the
+// sweep, and the per-phase wall time per step, the longest over the threads (when built with
+// HYBIRT_TIMERS), go to a CSV file.
+// With --patches the domain is split into that many patches processed as parallel tasks.
+// --beam f adds a beam population over the first fraction f of the domain, holding as many
+// particles as the main one there, and --balance-every n rebalances the patches every n steps
+// if their costs differ by more than 10%.
+// Steps gather E and B at the particles in place of the push until the Boris pusher is
+// implemented, see push_note.
+
+#include "vecfield.hpp"
+#include "field.hpp"
+#include "ampere.hpp"
+#include "ohm.hpp"
+#include "gridlayout.hpp"
+#include "boundary_condition.hpp"
+#include "moments.hpp"
+#include "population.hpp"
+#include "parallel.hpp"
+#include "patch.hpp"
+#include "timers.hpp"
+
+#include "bench_utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+struct ScalingOptions
+{
+    std::string mode{"strong"};
+    std::vector<std::size_t> threads{1};
+    std::vector<std::size_t> nx{1000};
+    std::vector<std::size_t> ppc{100};
+    std::size_t steps   = 20;
+    std::size_t patches       = 0;  // 0 runs on a single layout
+    double beam               = 0.; // fraction of the domain covered by a beam, with patches
+    std::size_t balance_every = 0;  // 0 never balances the patches
+    std::string output{"scaling.csv"};
+};
+
+
+struct ScalingRun
+{
+    std::size_t threads;
+    std::size_t nx;
+    std::size_t ppc;
+    double seconds_per_step;
+    std::map<std::string, double> phases; // wall seconds per step
+};
+
+
+ScalingOptions parse_options(int argc, char** argv)
+{
+    ScalingOptions options;
+    for (int iArg = 1; iArg < argc; ++iArg)
+    {
+        std::string const key = argv[iArg];
+        if (iArg + 1 >= argc)
+            throw std::runtime_error("missing value for " + key);
+        std::string const value = argv[++iArg];
+
+        if (key == "--mode")
+            options.mode = value;
+        else if (key == "--threads")
+            options.threads = parse_list(value);
+        else if (key == "--nx")
+            options.nx = parse_list(value);
+        else if (key == "--ppc")
+            options.ppc = parse_list(value);
+        else if (key == "--steps")
+            options.steps = std::stoul(value);
+        else if (key == "--patches")
+            options.patches = std::stoul(value);
+        else if (key == "--beam")
+            options.beam = std::stod(value);
+        else if (key == "--balance-every")
+            options.balance_every = std::stoul(value);
+        else if (key == "--output")
+            options.output = value;
+        else
+            throw std::runtime_error("unknown option " + key);
+    }
+    if (options.mode != "strong" and options.mode != "weak")
+        throw std::runtime_error("--mode must be strong or weak");
+    if (options.steps == 0)
+        throw std::runtime_error("--steps must be at least 1");
+    return options;
+}
+
+
+ScalingRun timed_run(std::size_t nx, std::size_t ppc, std::size_t threads, std::size_t steps,
+                     auto&& step)
+{
+    Timers::instance().reset();
+    auto const start = std::chrono::steady_clock::now();
+
+    for (auto iStep = 0u; iStep < steps; ++iStep)
+        step();
+
+    auto const stop    = std::chrono::steady_clock::now();
+    auto const seconds = std::chrono::duration<double>(stop - start).count();
+
+    ScalingRun result{threads, nx, ppc, seconds / steps, {}};
+
+    auto const stats      = Timers::instance().summary();
+    auto const wall_times = Timers::instance().wall_times();
+    auto const& phases    = Timers::instance().phases();
+    for (auto iPhase = 0u; iPhase < stats.size(); ++iPhase)
+        if (stats[iPhase].count > 0)
+            result.phases[phases[iPhase]] = 1e-9 * wall_times[iPhase] / steps;
+
+    return result;
+}
+
+
+// times `steps` steps made of the kernels of the main loop
+ScalingRun run(std::size_t nx, std::size_t ppc, std::size_t threads, std::size_t steps)
+{
+    std::size_t constexpr dimension = 1;
+    set_threads(static_cast<int>(threads));
+
+    std::array<std::size_t, dimension> grid_size = {nx};
+    std::array<double, dimension> cell_size      = {0.2};
+    auto constexpr nbr_ghosts                    = Shape<interp_order>::nbr_ghosts;
+    auto layout = std::make_shared<GridLayout<dimension>>(grid_size, cell_size, nbr_ghosts);
+
+    VecField<dimension> E{layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
+    VecField<dimension> B{layout, {Quantity::Bx, Quantity::By, Quantity::Bz}};
+    VecField<dimension> J{layout, {Quantity::Jx, Quantity::Jy, Quantity::Jz}};
+    VecField<dimension> V{layout, {Quantity::Vx, Quantity::Vy, Quantity::Vz}};
+    Field<dimension> N{layout->allocate(Quantity::N), Quantity::N};
+
+    auto boundary_condition = BoundaryConditionFactory<dimension>::create("periodic", layout);
+
+    std::vector<Population<dimension>> populations;
+    populations.emplace_back("main", layout);
+    populations[0].load_particles(ppc, [](double) { return 1.0; });
+
+    Ampere<dimension> ampere{layout};
+    Ohm<dimension> ohm{layout};
+    std::vector<std::array<double, 6>> at_particles;
+
+    return timed_run(nx, ppc, threads, steps, [&]() {
+        for (auto& pop : populations)
+        {
+            gather_fields(pop.particles(), E, B, *layout, at_particles);
+            boundary_condition->particles(pop.particles());
+            pop.deposit();
+            boundary_condition->fill(pop.flux());
+            boundary_condition->fill(pop.density());
+        }
+        total_density(populations, N);
+        bulk_velocity<dimension>(populations, N, V);
+
+        ampere(B, J);
+        boundary_condition->fill(J);
+        ohm(B, J, N, V, E);
+        boundary_condition->fill(E);
+    });
+}
+
+
+// same step on a domain split into patches, each phase runs over the patches in parallel
+ScalingRun run_patches(std::size_t nx, std::size_t ppc, std::size_t threads, std::size_t steps,
+                       ScalingOptions const& options)
+{
+    std::size_t constexpr dimension = 1;
+    set_threads(static_cast<int>(threads));
+
+    PatchLevel<dimension> level{nx, 0.2, Shape<interp_order>::nbr_ghosts, options.patches,
+                                {"main", "beam"}};
+    level.load_particles(0, ppc, [](double) { return 1.0; });
+
+    // the beam goes in the patches starting in the first beam fraction of the domain
+    auto const beam_end = options.beam * nx * 0.2;
+    level.for_each_patch([&](auto& patch) {
+        if (patch.origin[0] < beam_end)
+            patch.populations[1].load_particles(ppc, [](double) { return 1.0; },
+                                                {0.1, 0.0, 0.0});
+    });
+
+    // kernels are built per patch, patches have their own size once balanced
+    std::size_t step = 0;
+    return timed_run(nx, ppc, threads, steps, [&]() {
+        level.for_each_patch([&](auto& patch) {
+            std::vector<std::array<double, 6>> at_particles;
+            for (auto& pop : patch.populations)
+                gather_fields(pop.particles(), patch.E, patch.B, *patch.layout, at_particles);
+        });
+        level.migrate_particles();
+
+        level.for_each_patch([&](auto& patch) {
+            for (auto& pop : patch.populations)
+                pop.deposit();
+        });
+        for (std::size_t iPop = 0; iPop < level.patches()[0].populations.size(); ++iPop)
+        {
+            level.fill_ghosts(
+                [iPop](auto& patch) -> auto& { return patch.populations[iPop].flux(); });
+            level.fill_ghosts(
+                [iPop](auto& patch) -> auto& { return patch.populations[iPop].density(); });
+        }
+
+        level.for_each_patch([&](auto& patch) {
+            total_density(patch.populations, patch.N);
+            bulk_velocity<dimension>(patch.populations, patch.N, patch.V);
+            Ampere<dimension>{patch.layout}(patch.B, patch.J);
+        });
+        level.fill_ghosts([](auto& patch) -> auto& { return patch.J; });
+
+        level.for_each_patch([&](auto& patch) {
+            Ohm<dimension>{patch.layout}(patch.B, patch.J, patch.N, patch.V, patch.E);
+        });
+        level.fill_ghosts([](auto& patch) -> auto& { return patch.E; });
+
+        if (options.balance_every > 0 and ++step % options.balance_every == 0)
+            level.balance_if_needed(1.1);
+    });
+}
+
+
+int main(int argc, char** argv)
+{
+    auto const options = parse_options(argc, argv);
+    bool const weak    = options.mode == "weak";
+    std::cerr << "note: " << push_note << "\n";
+
+    std::vector<ScalingRun> runs;
+    std::vector<double> efficiencies, speedups;
+
+    for (auto const nx : options.nx)
+        for (auto const ppc : options.ppc)
+        {
+            double baseline         = 0.;
+            std::size_t base_thread = 0;
+            for (auto const threads : options.threads)
+            {
+                auto const run_nx = weak ? nx * threads : nx;
+                std::cerr << options.mode << " scaling nx=" << run_nx << " ppc=" << ppc
+                          << " threads=" << threads << "\n";
+                runs.push_back(options.patches > 0
+                                   ? run_patches(run_nx, ppc, threads, options.steps, options)
+                                   : run(run_nx, ppc, threads, options.steps));
+
+                auto const time = runs.back().seconds_per_step;
+                if (baseline == 0.)
+                {
+                    baseline    = time;
+                    base_thread = threads;
+                }
+                // strong: T1 / (p T_p) ; weak: T1 / T_p, relative to the first thread count
+                auto const ratio   = static_cast<double>(threads) / base_thread;
+                auto const speedup = baseline / time;
+                speedups.push_back(weak ? speedup * ratio : speedup);
+                efficiencies.push_back(weak ? speedup : speedup / ratio);
+            }
+        }
+
+    // phases registered during any run become columns
+    std::vector<std::string> phase_names;
+    for (auto const& run : runs)
+        for (auto const& [name, _] : run.phases)
+            if (std::find(phase_names.begin(), phase_names.end(), name) == phase_names.end())
+                phase_names.push_back(name);
+
+    std::ofstream out{options.output};
+    out << "mode,patches,threads,nx,ppc,steps,seconds_per_step,speedup,efficiency";
+    for (auto const& name : phase_names)
+        out << "," << name;
+    out << "\n";
+
+    for (auto iRun = 0u; iRun < runs.size(); ++iRun)
+    {
+        auto const& run = runs[iRun];
+        out << options.mode << "," << options.patches << "," << run.threads << "," << run.nx << ","
+            << run.ppc << "," << options.steps << "," << run.seconds_per_step << ","
+            << speedups[iRun] << "," << efficiencies[iRun];
+        for (auto const& name : phase_names)
+        {
+            auto const phase = run.phases.find(name);
+            out << "," << (phase == run.phases.end() ? 0. : phase->second);
+        }
+        out << "\n";
+    }
+    std::cerr << "results written to " << options.output << "\n";
+
+    return 0;
+}
@@ -0,0 +1,346 @@
+#ifndef HYBIRT_ALLOCATOR_HPP
+#define HYBIRT_ALLOCATOR_HPP
+
+// memory of the fields and of the particles, placed for the threads that work on it
+//
+// Linux puts a page on the NUMA node of the thread that writes it first. The memory of a
+// std::vector is first written by the thread that fills it, so on a two socket node all of
+// it lands on the socket of the master thread and the workers of the other socket pay remote
+// accesses in every kernel. FirstTouchAllocator maps large blocks itself and writes their
+// pages in a static OpenMP loop before the vector fills them: it is the partition of the
+// `#pragma omp parallel for` of the kernels, so each chunk lands on the node of the thread
+// that will work on it, and stays there when the master thread fills or copies the vector.
+//
+// Blocks of a huge page or more are also 2 MB aligned and backed by huge pages, following
+//
+//    HYBIRT_HUGE_PAGES=transparent   madvise(MADV_HUGEPAGE), the default
+//    HYBIRT_HUGE_PAGES=explicit      MAP_HUGETLB from the reserved pool (vm.nr_hugepages),
+//                                    transparent huge pages when the pool is empty
+//    HYBIRT_HUGE_PAGES=none          4 kB pages
+//
+// Blocks below first_touch_bytes come from std::allocator, as does everything off Linux.
+// memory_placement() reports on which node and on which pages a block actually landed.
+// Every block is counted under the subsystem of the allocator in the MemoryAccounting in use
+// where the allocator was made, and for a named allocator under its population too.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "memory_accounting.hpp"
+
+
+inline constexpr std::size_t page_bytes        = 4096;
+inline constexpr std::size_t huge_page_bytes   = 2 * 1024 * 1024;
+inline constexpr std::size_t first_touch_bytes = 16 * page_bytes;
+
+#if defined(__linux__)
+inline constexpr bool maps_memory = true;
+#else
+inline constexpr bool maps_memory = false;
+#endif
+
+
+enum class HugePages { none, transparent, explicit_pool };
+
+// read once from HYBIRT_HUGE_PAGES
+inline HugePages huge_pages_policy()
+{
+    static HugePages const policy = []() {
+        char const* value = std::getenv("HYBIRT_HUGE_PAGES");
+        std::string const name{value ? value : "transparent"};
+        if (name == "none")
+            return HugePages::none;
+        if (name == "explicit")
+            return HugePages::explicit_pool;
+        if (name != "transparent")
+            std::cout << "HYBIRT_HUGE_PAGES=" << name << " unknown, using transparent\n";
+        return HugePages::transparent;
+    }();
+    return policy;
+}
+
+
+// size of the mapping of a block of bytes, whole huge pages when it gets them
+inline std::size_t mapped_bytes(std::size_t bytes)
+{
+    auto const page = bytes >= huge_page_bytes and huge_pages_policy() != HugePages::none
+                          ? huge_page_bytes
+                          : page_bytes;
+    return (bytes + page - 1) / page * page;
+}
+
+// what a FirstTouchAllocator holds for a block of bytes
+inline std::size_t allocated_bytes(std::size_t bytes)
+{
+    return maps_memory and bytes >= first_touch_bytes ? mapped_bytes(bytes) : bytes;
+}
+
+// fresh pages, not touched yet, nullptr on failure
+inline void* map_memory(std::size_t bytes)
+{
+#if defined(__linux__)
+    auto const size   = mapped_bytes(bytes);
+    auto const policy = huge_pages_policy();
+    bool const huge   = size % huge_page_bytes == 0 and policy != HugePages::none;
+
+    if (huge and policy == HugePages::explicit_pool)
+    {
+        void* block = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (block != MAP_FAILED)
+            return block;
+    }
+
+    // over-map by a huge page and trim, so that the block starts on a huge page boundary
+    auto const slack = huge ? huge_page_bytes : 0;
+    void* mapping    = mmap(nullptr, size + slack, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+        return nullptr;
+    auto const start   = reinterpret_cast<std::uintptr_t>(mapping);
+    auto const aligned = huge ? (start + slack - 1) / slack * slack : start;
+    if (aligned > start)
+        munmap(mapping, aligned - start);
+    if (auto const tail = start + size + slack - (aligned + size); tail > 0)
+        munmap(reinterpret_cast<void*>(aligned + size), tail);
+
+    auto* block = reinterpret_cast<void*>(aligned);
+    if (huge)
+        madvise(block, size, MADV_HUGEPAGE);
+    return block;
+#else
+    (void)bytes;
+    return nullptr;
+#endif
+}
+
+inline void unmap_memory(void* block, std::size_t bytes)
+{
+#if defined(__linux__)
+    munmap(block, mapped_bytes(bytes));
+#else
+    (void)block;
+    (void)bytes;
+#endif
+}
+
+// writes every page of the block from the thread that gets it in a static partition
+inline void first_touch(void* block, std::size_t bytes)
+{
+    auto* data           = static_cast<volatile unsigned char*>(block);
+    auto const nbr_pages = static_cast<std::ptrdiff_t>((bytes + page_bytes - 1) / page_bytes);
+
+#pragma omp parallel for schedule(static)
+    for (std::ptrdiff_t iPage = 0; iPage < nbr_pages; ++iPage)
+        data[iPage * page_bytes] = 0;
+}
+
+
+template<typename T, Subsystem subsystem>
+class FirstTouchAllocator
+{
+public:
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = FirstTouchAllocator<U, subsystem>;
+    };
+
+    // blocks are released from the accounting they were counted in, so it goes with them
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+
+    FirstTouchAllocator() = default;
+
+    // also counts under the name of a population
+    explicit FirstTouchAllocator(std::string const& population)
+        : m_detail{&m_accounting->particles(population)}
+    {
+    }
+
+    template<typename U>
+    FirstTouchAllocator(FirstTouchAllocator<U, subsystem> const& other)
+        : m_accounting{other.m_accounting}
+        , m_detail{other.m_detail}
+    {
+    }
+
+    // a copy counts in the accounting in use where it is made, e.g. another simulation's
+    FirstTouchAllocator select_on_container_copy_construction() const
+    {
+        return m_detail ? FirstTouchAllocator{m_detail->name} : FirstTouchAllocator{};
+    }
+
+    T* allocate(std::size_t n)
+    {
+        auto const bytes = n * sizeof(T);
+        T* data          = nullptr;
+        if (!maps_memory or bytes < first_touch_bytes)
+            data = std::allocator<T>{}.allocate(n);
+        else
+        {
+            void* block = map_memory(bytes);
+            if (!block)
+                throw std::bad_alloc{};
+            first_touch(block, bytes);
+            data = static_cast<T*>(block);
+        }
+        m_accounting->allocated(subsystem, allocated_bytes(bytes), m_detail);
+        return data;
+    }
+
+    void deallocate(T* data, std::size_t n)
+    {
+        m_accounting->released(subsystem, allocated_bytes(n * sizeof(T)), m_detail);
+        if (maps_memory and n * sizeof(T) >= first_touch_bytes)
+            unmap_memory(data, n * sizeof(T));
+        else
+            std::allocator<T>{}.deallocate(data, n);
+    }
+
+    template<typename U>
+    bool operator==(FirstTouchAllocator<U, subsystem> const& other) const
+    {
+        return m_accounting == other.m_accounting and m_detail == other.m_detail;
+    }
+
+private:
+    template<typename U, Subsystem>
+    friend class FirstTouchAllocator;
+
+    MemoryAccounting* m_accounting     = &MemoryAccounting::current_accounting();
+    MemoryAccounting::Detail* m_detail = nullptr;
+};
+
+
+
+
+// where the pages of some memory are: NUMA node of each page, sampled, and the bytes backed
+// by huge pages
+struct MemoryPlacement
+{
+    std::size_t bytes           = 0;
+    std::size_t huge_page_bytes = 0;
+    std::map<int, std::size_t> pages_per_node; // sampled pages, node -1 when unknown
+
+    MemoryPlacement& operator+=(MemoryPlacement const& other)
+    {
+        bytes += other.bytes;
+        huge_page_bytes += other.huge_page_bytes;
+        for (auto const& [node, pages] : other.pages_per_node)
+            pages_per_node[node] += pages;
+        return *this;
+    }
+
+    void print(std::string const& what) const
+    {
+        std::size_t sampled = 0;
+        for (auto const& [node, pages] : pages_per_node)
+            sampled += pages;
+
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(1) << "memory of " << what << ": "
+             << bytes / (1024. * 1024.) << " MB";
+        for (auto const& [node, pages] : pages_per_node)
+        {
+            line << ", " << 100. * pages / sampled << "% on ";
+            if (node < 0)
+                line << "an unknown node";
+            else
+                line << "node " << node;
+        }
+        if (bytes > 0)
+            line << ", " << 100. * huge_page_bytes / bytes << "% in huge pages";
+        std::cout << line.str() << "\n";
+    }
+};
+
+
+// node of up to max_samples pages spread over the block, from move_pages(2) which only
+// queries when no target node is given, and huge pages of the mappings that hold the block,
+// from /proc/self/smaps: a mapping shared with other data may count some of theirs
+inline MemoryPlacement memory_placement(void const* data, std::size_t bytes,
+                                        std::size_t max_samples = 1024)
+{
+    MemoryPlacement placement;
+    placement.bytes = bytes;
+    if (!data or bytes == 0)
+        return placement;
+
+    auto const first     = reinterpret_cast<std::uintptr_t>(data) / page_bytes * page_bytes;
+    auto const last      = reinterpret_cast<std::uintptr_t>(data) + bytes;
+    auto const nbr_pages = (last - first + page_bytes - 1) / page_bytes;
+    auto const samples   = std::min(nbr_pages, max_samples);
+
+    std::vector<void*> pages(samples);
+    std::vector<int> nodes(samples, -1);
+    for (std::size_t iSample = 0; iSample < samples; ++iSample)
+    {
+        auto const page = iSample * nbr_pages / samples;
+        pages[iSample]  = reinterpret_cast<void*>(first + page * page_bytes);
+    }
+
+#if defined(__linux__) and defined(SYS_move_pages)
+    if (syscall(SYS_move_pages, 0, samples, pages.data(), nullptr, nodes.data(), 0) != 0)
+        std::fill(nodes.begin(), nodes.end(), -1);
+
+    std::ifstream smaps{"/proc/self/smaps"};
+    std::string line;
+    bool inside = false;
+    while (std::getline(smaps, line))
+    {
+        std::uintptr_t start = 0, end = 0;
+        char dash            = 0;
+        std::istringstream header{line};
+        if (header >> std::hex >> start >> dash >> end and dash == '-')
+        {
+            inside = start < last and end > first;
+            continue;
+        }
+        std::istringstream entry{line};
+        std::string key;
+        std::size_t kilobytes = 0;
+        if (inside and entry >> key >> kilobytes
+            and (key == "AnonHugePages:" or key == "Private_Hugetlb:"))
+            placement.huge_page_bytes += kilobytes * 1024;
+    }
+    placement.huge_page_bytes = std::min(placement.huge_page_bytes, bytes);
+#endif
+
+    for (auto const node : nodes)
+        ++placement.pages_per_node[node < 0 ? -1 : node];
+    return placement;
+}
+
+// of a vector, or of a field
+template<typename Container>
+MemoryPlacement memory_placement(Container const& container)
+{
+    auto const size = static_cast<std::size_t>(std::distance(container.begin(), container.end()));
+    return memory_placement(std::to_address(container.begin()),
+                            size * sizeof(*container.begin()));
+}
+
+
+#endif // HYBIRT_ALLOCATOR_HPP
@@ -2,6 +2,7 @@
 #define HYBRIDIR_AMPERE_HPP
 
 #include "vecfield.hpp"
+#include "timers.hpp"
 
 #include <cstddef>
 #include <iostream>
@@ -19,6 +20,7 @@ public:
 
     void operator()(VecField<dimension> const& B, VecField<dimension>& J)
     {
+        HYBIRT_TIME_SCOPE("ampere");
         auto const dx = m_grid->cell_size(Direction::X);
 
         if constexpr (dimension == 1)
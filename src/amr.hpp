@@ -0,0 +1,514 @@
+#ifndef HYBIRT_AMR_HPP
+#define HYBIRT_AMR_HPP
+
+#include "field.hpp"
+#include "vecfield.hpp"
+#include "gridlayout.hpp"
+#include "boundary_condition.hpp"
+#include "interpolator.hpp"
+#include "patch.hpp"
+#include "resampling.hpp"
+#include "timers.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// ratio of the cell sizes and of the time steps of two levels
+inline constexpr std::size_t refinement_ratio = 2;
+
+
+// cells [lower, upper] of the coarse level, both included
+struct Box
+{
+    std::size_t lower;
+    std::size_t upper;
+
+    std::size_t size() const { return upper - lower + 1; }
+    bool operator==(Box const&) const = default;
+};
+
+
+// tags the cells over which field varies by more than threshold times its largest magnitude.
+// The ghosts of field must be filled.
+template<std::size_t dimension>
+std::vector<bool> tag_cells(Field<dimension> const& field, GridLayout<dimension> const& layout,
+                            double threshold)
+{
+    static_assert(dimension == 1, "tag_cells only implemented for 1D");
+    auto const qty  = field.quantity();
+    auto const dsi  = layout.dom_start(qty, Direction::X);
+    auto const dei  = layout.dom_end(qty, Direction::X);
+    bool const dual = layout.centerings(qty)[0] == layout.dual;
+
+    double largest = 0.;
+    for (auto ix = dsi; ix <= dei; ++ix)
+        largest = std::max(largest, std::abs(field(ix)));
+
+    std::vector<bool> tags(layout.nbr_cells(Direction::X), false);
+    if (largest == 0.)
+        return tags;
+    for (std::size_t iCell = 0; iCell < tags.size(); ++iCell)
+    {
+        auto const ix   = dsi + iCell;
+        auto const jump = dual ? 0.5 * std::abs(field(ix + 1) - field(ix - 1))
+                               : std::abs(field(ix + 1) - field(ix));
+        tags[iCell]     = jump > threshold * largest;
+    }
+    return tags;
+}
+
+
+// boxes covering the tagged cells grown by buffer cells on each side, boxes that touch are
+// merged. Boxes stop at the domain edges, they do not wrap around the periodic boundary.
+inline std::vector<Box> cluster(std::vector<bool> const& tags, std::size_t buffer)
+{
+    std::vector<Box> boxes;
+    auto const nbr_cells = tags.size();
+    for (std::size_t iCell = 0; iCell < nbr_cells; ++iCell)
+    {
+        if (!tags[iCell])
+            continue;
+        Box const box{iCell > buffer ? iCell - buffer : 0,
+                      std::min(iCell + buffer, nbr_cells - 1)};
+        if (!boxes.empty() and box.lower <= boxes.back().upper + 1)
+            boxes.back().upper = std::max(boxes.back().upper, box.upper);
+        else
+            boxes.push_back(box);
+    }
+    return boxes;
+}
+
+
+
+struct RefinementParameters
+{
+    double threshold   = 0.1; // tags where a field varies by this fraction of its maximum
+    std::size_t buffer = 2;   // coarse cells added on each side of the tagged ones
+    std::size_t min_ppc = 0;  // band of particles per cell of both levels, max_ppc = 0
+    std::size_t max_ppc = 0;  // leaves the particles as they migrate
+};
+
+
+// two level block-structured mesh refinement of the periodic domain.
+//
+// The coarse level covers the domain, the fine level is a set of patches, one per box of
+// tagged coarse cells, each with its own layout of ratio 2 and patch-local coordinates as
+// in patch.hpp. A particle belongs to the level that covers it. Weights are densities per
+// particle, so a particle moving to the fine level doubles its weight, and halves it back
+// when it leaves: it is the same amount of plasma on cells half as wide. The resampling
+// band then splits the particles of the fine cells and coalesces them back on the coarse
+// level.
+//
+// A coarse step of dt is followed by refinement_ratio fine steps of dt / 2:
+//   begin_coarse_step(); advance the coarse level;
+//   for each substep k: fill_fine_ghosts(k / 2.) and advance the fine patches;
+//   synchronize(); migrate_particles(); deposit();
+// and regrid() every so often.
+template<std::size_t dimension>
+class Hierarchy
+{
+    static_assert(dimension == 1, "Hierarchy only implemented for 1D");
+
+public:
+    Hierarchy(std::size_t nbr_cells, double cell_size, std::size_t nbr_ghosts,
+              std::vector<std::string> const& population_names,
+              RefinementParameters const& params = {})
+        : m_params{params}
+        , m_population_names{population_names}
+        , m_coarse{0, 0, {0.},
+                   std::make_shared<GridLayout<dimension>>(
+                       std::array<std::size_t, dimension>{nbr_cells},
+                       std::array<double, dimension>{cell_size}, nbr_ghosts),
+                   population_names}
+        , m_boundary{m_coarse.layout}
+        , m_old_E{m_coarse.layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}}
+        , m_old_B{m_coarse.layout, {Quantity::Bx, Quantity::By, Quantity::Bz}}
+    {
+        if (m_params.buffer == 0)
+            throw std::runtime_error("refined boxes need a buffer of one cell at least");
+        if (m_params.max_ppc > 0)
+            m_resamplers.emplace_back(m_coarse.layout, m_params.min_ppc, m_params.max_ppc);
+    }
+
+
+    auto& coarse() { return m_coarse; }
+    auto const& coarse() const { return m_coarse; }
+    auto& fine() { return m_fine; }
+    auto const& fine() const { return m_fine; }
+    auto const& boxes() const { return m_boxes; }
+
+    auto& boundary() { return m_boundary; }
+
+
+    // refines the coarse cells where criterion, a coarse field with filled ghosts, varies
+    // fast. Fine fields are interpolated from the coarse ones, so a box that moves loses the
+    // fine detail of what it leaves. Returns whether the boxes changed.
+    bool regrid(Field<dimension> const& criterion)
+    {
+        HYBIRT_TIME_SCOPE("amr_regrid");
+        auto boxes = cluster(tag_cells(criterion, *m_coarse.layout, m_params.threshold),
+                             m_params.buffer);
+        if (boxes == m_boxes)
+            return false;
+
+        // the old patches give everything back to the coarse level
+        synchronize();
+        for (std::size_t iPop = 0; iPop < m_population_names.size(); ++iPop)
+        {
+            auto& coarse = m_coarse.populations[iPop].particles();
+            for (auto& patch : m_fine)
+            {
+                for (auto particle : patch.populations[iPop].particles())
+                    coarse.push_back(to_coarse(particle, patch));
+            }
+        }
+
+        m_boxes = std::move(boxes);
+        m_fine.clear();
+        m_level_ghosts.clear();
+        if (!m_resamplers.empty())
+            m_resamplers.erase(m_resamplers.begin() + 1, m_resamplers.end());
+        for (auto const& box : m_boxes)
+        {
+            // coarse particles are deposited on the patch from as far as the shape reaches,
+            // which takes interp_order ghost nodes for the stencils to stay allocated
+            auto const cell_size = m_coarse.layout->cell_size(Direction::X);
+            auto layout          = std::make_shared<GridLayout<dimension>>(
+                std::array<std::size_t, dimension>{refinement_ratio * box.size()},
+                std::array<double, dimension>{cell_size / refinement_ratio},
+                std::max(m_coarse.layout->nbr_ghosts(), interp_order));
+            auto& patch = m_fine.emplace_back(m_fine.size(), refinement_ratio * box.lower,
+                                              std::array<double, dimension>{box.lower * cell_size},
+                                              layout, m_population_names, population_ids());
+
+            auto const coarse_fields = m_coarse.fields();
+            auto const fine_fields   = patch.fields();
+            for (std::size_t iField = 0; iField < fine_fields.size(); ++iField)
+            {
+                auto& fine = *fine_fields[iField];
+                for (std::size_t ix = 0; ix < layout->allocate(fine.quantity())[0]; ++ix)
+                    fine(ix) = prolong(*coarse_fields[iField], patch, fine.quantity(), ix);
+            }
+
+            m_level_ghosts.emplace_back("level_ghosts", layout);
+            if (m_params.max_ppc > 0)
+                m_resamplers.emplace_back(layout, m_params.min_ppc, m_params.max_ppc);
+        }
+
+        migrate_particles();
+        return true;
+    }
+
+
+    // keeps the coarse E and B at the start of the coarse step, fine ghosts are interpolated
+    // in time between them and the coarse fields at the end of the step
+    void begin_coarse_step()
+    {
+        m_old_E = m_coarse.E;
+        m_old_B = m_coarse.B;
+    }
+
+    // fills the ghosts of the fine E and B at alpha, from 0 to 1, of the coarse step,
+    // interpolated linearly in space and in time from the coarse level
+    void fill_fine_ghosts(double alpha)
+    {
+        HYBIRT_TIME_SCOPE("amr_ghosts");
+        std::array<Field<dimension> const*, 6> const old_fields{
+            &m_old_E.x, &m_old_E.y, &m_old_E.z, &m_old_B.x, &m_old_B.y, &m_old_B.z};
+        auto const new_fields = electromagnetic(m_coarse);
+
+        for (auto& patch : m_fine)
+        {
+            auto const fine_fields = electromagnetic(patch);
+            for (std::size_t iField = 0; iField < fine_fields.size(); ++iField)
+            {
+                auto& fine = *fine_fields[iField];
+                for_each_ghost(fine, *patch.layout, [&](std::size_t ix) {
+                    auto const qty = fine.quantity();
+                    fine(ix)       = (1. - alpha) * prolong(*old_fields[iField], patch, qty, ix)
+                               + alpha * prolong(*new_fields[iField], patch, qty, ix);
+                });
+            }
+        }
+    }
+
+
+    // once the fine level caught up with the coarse one, the coarse E and B under the fine
+    // patches take the fine values: a primal node the fine node it shares, a dual node the
+    // mean of the two fine nodes of its cell
+    void synchronize()
+    {
+        HYBIRT_TIME_SCOPE("amr_synchronize");
+        auto const coarse_fields = electromagnetic(m_coarse);
+        auto const ghosts        = m_coarse.layout->nbr_ghosts();
+
+        for (std::size_t iPatch = 0; iPatch < m_fine.size(); ++iPatch)
+        {
+            auto const& box        = m_boxes[iPatch];
+            auto const fine_fields = electromagnetic(m_fine[iPatch]);
+            auto const fine_ghosts = m_fine[iPatch].layout->nbr_ghosts();
+            for (std::size_t iField = 0; iField < fine_fields.size(); ++iField)
+            {
+                auto& coarse      = *coarse_fields[iField];
+                auto const& fine  = *fine_fields[iField];
+                bool const dual   = m_coarse.layout->centerings(coarse.quantity())[0]
+                                  == m_coarse.layout->dual;
+                auto const last   = box.upper + (dual ? 0 : 1);
+                for (auto cell = box.lower; cell <= last; ++cell)
+                {
+                    auto const ix       = fine_ghosts + refinement_ratio * (cell - box.lower);
+                    coarse(ghosts + cell) = dual ? 0.5 * (fine(ix) + fine(ix + 1)) : fine(ix);
+                }
+            }
+        }
+        m_boundary.fill(m_coarse.E);
+        m_boundary.fill(m_coarse.B);
+    }
+
+
+    // fine particles that left their patch go to the coarse level and coarse particles that
+    // entered a box to its patch, then both levels are resampled to the ppc band if any.
+    // Particles may not cross a whole box in one call.
+    void migrate_particles()
+    {
+        HYBIRT_TIME_SCOPE("amr_migration");
+        auto const cell_size = m_coarse.layout->cell_size(Direction::X);
+
+        for (std::size_t iPop = 0; iPop < m_population_names.size(); ++iPop)
+        {
+            auto& coarse = m_coarse.populations[iPop].particles();
+            for (auto& patch : m_fine)
+            {
+                auto& particles         = patch.populations[iPop].particles();
+                auto const patch_length = patch.layout->dom_size(Direction::X);
+                std::size_t kept        = 0;
+                for (std::size_t iPart = 0; iPart < particles.size(); ++iPart)
+                {
+                    auto const x = particles[iPart].position[0];
+                    if (x >= 0. and x < patch_length)
+                        particles[kept++] = particles[iPart];
+                    else
+                        coarse.push_back(to_coarse(particles[iPart], patch));
+                }
+                particles.resize(kept);
+            }
+
+            std::size_t kept = 0;
+            for (std::size_t iPart = 0; iPart < coarse.size(); ++iPart)
+            {
+                auto particle  = coarse[iPart];
+                auto const x   = particle.position[0];
+                auto const box = std::find_if(m_boxes.begin(), m_boxes.end(), [&](auto& box) {
+                    return x >= box.lower * cell_size and x < (box.upper + 1) * cell_size;
+                });
+                if (box == m_boxes.end())
+                {
+                    coarse[kept++] = particle;
+                    continue;
+                }
+                auto& patch = m_fine[box - m_boxes.begin()];
+                particle.position[0] -= patch.origin[0];
+                particle.weight *= refinement_ratio;
+                patch.populations[iPop].particles().push_back(particle);
+            }
+            coarse.resize(kept);
+
+            if (!m_resamplers.empty())
+            {
+                m_resamplers[0](m_coarse.populations[iPop]);
+                for (std::size_t iPatch = 0; iPatch < m_fine.size(); ++iPatch)
+                    m_resamplers[iPatch + 1](m_fine[iPatch].populations[iPop]);
+            }
+        }
+    }
+
+
+    // moments of every population on both levels.
+    // Coarse moments cover the whole domain: the coarse particles plus the fine ones
+    // restricted with the (1, 2, 1) / 4 weights, which keeps their total, ghosts included
+    // since they hold what the fine particles spill out of their patch.
+    // Fine moments are the fine particles plus the coarse ones whose shape reaches into the
+    // patch, deposited on the fine nodes as well, and their ghosts are interpolated from the
+    // coarse moments.
+    void deposit()
+    {
+        HYBIRT_TIME_SCOPE("amr_moments");
+        auto const ghosts    = m_coarse.layout->nbr_ghosts();
+        auto const nbr_cells
+            = static_cast<std::ptrdiff_t>(m_coarse.layout->nbr_cells(Direction::X));
+
+        for (std::size_t iPop = 0; iPop < m_population_names.size(); ++iPop)
+        {
+            auto& coarse_pop = m_coarse.populations[iPop];
+            coarse_pop.deposit();
+            m_boundary.fill_all(coarse_pop.flux(), coarse_pop.density());
+            auto const coarse_moments = moments(coarse_pop);
+
+            for (std::size_t iPatch = 0; iPatch < m_fine.size(); ++iPatch)
+            {
+                auto& patch = m_fine[iPatch];
+                auto& pop   = patch.populations[iPop];
+                pop.deposit();
+
+                auto const fine_ghosts = static_cast<std::ptrdiff_t>(patch.layout->nbr_ghosts());
+                auto const first       = static_cast<std::ptrdiff_t>(patch.first_cell);
+                auto const fine_moments = moments(pop);
+                for (std::size_t iMoment = 0; iMoment < fine_moments.size(); ++iMoment)
+                {
+                    auto const& fine = *fine_moments[iMoment];
+                    auto& coarse     = *coarse_moments[iMoment];
+                    auto const add   = [&](std::ptrdiff_t node, double value) {
+                        coarse(ghosts + ((node % nbr_cells) + nbr_cells) % nbr_cells) += value;
+                    };
+                    auto const size = patch.layout->allocate(fine.quantity())[0];
+                    for (std::size_t ix = 0; ix < size; ++ix)
+                    {
+                        auto const node = first + static_cast<std::ptrdiff_t>(ix) - fine_ghosts;
+                        if (node % 2 == 0)
+                            add(node / 2, 0.5 * fine(ix));
+                        else
+                        {
+                            add((node - 1) / 2, 0.25 * fine(ix));
+                            add((node + 1) / 2, 0.25 * fine(ix));
+                        }
+                    }
+                }
+            }
+            for (auto* moment : coarse_moments)
+                m_boundary.refill(*moment);
+
+            for (std::size_t iPatch = 0; iPatch < m_fine.size(); ++iPatch)
+            {
+                auto& patch        = m_fine[iPatch];
+                auto& level_ghosts = m_level_ghosts[iPatch];
+                collect_level_ghosts(coarse_pop.particles(), patch, level_ghosts.particles());
+                level_ghosts.deposit();
+
+                auto const fine_moments  = moments(patch.populations[iPop]);
+                auto const ghost_moments = moments(level_ghosts);
+                for (std::size_t iMoment = 0; iMoment < fine_moments.size(); ++iMoment)
+                {
+                    auto& fine     = *fine_moments[iMoment];
+                    auto const qty = fine.quantity();
+                    for (auto ix = patch.layout->dom_start(qty, Direction::X);
+                         ix <= patch.layout->dom_end(qty, Direction::X); ++ix)
+                        fine(ix) += (*ghost_moments[iMoment])(ix);
+                    for_each_ghost(fine, *patch.layout, [&](std::size_t ix) {
+                        fine(ix) = prolong(*coarse_moments[iMoment], patch, qty, ix);
+                    });
+                }
+            }
+        }
+    }
+
+
+private:
+    // fine patches take their ids from the coarse level, particles keep theirs across levels
+    std::vector<std::shared_ptr<ParticleIds>> population_ids() const
+    {
+        std::vector<std::shared_ptr<ParticleIds>> ids;
+        for (auto const& pop : m_coarse.populations)
+            ids.push_back(pop.ids());
+        return ids;
+    }
+
+    static std::array<Field<dimension>*, 6> electromagnetic(Patch<dimension>& patch)
+    {
+        return {&patch.E.x, &patch.E.y, &patch.E.z, &patch.B.x, &patch.B.y, &patch.B.z};
+    }
+
+    static std::array<Field<dimension>*, 4> moments(Population<dimension>& pop)
+    {
+        return {&pop.flux().x, &pop.flux().y, &pop.flux().z, &pop.density()};
+    }
+
+    template<typename Function>
+    static void for_each_ghost(Field<dimension> const& field, GridLayout<dimension> const& layout,
+                               Function&& function)
+    {
+        auto const qty = field.quantity();
+        for (std::size_t ix = 0; ix < layout.dom_start(qty, Direction::X); ++ix)
+            function(ix);
+        for (auto ix = layout.dom_end(qty, Direction::X) + 1;
+             ix <= layout.ghost_end(qty, Direction::X); ++ix)
+            function(ix);
+    }
+
+    // coarse field at the fine node ix of patch, interpolated linearly. Fine ghosts may reach
+    // past the coarse ones at the domain edges, they are taken on the other side.
+    double prolong(Field<dimension> const& coarse, Patch<dimension> const& patch, Quantity qty,
+                   std::size_t ix) const
+    {
+        auto const length = m_coarse.layout->dom_size(Direction::X);
+        auto x            = patch.origin[0] + patch.layout->coordinate(Direction::X, qty, ix);
+        if (x < 0.)
+            x += length;
+        else if (x >= length)
+            x -= length;
+        return interpolate<1>(coarse, *m_coarse.layout, std::array<double, dimension>{x});
+    }
+
+    // coarse particles whose shape reaches the domain nodes of patch, in its coordinates and
+    // with the fine weight. Boxes are two cells apart at least, so these are all outside any
+    // other patch.
+    void collect_level_ghosts(ParticleArray<dimension> const& coarse,
+                              Patch<dimension> const& patch,
+                              ParticleArray<dimension>& level_ghosts) const
+    {
+        auto const length       = m_coarse.layout->dom_size(Direction::X);
+        auto const patch_length = patch.layout->dom_size(Direction::X);
+        auto const reach = 0.5 * (interp_order + 1) * patch.layout->cell_size(Direction::X);
+
+        level_ghosts.clear();
+        for (auto particle : coarse)
+        {
+            auto& x = particle.position[0];
+            x -= patch.origin[0];
+            if (x < -reach)
+                x += length;
+            else if (x >= patch_length + reach)
+                x -= length;
+            if ((x >= -reach and x < 0.) or (x >= patch_length and x < patch_length + reach))
+            {
+                particle.weight *= refinement_ratio;
+                level_ghosts.push_back(particle);
+            }
+        }
+    }
+
+    Particle<dimension> to_coarse(Particle<dimension> particle,
+                                  Patch<dimension> const& patch) const
+    {
+        auto const length = m_coarse.layout->dom_size(Direction::X);
+        auto& x           = particle.position[0];
+        x += patch.origin[0];
+        if (x < 0.)
+            x += length;
+        else if (x >= length)
+            x -= length;
+        particle.weight /= refinement_ratio;
+        return particle;
+    }
+
+
+    RefinementParameters m_params;
+    std::vector<std::string> m_population_names;
+    Patch<dimension> m_coarse;
+    PeriodicBoundaryCondition<dimension> m_boundary;
+    VecField<dimension> m_old_E, m_old_B; // coarse fields at the start of the coarse step
+
+    std::vector<Box> m_boxes;
+    std::vector<Patch<dimension>> m_fine; // one per box, in the same order
+    std::vector<Resampler<dimension>> m_resamplers; // coarse level first, then every patch
+    std::vector<Population<dimension>> m_level_ghosts; // coarse particles next to every patch
+};
+
+
+#endif // HYBIRT_AMR_HPP
@@ -3,13 +3,21 @@
 
 #include "field.hpp"
 #include "vecfield.hpp"
+#include "ghost_fill.hpp"
 #include "pusher.hpp"
+#include "population.hpp"
+#include "timers.hpp"
+#include "perf_counters.hpp"
 
 #include <iostream>
 #include <memory>
 #include <string>
 #include <stdexcept>
 #include <cmath>
+#include <array>
+#include <optional>
+#include <random>
+#include <vector>
 
 
 template<std::size_t dimension>
@@ -25,14 +33,29 @@ public:
 
     virtual void fill(Field<dimension>& field) = 0;
 
-    void fill(VecField<dimension>& vecfield)
+    virtual void fill(VecField<dimension>& vecfield)
     {
         fill(vecfield.x);
         fill(vecfield.y);
         fill(vecfield.z);
     }
 
-    virtual void particles(std::vector<Particle<dimension>>& particles) = 0;
+    // fills any list of fields and vector fields
+    template<typename... Fields>
+    void fill_all(Fields&... fields)
+    {
+        (fill(fields), ...);
+    }
+
+    // fills the ghosts of a field whose domain nodes are already final, e.g. after a filter
+    // pass: moments are copied like the other fields, their ghosts are not folded again
+    virtual void refill(Field<dimension>& field) { fill(field); }
+
+    virtual void particles(ParticleArray<dimension>& particles) = 0;
+
+    // boundaries that create particles need the population they belong to
+    virtual void particles(Population<dimension>& population) { particles(population.particles()); }
+
     virtual ~BoundaryCondition() = default;
 
 protected:
@@ -41,64 +64,59 @@ protected:
 
 
 template<std::size_t dimension>
-class PeriodicBoundaryCondition : public BoundaryCondition<dimension>
+class PeriodicBoundaryCondition final : public BoundaryCondition<dimension>
 {
 public:
+    using BoundaryCondition<dimension>::particles;
+
     PeriodicBoundaryCondition(std::shared_ptr<GridLayout<dimension>> const& grid)
         : BoundaryCondition<dimension>(grid)
+        , m_plan{*grid}
     {
     }
 
     void fill(Field<dimension>& field) override
     {
-        if constexpr (dimension == 1)
-        {
-            // left side
-            auto gsi = this->m_grid->ghost_start(field.quantity(), Direction::X);
-            auto dsi = this->m_grid->dom_start(field.quantity(), Direction::X);
-            auto dei = this->m_grid->dom_end(field.quantity(), Direction::X);
-            auto gei = this->m_grid->ghost_end(field.quantity(), Direction::X);
-
-            auto const nbr_nodes = this->m_grid->nbr_cells(Direction::X);
+        HYBIRT_TIME_SCOPE("field_bc");
+        HYBIRT_COUNT_SCOPE("field_bc", 2 * this->m_grid->nbr_ghosts(), 0);
+        m_plan.fill(field);
+    }
 
-            if (field.quantity() == Quantity::N or field.quantity() == Quantity::Vx
-                or field.quantity() == Quantity::Vy or field.quantity() == Quantity::Vz)
-            {
-                for (auto ix_left = gsi; ix_left <= dsi; ++ix_left)
-                {
-                    auto const ix_right = ix_left + nbr_nodes;
-                    field(ix_left) += field(ix_right);
-                }
+    // all components under one call, the plan holds the per-component work
+    void fill(VecField<dimension>& vecfield) override
+    {
+        HYBIRT_TIME_SCOPE("field_bc");
+        HYBIRT_COUNT_SCOPE("field_bc", 6 * this->m_grid->nbr_ghosts(), 0);
+        m_plan.fill(vecfield);
+    }
 
-                for (auto ix_right = gei; ix_right > dei; --ix_right)
-                {
-                    auto const ix_left = ix_right - nbr_nodes;
-                    field(ix_right) += field(ix_left);
-                }
-                field(dei) = field(dsi);
-            }
-            else
-            {
-                for (auto ix_left = gsi; ix_left < dsi; ++ix_left)
-                {
-                    auto const ix_right = ix_left + nbr_nodes;
-                    field(ix_left)      = field(ix_right);
-                }
+    template<typename... Fields>
+    void fill_all(Fields&... fields)
+    {
+        HYBIRT_TIME_SCOPE("field_bc");
+        m_plan.fill_all(fields...);
+    }
 
-                // std::cout << "Filling right side\n";
-                for (auto ix_right = gei; ix_right > dei; --ix_right)
-                {
-                    auto const ix_left = ix_right - nbr_nodes;
-                    field(ix_right)    = field(ix_left);
-                }
-            }
-        }
+    void refill(Field<dimension>& field) override
+    {
+        HYBIRT_TIME_SCOPE("field_bc");
+        m_plan.copy(field);
     }
 
-    void particles(std::vector<Particle<dimension>>& particles) override
+    void particles(ParticleArray<dimension>& particles) override
     {
+        HYBIRT_TIME_SCOPE("particle_bc");
         if constexpr (dimension == 1)
         {
+            // exceptions cannot leave an OpenMP region and threads would interleave their
+            // output, a particle out of bounds is recorded and reported after the loop
+            struct OutOfBounds
+            {
+                double position, cell, cell_save, position_save;
+            };
+            std::optional<OutOfBounds> out_of_bounds;
+
+#pragma omp parallel for
             for (auto& particle : particles)
             {
                 double cell
@@ -122,15 +140,219 @@ public:
                 if (particle.position[0] < 0.0
                     or particle.position[0] >= this->m_grid->dom_size(Direction::X))
                 {
-                    std::cout << "Particle position out of bounds after periodic BC: "
-                              << particle.position[0] << " cell: " << cell
-                              << " cell_save: " << cell_save << " position_save: " << position_save
-                              << " dom_size: " << this->m_grid->dom_size(Direction::X) << "\n";
-                    throw std::runtime_error("Particle position out of bounds after periodic BC");
+#pragma omp critical(hybirt_periodic_bc)
+                    if (!out_of_bounds)
+                        out_of_bounds = OutOfBounds{particle.position[0], cell, cell_save,
+                                                    position_save};
                 }
             }
+            if (out_of_bounds)
+            {
+                std::cout << "Particle position out of bounds after periodic BC: "
+                          << out_of_bounds->position << " cell: " << out_of_bounds->cell
+                          << " cell_save: " << out_of_bounds->cell_save
+                          << " position_save: " << out_of_bounds->position_save
+                          << " dom_size: " << this->m_grid->dom_size(Direction::X) << "\n";
+                throw std::runtime_error("Particle position out of bounds after periodic BC");
+            }
         }
     }
+
+private:
+    GhostFillPlan<dimension> m_plan;
+};
+
+
+
+// Maxwellian particles entering the domain through one side, per population
+struct Inflow
+{
+    enum class Side { left, right };
+
+    std::string population;
+    Side side;
+    std::size_t nppc;
+    double density;
+    std::array<double, 3> V;   // bulk velocity
+    std::array<double, 3> Vth; // thermal velocity
+    double mass   = 1.0;
+    double charge = 1.0;
+};
+
+
+// open boundaries: particles leaving the domain are removed, inflows inject new ones.
+//
+// Removal is an in-place stable compaction of the particle array, so it never allocates
+// and keeps the order of the particles. Injection refills, every
+// step, one cell outside the inflow side with Maxwellian particles, moves them by v dt and
+// keeps those that crossed into the domain: this draws the right flux as long as v dt < dx.
+// Candidates live in a buffer reused from one step to the next, and the particle array
+// reserves room for them, doubling its capacity, so that appending does not reallocate in
+// the hot loop.
+// Field ghosts copy the nearest domain node (zero gradient). Moments first fold what the
+// deposit left on their ghosts back into the domain, as if the plasma continued as its mirror
+// image beyond the boundary, as the periodic plan accumulates before it copies: without it
+// a boundary node only gets the particles of one side, half the density.
+template<std::size_t dimension>
+class OpenBoundaryCondition final : public BoundaryCondition<dimension>
+{
+public:
+    OpenBoundaryCondition(std::shared_ptr<GridLayout<dimension>> const& grid, double dt = 0.,
+                          std::optional<std::size_t> seed = std::nullopt)
+        : BoundaryCondition<dimension>(grid)
+        , m_dt{dt}
+        , m_generator{getRNG(seed)}
+    {
+    }
+
+    void set_dt(double dt) { m_dt = dt; }
+
+    void add_inflow(Inflow const& inflow)
+    {
+        m_inflows.push_back(inflow);
+        m_candidates.reserve(std::max(m_candidates.capacity(), inflow.nppc));
+    }
+
+
+    void fill(Field<dimension>& field) override
+    {
+        HYBIRT_TIME_SCOPE("field_bc");
+        if (GhostFillPlan<dimension>::is_moment(field.quantity()))
+            fold(field);
+        copy(field);
+    }
+
+    void fill(VecField<dimension>& vecfield) override
+    {
+        fill(vecfield.x);
+        fill(vecfield.y);
+        fill(vecfield.z);
+    }
+
+    void refill(Field<dimension>& field) override
+    {
+        HYBIRT_TIME_SCOPE("field_bc");
+        copy(field);
+    }
+
+
+    // removes the particles outside of the domain, keeping the order of the others
+    void particles(ParticleArray<dimension>& particles) override
+    {
+        HYBIRT_TIME_SCOPE("particle_bc");
+        if constexpr (dimension == 1)
+        {
+            auto const length = this->m_grid->dom_size(Direction::X);
+            std::size_t kept  = 0;
+            for (std::size_t iPart = 0; iPart < particles.size(); ++iPart)
+            {
+                auto const x = particles[iPart].position[0];
+                if (x >= 0.0 and x < length)
+                {
+                    if (kept != iPart)
+                        particles[kept] = particles[iPart];
+                    ++kept;
+                }
+            }
+            particles.resize(kept);
+        }
+    }
+
+    void particles(Population<dimension>& population) override
+    {
+        particles(population.particles());
+        for (auto const& inflow : m_inflows)
+            if (inflow.population == population.name())
+                inject(population, inflow);
+    }
+
+
+private:
+    // a ghost adds to the domain node at the same distance from the boundary, a primal node
+    // on the boundary is its own image and doubles
+    void fold(Field<dimension>& field) const
+    {
+        if constexpr (dimension == 1)
+        {
+            auto const qty        = field.quantity();
+            std::size_t const gsi = this->m_grid->ghost_start(qty, Direction::X);
+            std::size_t const dsi = this->m_grid->dom_start(qty, Direction::X);
+            std::size_t const dei = this->m_grid->dom_end(qty, Direction::X);
+            std::size_t const gei = this->m_grid->ghost_end(qty, Direction::X);
+            bool const primal     = this->m_grid->centerings(qty)[0] == this->m_grid->primal;
+            std::size_t const gap = primal ? 0 : 1; // dual nodes are half a cell off the boundary
+
+            for (auto ix = gsi; ix < dsi; ++ix)
+                field(2 * dsi - gap - ix) += field(ix);
+            for (auto ix = dei + 1; ix <= gei; ++ix)
+                field(2 * dei + gap - ix) += field(ix);
+            if (primal)
+            {
+                field(dsi) *= 2;
+                field(dei) *= 2;
+            }
+        }
+    }
+
+    // zero gradient
+    void copy(Field<dimension>& field) const
+    {
+        if constexpr (dimension == 1)
+        {
+            auto const qty        = field.quantity();
+            std::size_t const gsi = this->m_grid->ghost_start(qty, Direction::X);
+            std::size_t const dsi = this->m_grid->dom_start(qty, Direction::X);
+            std::size_t const dei = this->m_grid->dom_end(qty, Direction::X);
+            std::size_t const gei = this->m_grid->ghost_end(qty, Direction::X);
+
+            for (auto ix = gsi; ix < dsi; ++ix)
+                field(ix) = field(dsi);
+            for (auto ix = dei + 1; ix <= gei; ++ix)
+                field(ix) = field(dei);
+        }
+    }
+
+    void inject(Population<dimension>& population, Inflow const& inflow)
+    {
+        HYBIRT_TIME_SCOPE("particle_injection");
+        if constexpr (dimension == 1)
+        {
+            auto const dx     = this->m_grid->cell_size(Direction::X);
+            auto const length = this->m_grid->dom_size(Direction::X);
+            bool const left   = inflow.side == Inflow::Side::left;
+            auto const x0     = left ? -dx : length;
+
+            std::uniform_real_distribution<> uniform{0., dx};
+            m_candidates.clear();
+            for (std::size_t iPart = 0; iPart < inflow.nppc; ++iPart)
+            {
+                Particle<dimension> particle;
+                maxwellianVelocity(inflow.V, inflow.Vth, m_generator, particle.v);
+                particle.position[0] = x0 + uniform(m_generator) + particle.v[0] * m_dt;
+                if (particle.position[0] < 0.0 or particle.position[0] >= length)
+                    continue;
+                particle.weight = inflow.density / inflow.nppc;
+                particle.mass   = inflow.mass;
+                particle.charge = inflow.charge;
+                m_candidates.push_back(particle);
+            }
+
+            auto& particles   = population.particles();
+            auto const needed = particles.size() + m_candidates.size();
+            if (particles.capacity() < needed)
+                particles.reserve(std::max(2 * particles.capacity(), needed));
+            for (auto& particle : m_candidates)
+            {
+                particle.id = population.new_particle_id();
+                particles.push_back(particle);
+            }
+        }
+    }
+
+    double m_dt;
+    std::mt19937_64 m_generator;
+    std::vector<Inflow> m_inflows;
+    std::vector<Particle<dimension>> m_candidates; // injection buffer reused every step
 };
 
 
@@ -144,6 +366,8 @@ public:
     {
         if (type == "periodic")
             return std::make_unique<PeriodicBoundaryCondition<dimension>>(grid);
+        if (type == "open")
+            return std::make_unique<OpenBoundaryCondition<dimension>>(grid);
         // Add more boundary condition types as needed
         throw std::runtime_error("Unknown boundary condition type: " + type);
     }
@@ -5,10 +5,18 @@
 #include "vecfield.hpp"
 #include "particle.hpp"
 #include "population.hpp"
+#include "memory_accounting.hpp"
+#include "timers.hpp"
 
 #include "highfive/highfive.hpp"
 
+#include <cmath>
 #include <iomanip>
+#include <map>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <algorithm>
 #include <vector>
 #include <string>
 
@@ -25,15 +33,34 @@ auto to_string_fixed_width(T const& value, std::size_t const& precision, std::si
 
 
 
+// the serial HDF5 library is not thread safe, every diagnostics write takes this lock
+inline std::mutex& hdf5_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+
+
 
 template<std::size_t dim>
 void diags_write_fields(VecField<dim> const& B, VecField<dim> const& E, VecField<dim> const& V,
                         Field<dim> const& N, double time,
-                        HighFive::File::AccessMode mode = HighFive::File::ReadWrite)
+                        HighFive::File::AccessMode mode = HighFive::File::ReadWrite,
+                        std::string const& prefix       = "")
 {
-    std::string filename = "fields.h5";
+    HYBIRT_TIME_SCOPE("diagnostics");
+    std::lock_guard lock{hdf5_mutex()};
+    std::string filename = prefix + "fields.h5";
     HighFive::File file(filename, mode);
     auto const time_str = to_string_fixed_width(time, 10, 0);
+
+    // what the write hands to HDF5, an upper bound of what it buffers
+    std::size_t bytes = N.size();
+    for (auto const* vecfield : {&B, &E, &V})
+        bytes += vecfield->x.size() + vecfield->y.size() + vecfield->z.size();
+    MemoryScope const write{Subsystem::io, bytes * sizeof(double)};
+
     file.createDataSet("/t/" + time_str + "/Bx", B.x.data());
     file.createDataSet("/t/" + time_str + "/By", B.y.data());
     file.createDataSet("/t/" + time_str + "/Bz", B.z.data());
@@ -44,19 +71,28 @@ void diags_write_fields(VecField<dim> const& B, VecField<dim> const& E, VecField
     file.createDataSet("/t/" + time_str + "/Vy", V.y.data());
     file.createDataSet("/t/" + time_str + "/Vz", V.z.data());
     file.createDataSet("/t/" + time_str + "/N", N.data());
+
+    // the footprint of the run at this time, with the write above
+    auto group = file.getGroup("/t/" + time_str);
+    MemoryAccounting::current_accounting().write_attributes(group);
 }
 
 
 
 template<std::size_t dim>
 void diags_write_particles(std::vector<Population<dim>> const& populations, double time,
-                           HighFive::File::AccessMode mode = HighFive::File::ReadWrite)
+                           HighFive::File::AccessMode mode = HighFive::File::ReadWrite,
+                           std::string const& prefix       = "")
 {
+    HYBIRT_TIME_SCOPE("diagnostics");
+    std::lock_guard lock{hdf5_mutex()};
     for (auto const& pop : populations)
     {
-        std::string filename = "particles_" + pop.name() + ".h5";
+        std::string filename = prefix + "particles_" + pop.name() + ".h5";
         HighFive::File file(filename, mode);
 
+        MemoryScope const staging{Subsystem::diagnostics,
+                                  4 * pop.particles().size() * sizeof(double)};
         std::vector<double> x, y, z, vx, vy, vz;
         x.reserve(pop.particles().size());
         vx.reserve(pop.particles().size());
@@ -78,4 +114,166 @@ void diags_write_particles(std::vector<Population<dim>> const& populations, doub
 }
 
 
+
+// creates a dataset with one row per time step, extended at each write
+inline void diags_create_timeseries(HighFive::File& file, std::string const& name,
+                                    std::size_t nbr_columns)
+{
+    HighFive::DataSpace space({0, nbr_columns}, {HighFive::DataSpace::UNLIMITED, nbr_columns});
+    HighFive::DataSetCreateProps props;
+    props.add(HighFive::Chunking(std::vector<hsize_t>{1, std::max<hsize_t>(nbr_columns, 1)}));
+    file.createDataSet<double>(name, space, props);
+}
+
+
+inline void diags_append_row(HighFive::File& file, std::string const& name,
+                             std::vector<double> const& row)
+{
+    auto dataset        = file.getDataSet(name);
+    auto const dims     = dataset.getDimensions();
+    auto const nbr_rows = dims[0];
+    dataset.resize({nbr_rows + 1, dims[1]});
+    dataset.select({nbr_rows, 0}, {1, dims[1]}).write(row);
+}
+
+
+
+// tracked particles of each species, one row per write appended to tracked_<species>.h5.
+// The files are opened on the first write of their species and stay open until the writer is
+// destroyed: reopening a file every step cost more than writing the few particles tracked.
+// Particles that left the domain are NaN from then on, and /lost_time holds the time of the
+// first write that missed each of them, NaN for the particles still in the domain.
+class TrackedDiagnostics
+{
+public:
+    explicit TrackedDiagnostics(std::string prefix = "")
+        : m_prefix{prefix}
+    {
+    }
+
+    // one row of the tracked particles of a species, in the order of ids, particles that
+    // left the domain are empty. Truncate restarts a file already open
+    template<std::size_t dim>
+    void write(std::string const& species, std::vector<std::size_t> const& ids,
+               std::vector<std::optional<Particle<dim>>> const& particles, double time,
+               HighFive::File::AccessMode mode = HighFive::File::ReadWrite)
+    {
+        HYBIRT_TIME_SCOPE("diagnostics");
+        if (ids.empty())
+            return;
+
+        std::lock_guard lock{hdf5_mutex()};
+        auto& tracked          = open(species, ids, mode);
+        auto const nbr_tracked = ids.size();
+
+        MemoryScope const staging{Subsystem::diagnostics, 4 * nbr_tracked * sizeof(double)};
+        std::vector<double> x, vx, vy, vz;
+        x.reserve(nbr_tracked);
+        vx.reserve(nbr_tracked);
+        vy.reserve(nbr_tracked);
+        vz.reserve(nbr_tracked);
+        bool new_losses = false;
+        for (auto iTracked = 0u; iTracked < nbr_tracked; ++iTracked)
+        {
+            auto const& particle = particles[iTracked];
+            if (!particle)
+            {
+                for (auto* column : {&x, &vx, &vy, &vz})
+                    column->push_back(std::numeric_limits<double>::quiet_NaN());
+                if (std::isnan(tracked.lost_time[iTracked]))
+                {
+                    tracked.lost_time[iTracked] = time;
+                    new_losses                  = true;
+                }
+                continue;
+            }
+            x.push_back(particle->position[0]);
+            vx.push_back(particle->v[0]);
+            vy.push_back(particle->v[1]);
+            vz.push_back(particle->v[2]);
+        }
+        auto& file = tracked.file;
+        diags_append_row(file, "/time", {time});
+        diags_append_row(file, "/x", x);
+        diags_append_row(file, "/vx", vx);
+        diags_append_row(file, "/vy", vy);
+        diags_append_row(file, "/vz", vz);
+        if (new_losses)
+            file.getDataSet("/lost_time").write(tracked.lost_time);
+
+        // the file stays open, what is written must not wait for its closing to be readable
+        file.flush();
+    }
+
+    // writes the tracked particles of each population, populations must be of different
+    // species, patches of a species are gathered by PatchLevel::tracked_particles. Only the
+    // particles indexed by Population::tracked() are visited, once updated
+    template<std::size_t dim>
+    void write(std::vector<Population<dim>>& populations, double time,
+               HighFive::File::AccessMode mode = HighFive::File::ReadWrite)
+    {
+        for (auto& pop : populations)
+        {
+            pop.update_tracked();
+            std::vector<std::optional<Particle<dim>>> particles;
+            particles.reserve(pop.tracked().size());
+            for (auto const iPart : pop.tracked())
+            {
+                if (iPart == Population<dim>::lost_particle)
+                    particles.emplace_back();
+                else
+                    particles.emplace_back(pop.particles()[iPart]);
+            }
+            write(pop.name(), pop.tracked_ids(), particles, time, mode);
+        }
+    }
+
+    // time each tracked particle of the species was first missing, NaN if it never was
+    std::vector<double> const& lost_times(std::string const& species) const
+    {
+        auto const found = m_files.find(species);
+        if (found == m_files.end())
+            throw std::runtime_error("TrackedDiagnostics: nothing written for " + species);
+        return found->second.lost_time;
+    }
+
+
+private:
+    struct TrackedFile
+    {
+        HighFive::File file;
+        std::vector<double> lost_time;
+    };
+
+    TrackedFile& open(std::string const& species, std::vector<std::size_t> const& ids,
+                      HighFive::File::AccessMode mode)
+    {
+        auto found = m_files.find(species);
+        if (found != m_files.end() and mode != HighFive::File::Truncate)
+            return found->second;
+        if (found != m_files.end())
+            m_files.erase(found);
+
+        std::string filename = m_prefix + "tracked_" + species + ".h5";
+        TrackedFile tracked{HighFive::File(filename, mode),
+                            std::vector<double>(ids.size(),
+                                                std::numeric_limits<double>::quiet_NaN())};
+        auto& file = tracked.file;
+        if (!file.exist("/time"))
+        {
+            file.createDataSet("/id", ids);
+            file.createDataSet<double>("/lost_time", HighFive::DataSpace({ids.size()}))
+                .write(tracked.lost_time);
+            diags_create_timeseries(file, "/time", 1);
+            for (auto const& name : {"/x", "/vx", "/vy", "/vz"})
+                diags_create_timeseries(file, name, ids.size());
+        }
+        return m_files.emplace(species, std::move(tracked)).first->second;
+    }
+
+    std::string m_prefix;
+    std::map<std::string, TrackedFile> m_files;
+};
+
+
 #endif
@@ -0,0 +1,135 @@
+#ifndef HYBIRT_ENSEMBLE_HPP
+#define HYBIRT_ENSEMBLE_HPP
+
+#include "simulation.hpp"
+#include "profiles.hpp"
+#include "parallel.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <istream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// reads one parameter set per line as whitespace separated key=value pairs,
+// empty lines and lines starting with '#' are ignored:
+//
+//   name=b1 nx=100 dx=0.2 dt=0.001 final_time=5 nppc=100 by=1 density=sine:1,0.1,0.314
+//
+// keys: name nx dx ghosts dt final_time nppc bx by bz density (see profiles.hpp)
+// unspecified keys keep the SimulationParameters defaults.
+// Diagnostics of each member are written with the prefix "<name>_".
+inline std::vector<SimulationParameters> parse_ensemble(std::istream& input)
+{
+    std::vector<SimulationParameters> members;
+    std::string line;
+    std::size_t line_number = 0;
+
+    while (std::getline(input, line))
+    {
+        ++line_number;
+        auto const first = line.find_first_not_of(" \t");
+        if (first == std::string::npos or line[first] == '#')
+            continue;
+
+        SimulationParameters params;
+        params.verbose = false;
+        std::string name = "run_" + std::to_string(members.size());
+
+        std::stringstream tokens{line};
+        std::string token;
+        while (tokens >> token)
+        {
+            auto const equal = token.find('=');
+            if (equal == std::string::npos)
+                throw std::runtime_error("ensemble line " + std::to_string(line_number)
+                                         + ": expected key=value, got " + token);
+            auto const key   = token.substr(0, equal);
+            auto const value = token.substr(equal + 1);
+
+            if (key == "name")
+                name = value;
+            else if (key == "nx")
+                params.nbr_cells = parse_unsigned(value);
+            else if (key == "dx")
+                params.cell_size = parse_double(value);
+            else if (key == "ghosts")
+                params.nbr_ghosts = parse_unsigned(value);
+            else if (key == "dt")
+                params.dt = parse_double(value);
+            else if (key == "final_time")
+                params.final_time = parse_double(value);
+            else if (key == "nppc")
+                params.populations[0].nppc = parse_unsigned(value);
+            else if (key == "bx")
+                params.bx = make_profile(value);
+            else if (key == "by")
+                params.by = make_profile(value);
+            else if (key == "bz")
+                params.bz = make_profile(value);
+            else if (key == "density")
+                params.populations[0].density = make_profile(value);
+            else
+                throw std::runtime_error("ensemble line " + std::to_string(line_number)
+                                         + ": unknown key " + key);
+        }
+        params.diag_prefix = name + "_";
+        members.push_back(params);
+    }
+    return members;
+}
+
+
+
+
+// runs independent simulations concurrently, each worker thread takes the next member
+// when it is done with the previous one. Members run single threaded.
+// Failures are collected and reported once all members are done.
+inline void run_ensemble(std::vector<SimulationParameters> const& members,
+                         std::size_t nbr_workers)
+{
+    std::atomic<std::size_t> next{0};
+    std::mutex errors_mutex;
+    std::vector<std::string> errors;
+
+    auto const worker = [&]() {
+        set_threads(1);
+        for (auto iMember = next++; iMember < members.size(); iMember = next++)
+        {
+            try
+            {
+                run(members[iMember]);
+                std::lock_guard lock{errors_mutex};
+                std::cout << members[iMember].diag_prefix << " done\n";
+            }
+            catch (std::exception const& e)
+            {
+                std::lock_guard lock{errors_mutex};
+                errors.push_back(members[iMember].diag_prefix + ": " + e.what());
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (auto iWorker = 0u; iWorker < std::max<std::size_t>(nbr_workers, 1); ++iWorker)
+        workers.emplace_back(worker);
+    for (auto& thread : workers)
+        thread.join();
+
+    if (!errors.empty())
+    {
+        for (auto const& error : errors)
+            std::cout << "ensemble member failed " << error << "\n";
+        throw std::runtime_error(std::to_string(errors.size()) + " ensemble members failed");
+    }
+}
+
+
+#endif // HYBIRT_ENSEMBLE_HPP
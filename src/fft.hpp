@@ -0,0 +1,107 @@
+#ifndef HYBIRT_FFT_HPP
+#define HYBIRT_FFT_HPP
+
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <numbers>
+#include <utility>
+#include <vector>
+
+
+// minimal header-only FFT, unnormalized in both directions:
+// X[k] = sum_n x[n] exp(-+ 2 i pi k n / size)
+// sizes that are powers of two use an in-place radix-2 transform,
+// other sizes go through Bluestein's chirp-z algorithm
+
+
+inline bool is_power_of_two(std::size_t n)
+{
+    return n != 0 and (n & (n - 1)) == 0;
+}
+
+
+inline void fft_radix2(std::vector<std::complex<double>>& data, bool inverse)
+{
+    auto const size = data.size();
+
+    // bit reversal permutation
+    for (std::size_t i = 1, j = 0; i < size; ++i)
+    {
+        auto bit = size >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            std::swap(data[i], data[j]);
+    }
+
+    auto const sign = inverse ? 1.0 : -1.0;
+    for (std::size_t length = 2; length <= size; length <<= 1)
+    {
+        auto const angle = sign * 2 * std::numbers::pi / length;
+        std::complex<double> const w_length{std::cos(angle), std::sin(angle)};
+        for (std::size_t start = 0; start < size; start += length)
+        {
+            std::complex<double> w{1.0, 0.0};
+            for (std::size_t k = 0; k < length / 2; ++k)
+            {
+                auto const even = data[start + k];
+                auto const odd  = data[start + k + length / 2] * w;
+
+                data[start + k]              = even + odd;
+                data[start + k + length / 2] = even - odd;
+                w *= w_length;
+            }
+        }
+    }
+}
+
+
+inline void fft_bluestein(std::vector<std::complex<double>>& data, bool inverse)
+{
+    auto const size       = data.size();
+    std::size_t conv_size = 1;
+    while (conv_size < 2 * size - 1)
+        conv_size <<= 1;
+
+    auto const sign = inverse ? 1.0 : -1.0;
+    std::vector<std::complex<double>> chirp(size);
+    for (std::size_t n = 0; n < size; ++n)
+    {
+        // n^2 mod 2*size keeps the angle accurate for large n
+        auto const n2    = (n * n) % (2 * size);
+        auto const angle = sign * std::numbers::pi * n2 / size;
+        chirp[n]         = {std::cos(angle), std::sin(angle)};
+    }
+
+    std::vector<std::complex<double>> a(conv_size, 0.0), b(conv_size, 0.0);
+    for (std::size_t n = 0; n < size; ++n)
+        a[n] = data[n] * chirp[n];
+    b[0] = std::conj(chirp[0]);
+    for (std::size_t n = 1; n < size; ++n)
+        b[n] = b[conv_size - n] = std::conj(chirp[n]);
+
+    fft_radix2(a, false);
+    fft_radix2(b, false);
+    for (std::size_t i = 0; i < conv_size; ++i)
+        a[i] *= b[i];
+    fft_radix2(a, true);
+
+    for (std::size_t k = 0; k < size; ++k)
+        data[k] = a[k] * chirp[k] / static_cast<double>(conv_size);
+}
+
+
+inline void fft(std::vector<std::complex<double>>& data, bool inverse = false)
+{
+    if (data.size() <= 1)
+        return;
+    if (is_power_of_two(data.size()))
+        fft_radix2(data, inverse);
+    else
+        fft_bluestein(data, inverse);
+}
+
+
+#endif // HYBIRT_FFT_HPP
@@ -2,10 +2,12 @@
 #define HYBRIDIR_FIELD_HPP
 
 #include "gridlayout.hpp"
+#include "allocator.hpp"
 
 #include <cstddef>
 #include <vector>
 #include <numeric>
+#include <tuple>
 
 template<std::size_t dimension>
 class Field
@@ -53,12 +55,13 @@ public:
 
     auto quantity() const { return m_qty; }
 
-    auto data() { return m_data; }
-    auto data() const { return m_data; }
+    auto& data() { return m_data; }
+    auto const& data() const { return m_data; }
+    auto size() const { return m_data.size(); }
 
 private:
     std::array<std::size_t, dimension> m_size;
-    std::vector<double> m_data;
+    std::vector<double, FirstTouchAllocator<double, Subsystem::fields>> m_data;
     Quantity m_qty;
 };
 
@@ -0,0 +1,93 @@
+#ifndef HYBIRT_FILTER_HPP
+#define HYBIRT_FILTER_HPP
+
+#include "field.hpp"
+#include "vecfield.hpp"
+#include "gridlayout.hpp"
+#include "allocator.hpp"
+#include "timers.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+
+// binomial smoothing of the moments and of the current, optionally compensated.
+//
+// A pass replaces every domain node by (f[i-1] + 2 f[i] + f[i+1]) / 4: the grid scale mode
+// is removed and a mode k damped by cos^2(k dx / 2), so passes cut the particle noise that
+// would otherwise reach Ohm's law. n passes also damp long wavelengths by 1 - n (k dx)^2 / 4,
+// the compensation pass (-n/4, 1 + n/2, -n/4) brings them back to 1 + O((k dx)^4).
+// Each pass reads the ghosts left by the boundary condition and refills them after.
+template<std::size_t dimension>
+class BinomialFilter
+{
+public:
+    BinomialFilter(std::shared_ptr<GridLayout<dimension>> grid, std::size_t nbr_passes = 1,
+                   bool compensate = false)
+        : m_grid{grid}
+        , m_nbr_passes{nbr_passes}
+        , m_compensate{compensate}
+    {
+        if (!m_grid)
+            throw std::runtime_error("GridLayout is null");
+        if (m_grid->nbr_ghosts() < 1)
+            throw std::runtime_error("the binomial filter needs a ghost node on each side");
+    }
+
+    template<typename Boundary>
+    void operator()(Field<dimension>& field, Boundary& boundary)
+    {
+        if (m_nbr_passes == 0)
+            return;
+        HYBIRT_TIME_SCOPE("filter");
+
+        for (std::size_t iPass = 0; iPass < m_nbr_passes; ++iPass)
+            pass(field, boundary, 0.25, 0.5);
+        if (m_compensate)
+            pass(field, boundary, -0.25 * m_nbr_passes, 1. + 0.5 * m_nbr_passes);
+    }
+
+    template<typename Boundary>
+    void operator()(VecField<dimension>& vecfield, Boundary& boundary)
+    {
+        (*this)(vecfield.x, boundary);
+        (*this)(vecfield.y, boundary);
+        (*this)(vecfield.z, boundary);
+    }
+
+    auto nbr_passes() const { return m_nbr_passes; }
+
+
+private:
+    // the domain nodes are computed from a copy, so that the loop carries no dependency
+    // and vectorizes
+    template<typename Boundary>
+    void pass(Field<dimension>& field, Boundary& boundary, double side, double center)
+    {
+        static_assert(dimension == 1, "BinomialFilter only implemented for 1D");
+        auto const qty = field.quantity();
+        auto const dsi = m_grid->dom_start(qty, Direction::X);
+        auto const dei = m_grid->dom_end(qty, Direction::X);
+
+        m_copy.assign(field.begin(), field.end());
+        double const* in = m_copy.data();
+        double* out      = &*field.begin();
+
+#pragma omp simd
+        for (auto ix = dsi; ix <= dei; ++ix)
+            out[ix] = side * (in[ix - 1] + in[ix + 1]) + center * in[ix];
+
+        boundary.refill(field);
+    }
+
+    std::shared_ptr<GridLayout<dimension>> m_grid;
+    std::size_t m_nbr_passes;
+    bool m_compensate;
+    // reused from one pass to the next
+    std::vector<double, FirstTouchAllocator<double, Subsystem::fields>> m_copy;
+};
+
+
+#endif // HYBIRT_FILTER_HPP
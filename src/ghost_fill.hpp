@@ -0,0 +1,217 @@
+#ifndef HYBIRT_GHOST_FILL_HPP
+#define HYBIRT_GHOST_FILL_HPP
+
+#include "field.hpp"
+#include "vecfield.hpp"
+#include "gridlayout.hpp"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+
+// periodic ghost filling from a plan built once per layout.
+//
+// For each quantity the plan is a list of (node, source) flat indexes: moments deposited
+// by particles (N, Vx, Vy, Vz) first fold what landed on the ghosts (and on the last
+// primal node) into the domain node they are the image of, then every ghost copies its
+// periodic image, as for every other quantity. Filling is then two branch-free loops per
+// field, with no layout query and no test on the quantity.
+// Indexes are flat, so 2D/3D face, edge and corner ghosts are only more entries of the
+// same lists, the kernels do not change.
+template<std::size_t dimension>
+class GhostFillPlan
+{
+public:
+    struct Transfer
+    {
+        std::size_t ghost; // node updated, a domain node for accumulations
+        std::size_t source;
+    };
+
+    explicit GhostFillPlan(GridLayout<dimension> const& layout)
+    {
+        for (auto qty : {Quantity::Ex, Quantity::Ey, Quantity::Ez, Quantity::Bx, Quantity::By,
+                         Quantity::Bz, Quantity::Jx, Quantity::Jy, Quantity::Jz, Quantity::N,
+                         Quantity::Vx, Quantity::Vy, Quantity::Vz})
+            build(layout, qty);
+    }
+
+
+    void fill(Field<dimension>& field) const
+    {
+        auto const& plan = m_plans[static_cast<std::size_t>(field.quantity())];
+        auto data        = field.begin();
+
+        // accumulations first, the copies then spread the folded moments to the ghosts
+        for (auto const& transfer : plan.accumulate)
+            data[transfer.ghost] += data[transfer.source];
+        copy(field);
+    }
+
+    // copies only, for fields whose domain nodes are already final
+    void copy(Field<dimension>& field) const
+    {
+        auto const& plan = m_plans[static_cast<std::size_t>(field.quantity())];
+        auto data        = field.begin();
+        for (auto const& transfer : plan.copy)
+            data[transfer.ghost] = data[transfer.source];
+    }
+
+    void fill(VecField<dimension>& vecfield) const
+    {
+        fill(vecfield.x);
+        fill(vecfield.y);
+        fill(vecfield.z);
+    }
+
+    // fills any list of fields and vector fields in one call
+    template<typename... Fields>
+    void fill_all(Fields&... fields) const
+    {
+        (fill(fields), ...);
+    }
+
+    auto const& accumulations(Quantity qty) const
+    {
+        return m_plans[static_cast<std::size_t>(qty)].accumulate;
+    }
+    auto const& copies(Quantity qty) const { return m_plans[static_cast<std::size_t>(qty)].copy; }
+
+    // quantities deposited by the particles, whose ghosts hold part of the deposit
+    static bool is_moment(Quantity qty)
+    {
+        return qty == Quantity::N or qty == Quantity::Vx or qty == Quantity::Vy
+               or qty == Quantity::Vz;
+    }
+
+
+private:
+    struct QuantityPlan
+    {
+        std::vector<Transfer> accumulate;
+        std::vector<Transfer> copy;
+    };
+
+    void build(GridLayout<dimension> const& layout, Quantity qty)
+    {
+        auto& plan = m_plans[static_cast<std::size_t>(qty)];
+
+        if constexpr (dimension == 1)
+        {
+            std::size_t const gsi = layout.ghost_start(qty, Direction::X);
+            std::size_t const dsi = layout.dom_start(qty, Direction::X);
+            std::size_t const dei = layout.dom_end(qty, Direction::X);
+            std::size_t const gei = layout.ghost_end(qty, Direction::X);
+
+            auto const nbr_nodes = layout.nbr_cells(Direction::X);
+
+            // the last primal node of a moment is the image of the first one, it is folded
+            // and filled like a ghost
+            auto const primal = layout.centerings(qty)[0] == layout.primal;
+            auto const last   = is_moment(qty) and primal ? dei - 1 : dei;
+
+            // what shapes of order 2 and more deposit on the ghosts belongs to their image
+            if (is_moment(qty))
+            {
+                for (auto ix_right = last + 1; ix_right <= gei; ++ix_right)
+                    plan.accumulate.push_back({ix_right - nbr_nodes, ix_right});
+                for (auto ix_left = gsi; ix_left < dsi; ++ix_left)
+                    plan.accumulate.push_back({ix_left + nbr_nodes, ix_left});
+            }
+            for (auto ix_left = gsi; ix_left < dsi; ++ix_left)
+                plan.copy.push_back({ix_left, ix_left + nbr_nodes});
+            for (auto ix_right = last + 1; ix_right <= gei; ++ix_right)
+                plan.copy.push_back({ix_right, ix_right - nbr_nodes});
+        }
+    }
+
+    std::array<QuantityPlan, static_cast<std::size_t>(Quantity::Vz) + 1> m_plans;
+};
+
+
+
+
+// one ghost node update between domains: the ghost takes (copy) or adds (accumulate) the
+// node source of its left (-1) or right (+1) neighbour, which is itself for a periodic domain.
+// Accumulations update domain nodes, with the ghosts of the neighbours.
+struct GhostTransfer
+{
+    std::size_t ghost;
+    std::size_t source;
+    int neighbour;
+};
+
+
+// ghost transfers of a domain that has neighbours, patches or MPI ranks.
+//
+// Same updates as GhostFillPlan, but the images live in the neighbours. Accumulations read
+// values from before the exchange and copies values from after the accumulations, so that
+// a moment is filled in two exchanges, accumulations then copies, and within each every
+// value can be read (or sent) first and written after, in any order. Indexes only depend on
+// the centering and the number of ghosts, except the sources in the left neighbour, found
+// with the local number of cells, which is why neighbours of different sizes exchange
+// correctly too: the sender evaluates the sources of the transfers at the same position in
+// its own plan.
+template<std::size_t dimension>
+class NeighbourGhostPlan
+{
+public:
+    struct Transfers
+    {
+        std::vector<GhostTransfer> accumulate;
+        std::vector<GhostTransfer> copy;
+    };
+
+    NeighbourGhostPlan() = default;
+
+    explicit NeighbourGhostPlan(GridLayout<dimension> const& layout)
+    {
+        for (auto qty : {Quantity::Ex, Quantity::Ey, Quantity::Ez, Quantity::Bx, Quantity::By,
+                         Quantity::Bz, Quantity::Jx, Quantity::Jy, Quantity::Jz, Quantity::N,
+                         Quantity::Vx, Quantity::Vy, Quantity::Vz})
+            build(layout, qty);
+    }
+
+    auto const& transfers(Quantity qty) const { return m_plans[static_cast<std::size_t>(qty)]; }
+
+
+private:
+    void build(GridLayout<dimension> const& layout, Quantity qty)
+    {
+        auto& plan = m_plans[static_cast<std::size_t>(qty)];
+
+        if constexpr (dimension == 1)
+        {
+            std::size_t const gsi = layout.ghost_start(qty, Direction::X);
+            std::size_t const dsi = layout.dom_start(qty, Direction::X);
+            std::size_t const dei = layout.dom_end(qty, Direction::X);
+            std::size_t const gei = layout.ghost_end(qty, Direction::X);
+
+            auto const nbr_nodes = layout.nbr_cells(Direction::X);
+            bool const moment    = qty == Quantity::N or qty == Quantity::Vx
+                                or qty == Quantity::Vy or qty == Quantity::Vz;
+
+            // the last primal node of a moment is the first node of the right neighbour
+            auto const primal = layout.centerings(qty)[0] == layout.primal;
+            auto const last   = moment and primal ? dei - 1 : dei;
+
+            if (moment)
+            {
+                for (auto ix_right = last + 1; ix_right <= gei; ++ix_right)
+                    plan.accumulate.push_back({ix_right - nbr_nodes, ix_right, -1});
+                for (auto ix_left = gsi; ix_left < dsi; ++ix_left)
+                    plan.accumulate.push_back({ix_left + nbr_nodes, ix_left, +1});
+            }
+            for (auto ix_left = gsi; ix_left < dsi; ++ix_left)
+                plan.copy.push_back({ix_left, ix_left + nbr_nodes, -1});
+            for (auto ix_right = last + 1; ix_right <= gei; ++ix_right)
+                plan.copy.push_back({ix_right, ix_right - nbr_nodes, +1});
+        }
+    }
+
+    std::array<Transfers, static_cast<std::size_t>(Quantity::Vz) + 1> m_plans;
+};
+
+
+#endif // HYBIRT_GHOST_FILL_HPP
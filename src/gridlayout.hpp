@@ -28,6 +28,7 @@ public:
     }
 
     auto nbr_cells(Direction dir_idx) const { return m_nbr_cells[dir_idx]; }
+    auto nbr_ghosts() const { return m_nbr_ghosts; }
 
     auto nbr_dom_nodes(Quantity qty, Direction dir_idx) const
     {
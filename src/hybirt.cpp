@@ -1,44 +1,12 @@
-#include "vecfield.hpp"
-#include "field.hpp"
+#include "simulation.hpp"
+#include "input_deck.hpp"
+#include "timers.hpp"
+#include "perf_counters.hpp"
 
-#include "faraday.hpp"
-#include "ampere.hpp"
-#include "ohm.hpp"
-#include "utils.hpp"
-#include "gridlayout.hpp"
-#include "boundary_condition.hpp"
-#include "moments.hpp"
-#include "pusher.hpp"
-#include "diagnostics.hpp"
-#include "population.hpp"
+#include <cstdlib>
+#include <string>
 
-#include "highfive/highfive.hpp"
 
-#include <iostream>
-#include <array>
-#include <vector>
-#include <cstdint>
-#include <memory>
-#include <algorithm>
-
-
-
-
-template<std::size_t dimension>
-void average(Field<dimension> const& F1, Field<dimension> const& F2, Field<dimension>& Favg)
-{
-    // use std::transform to do an average of F1 and F2
-}
-
-
-template<std::size_t dimension>
-void average(VecField<dimension> const& V1, VecField<dimension> const& V2,
-             VecField<dimension>& Vavg)
-{
-    average(V1.x, V2.x, Vavg.x);
-    average(V1.y, V2.y, Vavg.y);
-    average(V1.z, V2.z, Vavg.z);
-}
 
 
 double bx(double x)
@@ -67,101 +35,56 @@ double density(double x)
 }
 
 
-void magnetic_init(VecField<1>& B, GridLayout<1> const& layout)
-{
-    // Initialize magnetic field B
-    for (auto ix = layout.primal_dom_start(Direction::X); ix <= layout.primal_dom_end(Direction::X);
-         ++ix)
-    {
-        auto x = layout.coordinate(Direction::X, Quantity::Bx, ix);
-
-        B.x(ix) = bx(x); // Bx
-    }
-    for (auto ix = layout.dual_dom_start(Direction::X); ix <= layout.dual_dom_end(Direction::X);
-         ++ix)
-    {
-        auto x = layout.coordinate(Direction::X, Quantity::By, ix);
-
-        B.y(ix) = by(x); // By
-        B.z(ix) = bz(x); // Bz, uniform magnetic field in z-direction
-    }
-}
-
-
 
 
-int main()
+// hybirt [--estimate-memory] [input_deck.ini]
+// without an input deck, the run is defined by the parameters and profiles of this file.
+// --estimate-memory prints the footprint the run would need and exits without running it.
+int main(int argc, char** argv)
 {
-    double time                     = 0.;
-    double final_time               = 10.0000;
-    double dt                       = 0.001;
-    std::size_t constexpr dimension = 1;
-
-    std::array<std::size_t, dimension> grid_size = {100};
-    std::array<double, dimension> cell_size      = {0.2};
-    auto constexpr nbr_ghosts                    = 1;
-    auto constexpr nppc                          = 100;
-
-    auto layout = std::make_shared<GridLayout<dimension>>(grid_size, cell_size, nbr_ghosts);
-
-    VecField<dimension> E{layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
-    VecField<dimension> B{layout, {Quantity::Bx, Quantity::By, Quantity::Bz}};
-    VecField<dimension> Enew{layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
-    VecField<dimension> Bnew{layout, {Quantity::Bx, Quantity::By, Quantity::Bz}};
-    VecField<dimension> Eavg{layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
-    VecField<dimension> Bavg{layout, {Quantity::Bx, Quantity::By, Quantity::Bz}};
-    VecField<dimension> J{layout, {Quantity::Jx, Quantity::Jy, Quantity::Jz}};
-    VecField<dimension> V{layout, {Quantity::Vx, Quantity::Vy, Quantity::Vz}};
-    Field<dimension> N{layout->allocate(Quantity::N), Quantity::N};
-
-    auto boundary_condition = BoundaryConditionFactory<dimension>::create("periodic", layout);
-
-    std::vector<Population<1>> populations;
-    populations.emplace_back("main", layout);
-    for (auto& pop : populations)
-        pop.load_particles(nppc, density);
-
-
-    magnetic_init(B, *layout);
-    boundary_condition->fill(B);
+    // HYBIRT_TRACE=trace.json also records every timed scope for chrome://tracing or Perfetto
+    char const* trace_file = std::getenv("HYBIRT_TRACE");
+    Timers::instance().enable_trace(trace_file != nullptr);
 
-    // Faraday<dimension> faraday{layout, dt};  // TODO uncomment when Faraday is implemented
-    Ampere<dimension> ampere{layout};
-    Ohm<dimension> ohm{layout};
-    Boris<dimension> push{layout, dt};
-
-
-
-    ampere(B, J);
-    boundary_condition->fill(J);
-    for (auto& pop : populations)
+    bool const estimate_only = argc > 1 and std::string{argv[1]} == "--estimate-memory";
+    if (estimate_only)
     {
-        pop.deposit();
-        boundary_condition->fill(pop.flux());
-        boundary_condition->fill(pop.density());
+        --argc;
+        ++argv;
     }
 
-    total_density(populations, N);
-    bulk_velocity<dimension>(populations, N, V);
-    ohm(B, J, N, V, E);
-    boundary_condition->fill(E);
-
-    diags_write_fields(B, E, V, N, time, HighFive::File::Truncate);
-    diags_write_particles(populations, time, HighFive::File::Truncate);
-
-    while (time < final_time)
+    SimulationParameters params;
+    if (argc > 1)
+        params = read_input_deck(argv[1]);
+    else
     {
-        std::cout << "Time: " << time << " / " << final_time << "\n";
-
-        // TODO implement ICN temporal integration
-
-
-        time += dt;
-        diags_write_fields(B, E, V, N, time);
-        std::cout << "**********************************\n";
-        // diags_write_particles(populations, time);
+        params.nbr_cells              = 100;
+        params.cell_size              = 0.2;
+        params.dt                     = 0.001;
+        params.final_time             = 10.0000;
+        params.bx                     = bx;
+        params.by                     = by;
+        params.bz                     = bz;
+        params.populations[0].nppc    = 100;
+        params.populations[0].density = density;
     }
 
+    if (estimate_only or params.verbose)
+        memory_estimate(params).print();
+    if (estimate_only)
+        return 0;
+
+    run(params);
+
+#ifdef HYBIRT_TIMERS
+    Timers::instance().print_summary();
+    if (trace_file)
+        Timers::instance().write_chrome_trace(trace_file);
+#endif
+#ifdef HYBIRT_PERF_COUNTERS
+    PerfCounters::instance().print_summary();
+#endif
+
 
     return 0;
 }
@@ -0,0 +1,38 @@
+#include "ensemble.hpp"
+#include "timers.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+
+// hybirt-ensemble members.txt [nbr_workers]
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "usage: " << argv[0] << " ensemble_file [nbr_workers]\n";
+        return 1;
+    }
+
+    std::ifstream input{argv[1]};
+    if (!input)
+    {
+        std::cout << "cannot open " << argv[1] << "\n";
+        return 1;
+    }
+    auto const members = parse_ensemble(input);
+
+    std::size_t nbr_workers = argc > 2 ? std::stoul(argv[2]) : std::thread::hardware_concurrency();
+    std::cout << "running " << members.size() << " simulations on " << nbr_workers
+              << " threads\n";
+
+    run_ensemble(members, nbr_workers);
+
+#ifdef HYBIRT_TIMERS
+    Timers::instance().print_summary();
+#endif
+
+    return 0;
+}
@@ -0,0 +1,472 @@
+#ifndef HYBIRT_INPUT_DECK_HPP
+#define HYBIRT_INPUT_DECK_HPP
+
+#include "simulation.hpp"
+#include "profiles.hpp"
+
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <istream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// runtime input deck, INI style:
+//
+//   # comments start with '#' or ';'
+//   [simulation]
+//   dimension  = 1
+//   nbr_cells  = 100
+//   cell_size  = 0.2
+//   nbr_ghosts = 2                (absent: what the particle shape needs)
+//   dt         = 0.001
+//   final_time = 10
+//   pusher     = boris
+//   boundary   = periodic         (or open)
+//   single_pass_moments = false    (true: populations deposit into the total moments only)
+//
+//   [fields]
+//   bx = 0
+//   by = 1
+//   bz = sine:0,0.01,0.314        (profiles are described in profiles.hpp)
+//
+//   [population.protons]           (one section per population, in order)
+//   nppc               = 100
+//   density            = 1
+//   bulk_velocity      = 0, 0, 0
+//   thermal_velocity   = 0.2, 0.2, 0.2
+//   mass               = 1
+//   charge             = 1
+//   track_one_out_of   = 100
+//   inflow             = none         (left, right or both with boundary = open)
+//   delta_f            = false        (true: particles carry density - background_density)
+//   background_density = 1
+//
+//   [filter]                       (binomial smoothing of the moments and the current)
+//   passes     = 2
+//   compensate = true
+//
+//   [resampling]                   (merging and splitting of particles, every = 0 disables it)
+//   every         = 10
+//   min_ppc       = 50
+//   max_ppc       = 200
+//   velocity_bins = 8
+//
+//   [window]                       (frame moving at velocity, needs boundary = open)
+//   velocity = 0.5
+//
+//   [time_step]                    (dt adapted to the stability limits, from dt above)
+//   adaptive   = true
+//   cfl        = 0.5
+//   min_dt     = 0.0001            (0 or absent: dt / 1000)
+//   max_dt     = 0.01              (0 or absent: 10 dt)
+//   hysteresis = 1.5
+//   max_growth = 1.2
+//
+//   [diagnostics]
+//   prefix          = run1_
+//   fields_every    = 1
+//   particles_every = 0
+//   tracked_every   = 1
+//   reduced_every   = 1
+//   spectral_every  = 1
+//
+//   [histogram.fvxvy]              (velocity histograms of every population in reduced.h5,
+//   components = vx, vy             one section each, replacing the default fvx and fvxvy)
+//   bins       = 50, 50             (one value per component)
+//   vmin       = -1, -1
+//   vmax       = 1, 1
+//   window     = 0, 10             (x range of the particles counted, absent: the domain)
+//
+// every key is optional and defaults to SimulationParameters, unknown sections
+// and keys are errors so that typos do not silently run the default.
+class InputDeck
+{
+public:
+    explicit InputDeck(std::istream& input)
+    {
+        std::string line;
+        std::string section;
+        std::size_t line_number = 0;
+
+        while (std::getline(input, line))
+        {
+            ++line_number;
+            line = trim(line.substr(0, line.find_first_of("#;")));
+            if (line.empty())
+                continue;
+
+            if (line.front() == '[')
+            {
+                if (line.back() != ']')
+                    throw error(line_number, "unterminated section " + line);
+                section = trim(line.substr(1, line.size() - 2));
+                if (m_sections.count(section) > 0)
+                    throw error(line_number, "duplicate section " + section);
+                m_sections[section];
+                m_order.push_back(section);
+                m_lines[section][""] = line_number;
+                continue;
+            }
+
+            auto const equal = line.find('=');
+            if (equal == std::string::npos or section.empty())
+                throw error(line_number, "expected key = value in a section: " + line);
+
+            auto const key = trim(line.substr(0, equal));
+            if (m_sections[section].count(key) > 0)
+                throw error(line_number, "duplicate key " + key + " in " + section);
+            m_sections[section][key] = trim(line.substr(equal + 1));
+            m_lines[section][key]    = line_number;
+        }
+    }
+
+    auto const& sections() const { return m_order; }
+
+    bool has(std::string const& section, std::string const& key) const
+    {
+        auto const found = m_sections.find(section);
+        return found != m_sections.end() and found->second.count(key) > 0;
+    }
+
+    std::string const& get(std::string const& section, std::string const& key) const
+    {
+        return m_sections.at(section).at(key);
+    }
+
+    auto const& keys(std::string const& section) const { return m_sections.at(section); }
+
+    // error about the value of a key, or about a section for an empty key, with its line
+    std::runtime_error error(std::string const& section, std::string const& key,
+                             std::string const& message) const
+    {
+        auto const where = "[" + section + "]" + (key.empty() ? "" : " " + key);
+        return error(m_lines.at(section).at(key), where + ": " + message);
+    }
+
+
+private:
+    static std::string trim(std::string const& text)
+    {
+        auto const first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            return "";
+        auto const last = text.find_last_not_of(" \t\r");
+        return text.substr(first, last - first + 1);
+    }
+
+    static std::runtime_error error(std::size_t line_number, std::string const& message)
+    {
+        return std::runtime_error("input deck line " + std::to_string(line_number) + ": "
+                                  + message);
+    }
+
+    std::map<std::string, std::map<std::string, std::string>> m_sections;
+    std::vector<std::string> m_order;
+    std::map<std::string, std::map<std::string, std::size_t>> m_lines; // "" for the section
+};
+
+
+
+
+inline std::array<double, 3> parse_vector3(std::string const& value)
+{
+    std::array<double, 3> vector{};
+    std::stringstream stream{value};
+    std::string item;
+    std::size_t count = 0;
+    while (std::getline(stream, item, ','))
+    {
+        if (count == 3)
+            throw std::runtime_error("expected 3 components, got '" + value + "'");
+        vector[count++] = parse_double(item);
+    }
+    if (count != 3)
+        throw std::runtime_error("expected 3 components, got '" + value + "'");
+    return vector;
+}
+
+
+
+
+// comma separated items, each read with parse
+template<typename Parse>
+auto parse_list(std::string const& value, Parse parse)
+{
+    std::vector<decltype(parse(value))> items;
+    std::stringstream stream{value};
+    std::string item;
+    while (std::getline(stream, item, ','))
+        items.push_back(parse(item));
+    return items;
+}
+
+
+
+
+// velocity component vx, vy or vz, as its index
+inline std::size_t parse_component(std::string const& value)
+{
+    auto const name = trim_blanks(value);
+    if (name == "vx" or name == "vy" or name == "vz")
+        return static_cast<std::size_t>(name[1] - 'x');
+    throw std::runtime_error("expected vx, vy or vz, got '" + value + "'");
+}
+
+
+
+
+inline bool parse_bool(std::string const& value)
+{
+    if (value == "true" or value == "1" or value == "yes")
+        return true;
+    if (value == "false" or value == "0" or value == "no")
+        return false;
+    throw std::runtime_error("expected true or false, got '" + value + "'");
+}
+
+
+
+
+inline std::string const population_section = "population.";
+
+inline std::string const histogram_section = "histogram.";
+
+inline bool is_population_section(std::string const& section)
+{
+    return section.rfind(population_section, 0) == 0;
+}
+
+inline bool is_histogram_section(std::string const& section)
+{
+    return section.rfind(histogram_section, 0) == 0;
+}
+
+
+// sets the parameter of one key, the population or histogram of their sections is the last one
+inline void read_input_key(SimulationParameters& params, std::string const& section,
+                           std::string const& key, std::string const& value)
+{
+    if (section == "simulation")
+    {
+        if (key == "dimension")
+            params.dimension = parse_unsigned(value);
+        else if (key == "nbr_cells")
+            params.nbr_cells = parse_unsigned(value);
+        else if (key == "cell_size")
+            params.cell_size = parse_double(value);
+        else if (key == "nbr_ghosts")
+            params.nbr_ghosts = parse_unsigned(value);
+        else if (key == "dt")
+            params.dt = parse_double(value);
+        else if (key == "final_time")
+            params.final_time = parse_double(value);
+        else if (key == "pusher")
+            params.pusher = value;
+        else if (key == "boundary")
+            params.boundary = value;
+        else if (key == "single_pass_moments")
+            params.single_pass_moments = parse_bool(value);
+        else
+            throw std::runtime_error("unknown key");
+    }
+    else if (section == "fields")
+    {
+        if (key == "bx")
+            params.bx = make_profile(value);
+        else if (key == "by")
+            params.by = make_profile(value);
+        else if (key == "bz")
+            params.bz = make_profile(value);
+        else
+            throw std::runtime_error("unknown key");
+    }
+    else if (is_population_section(section))
+    {
+        auto& pop = params.populations.back();
+        if (key == "nppc")
+            pop.nppc = parse_unsigned(value);
+        else if (key == "density")
+            pop.density = make_profile(value);
+        else if (key == "bulk_velocity")
+            pop.V = parse_vector3(value);
+        else if (key == "thermal_velocity")
+            pop.Vth = parse_vector3(value);
+        else if (key == "mass")
+            pop.mass = parse_double(value);
+        else if (key == "charge")
+            pop.charge = parse_double(value);
+        else if (key == "track_one_out_of")
+            pop.track_one_out_of = parse_unsigned(value);
+        else if (key == "inflow")
+            pop.inflow = value;
+        else if (key == "delta_f")
+            pop.delta_f = parse_bool(value);
+        else if (key == "background_density")
+            pop.background_density = parse_double(value);
+        else
+            throw std::runtime_error("unknown key");
+    }
+    else if (section == "filter")
+    {
+        if (key == "passes")
+            params.filter.passes = parse_unsigned(value);
+        else if (key == "compensate")
+            params.filter.compensate = parse_bool(value);
+        else
+            throw std::runtime_error("unknown key");
+    }
+    else if (section == "resampling")
+    {
+        auto& resampling = params.resampling;
+        if (key == "every")
+            resampling.every = parse_unsigned(value);
+        else if (key == "min_ppc")
+            resampling.min_ppc = parse_unsigned(value);
+        else if (key == "max_ppc")
+            resampling.max_ppc = parse_unsigned(value);
+        else if (key == "velocity_bins")
+            resampling.velocity_bins = parse_unsigned(value);
+        else
+            throw std::runtime_error("unknown key");
+    }
+    else if (section == "window")
+    {
+        if (key == "velocity")
+            params.window.velocity = parse_double(value);
+        else
+            throw std::runtime_error("unknown key");
+    }
+    else if (section == "time_step")
+    {
+        auto& time_step = params.time_step;
+        if (key == "adaptive")
+            time_step.adaptive = parse_bool(value);
+        else if (key == "cfl")
+            time_step.cfl = parse_double(value);
+        else if (key == "min_dt")
+            time_step.min_dt = parse_double(value);
+        else if (key == "max_dt")
+            time_step.max_dt = parse_double(value);
+        else if (key == "hysteresis")
+            time_step.hysteresis = parse_double(value);
+        else if (key == "max_growth")
+            time_step.max_growth = parse_double(value);
+        else
+            throw std::runtime_error("unknown key");
+    }
+    else if (section == "diagnostics")
+    {
+        auto& diags = params.diagnostics;
+        if (key == "prefix")
+            params.diag_prefix = value;
+        else if (key == "fields_every")
+            diags.fields_every = parse_unsigned(value);
+        else if (key == "particles_every")
+            diags.particles_every = parse_unsigned(value);
+        else if (key == "tracked_every")
+            diags.tracked_every = parse_unsigned(value);
+        else if (key == "reduced_every")
+            diags.reduced_every = parse_unsigned(value);
+        else if (key == "spectral_every")
+            diags.spectral_every = parse_unsigned(value);
+        else
+            throw std::runtime_error("unknown key");
+    }
+    else if (is_histogram_section(section))
+    {
+        auto& histogram = params.diagnostics.histograms.back();
+        if (key == "components")
+            histogram.components = parse_list(value, parse_component);
+        else if (key == "bins")
+            histogram.bins = parse_list(value, parse_unsigned);
+        else if (key == "vmin")
+            histogram.vmin = parse_list(value, parse_double);
+        else if (key == "vmax")
+            histogram.vmax = parse_list(value, parse_double);
+        else if (key == "window")
+        {
+            auto const window = parse_list(value, parse_double);
+            if (window.size() != 2)
+                throw std::runtime_error("expected xmin, xmax, got '" + value + "'");
+            histogram.window = {window[0], window[1]};
+        }
+        else
+            throw std::runtime_error("unknown key");
+    }
+}
+
+
+
+
+inline SimulationParameters read_input_deck(std::istream& input)
+{
+    InputDeck deck{input};
+    SimulationParameters params;
+    bool has_populations = false;
+    bool has_histograms  = false;
+
+    for (auto const& section : deck.sections())
+    {
+        if (is_population_section(section))
+        {
+            if (!has_populations)
+                params.populations.clear();
+            has_populations = true;
+
+            PopulationParameters pop;
+            pop.name = section.substr(population_section.size());
+            if (pop.name.empty())
+                throw deck.error(section, "", "population without a name");
+            params.populations.push_back(pop);
+        }
+        else if (is_histogram_section(section))
+        {
+            if (!has_histograms)
+                params.diagnostics.histograms.clear();
+            has_histograms = true;
+
+            HistogramParameters histogram;
+            histogram.name = section.substr(histogram_section.size());
+            if (histogram.name.empty())
+                throw deck.error(section, "", "histogram without a name");
+            params.diagnostics.histograms.push_back(histogram);
+        }
+        else if (section != "simulation" and section != "fields" and section != "filter"
+                 and section != "resampling" and section != "window" and section != "time_step"
+                 and section != "diagnostics")
+            throw deck.error(section, "", "unknown section");
+
+        // invalid values are reported with their key and line
+        for (auto const& [key, value] : deck.keys(section))
+        {
+            try
+            {
+                read_input_key(params, section, key, value);
+            }
+            catch (std::exception const& e)
+            {
+                throw deck.error(section, key, e.what());
+            }
+        }
+    }
+
+    return params;
+}
+
+
+inline SimulationParameters read_input_deck(std::string const& filename)
+{
+    std::ifstream input{filename};
+    if (!input)
+        throw std::runtime_error("cannot open input deck " + filename);
+    return read_input_deck(input);
+}
+
+
+#endif // HYBIRT_INPUT_DECK_HPP
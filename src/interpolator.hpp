@@ -0,0 +1,106 @@
+#ifndef HYBIRT_INTERPOLATOR_HPP
+#define HYBIRT_INTERPOLATOR_HPP
+
+#include "field.hpp"
+#include "gridlayout.hpp"
+#include "utils.hpp"
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+
+// order of the particle shape, the same for the gather of E and B and for the deposit of
+// the moments, chosen at configure time with -DHYBIRT_INTERP_ORDER=1, 2 or 3
+#ifndef HYBIRT_INTERP_ORDER
+#define HYBIRT_INTERP_ORDER 1
+#endif
+
+inline constexpr std::size_t interp_order = HYBIRT_INTERP_ORDER;
+
+
+
+
+// B-spline particle shape: 1 is linear (CIC), 2 quadratic (TSC) and 3 cubic.
+// Higher orders touch more nodes per particle but smooth the particle noise, so that the
+// same fidelity needs fewer particles per cell.
+template<std::size_t order>
+struct Shape
+{
+    static_assert(order >= 1 and order <= 3, "particle shapes of order 1, 2 or 3 only");
+
+    static constexpr std::size_t nbr_points = order + 1;
+
+    // ghost nodes needed on each side by particles inside the domain, for both centerings
+    static constexpr std::size_t nbr_ghosts = (order + 1) / 2;
+
+    struct Stencil
+    {
+        std::size_t first; // first node touched
+        std::array<double, nbr_points> weights;
+    };
+
+    // stencil of a particle at x, in units of nodes from the first allocated node, x >= 0.5
+    static constexpr Stencil at(double x)
+    {
+        if constexpr (order == 1)
+        {
+            auto const first = static_cast<std::size_t>(x);
+            auto const d     = x - first;
+            return {first, {1. - d, d}};
+        }
+        else if constexpr (order == 2)
+        {
+            auto const nearest = static_cast<std::size_t>(x + 0.5);
+            auto const d       = x - nearest;
+            return {nearest - 1, {0.5 * (0.5 - d) * (0.5 - d), 0.75 - d * d,
+                                  0.5 * (0.5 + d) * (0.5 + d)}};
+        }
+        else
+        {
+            auto const left = static_cast<std::size_t>(x);
+            auto const d    = x - left;
+            auto const d2   = d * d;
+            auto const d3   = d2 * d;
+            return {left - 1, {(1. - d) * (1. - d) * (1. - d) / 6., (4. - 6. * d2 + 3. * d3) / 6.,
+                               (1. + 3. * d + 3. * d2 - 3. * d3) / 6., d3 / 6.}};
+        }
+    }
+};
+
+
+// calls f(0), f(1) ... f(count - 1), unrolled at compile time
+template<std::size_t count, typename Function>
+constexpr void unroll(Function&& f)
+{
+    [&]<std::size_t... index>(std::index_sequence<index...>) {
+        (f(index), ...);
+    }(std::make_index_sequence<count>{});
+}
+
+
+// position x in the domain in units of the nodes of qty, counted from the first allocated one
+template<std::size_t dimension>
+double node_position(GridLayout<dimension> const& layout, Quantity qty, double x)
+{
+    auto const dual = layout.centerings(qty)[0] == layout.dual;
+    return x / layout.cell_size(Direction::X) + layout.nbr_ghosts() - (dual ? 0.5 : 0.);
+}
+
+
+// value of field at the particle position
+template<std::size_t order, std::size_t dimension>
+double interpolate(Field<dimension> const& field, GridLayout<dimension> const& layout,
+                   std::array<double, dimension> const& position)
+{
+    static_assert(dimension == 1, "interpolate only implemented for 1D");
+    auto const stencil = Shape<order>::at(node_position(layout, field.quantity(), position[0]));
+
+    double value = 0.;
+    unroll<Shape<order>::nbr_points>(
+        [&](std::size_t point) { value += stencil.weights[point] * field(stencil.first + point); });
+    return value;
+}
+
+
+#endif // HYBIRT_INTERPOLATOR_HPP
@@ -0,0 +1,303 @@
+#ifndef HYBIRT_MEMORY_ACCOUNTING_HPP
+#define HYBIRT_MEMORY_ACCOUNTING_HPP
+
+// current and peak bytes per subsystem
+//
+// Fields and particle arrays are counted by their allocator, FirstTouchAllocator, with the
+// bytes actually mapped: a block of huge pages counts whole huge pages. Short lived buffers,
+// the staging vectors of the diagnostics and what a HighFive write copies, are counted for
+// the scope that holds them:
+//
+//    MemoryScope const staging{Subsystem::diagnostics, 4 * nbr_particles * sizeof(double)};
+//
+// Each Simulation owns its accounting, so that the members of an ensemble each count their
+// own memory: memory is counted in the accounting in use on the thread that allocates it,
+// which MemoryAccounting::Use selects, instance() outside of any. Allocators remember the
+// accounting they count into, so that memory is released from it whichever thread frees it.
+// Particle arrays are also counted per population, by name.
+//
+// Counters are atomic, allocations may come from any thread. print() reports them in the log
+// and write_attributes() as attributes of an HDF5 object, memory_estimate() in simulation.hpp
+// predicts them before a run.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+
+enum class Subsystem { fields, particles, diagnostics, io };
+
+inline constexpr std::size_t nbr_subsystems = 4;
+inline constexpr std::array<char const*, nbr_subsystems> subsystem_names{"fields", "particles",
+                                                                         "diagnostics", "io"};
+
+
+class MemoryAccounting
+{
+public:
+    struct Counter
+    {
+        std::atomic<std::size_t> current{0};
+        std::atomic<std::size_t> peak{0};
+    };
+
+    // bytes of one population within its subsystem
+    struct Detail
+    {
+        std::string name;
+        Counter counter;
+    };
+
+
+    MemoryAccounting() = default;
+
+    MemoryAccounting(MemoryAccounting const&)            = delete;
+    MemoryAccounting& operator=(MemoryAccounting const&) = delete;
+
+    // what is allocated outside of any Use, e.g. by tools that build their own fields
+    static MemoryAccounting& instance()
+    {
+        static MemoryAccounting accounting;
+        return accounting;
+    }
+
+    // the accounting in use on this thread
+    static MemoryAccounting& current_accounting()
+    {
+        auto* const accounting = in_use();
+        return accounting ? *accounting : instance();
+    }
+
+    // counts what this thread allocates into an accounting for the lifetime of the Use, or
+    // until release()
+    class Use
+    {
+    public:
+        explicit Use(MemoryAccounting& accounting)
+            : m_previous{in_use()}
+        {
+            in_use() = &accounting;
+        }
+
+        ~Use() { release(); }
+
+        void release()
+        {
+            if (m_released)
+                return;
+            in_use()   = m_previous;
+            m_released = true;
+        }
+
+        Use(Use const&)            = delete;
+        Use& operator=(Use const&) = delete;
+
+    private:
+        MemoryAccounting* m_previous;
+        bool m_released = false;
+    };
+
+
+    // counter of the particles of a population, created on first use and never removed
+    Detail& particles(std::string const& population)
+    {
+        std::lock_guard lock{m_details_mutex};
+        for (auto& detail : m_details)
+            if (detail.name == population)
+                return detail;
+        auto& detail = m_details.emplace_back();
+        detail.name  = population;
+        return detail;
+    }
+
+    void allocated(Subsystem subsystem, std::size_t bytes, Detail* detail = nullptr)
+    {
+        auto& counter = m_counters[index(subsystem)];
+        raise_peak(counter.peak, counter.current.fetch_add(bytes) + bytes);
+        raise_peak(m_total.peak, m_total.current.fetch_add(bytes) + bytes);
+        if (detail)
+            raise_peak(detail->counter.peak, detail->counter.current.fetch_add(bytes) + bytes);
+    }
+
+    void released(Subsystem subsystem, std::size_t bytes, Detail* detail = nullptr)
+    {
+        m_counters[index(subsystem)].current.fetch_sub(bytes);
+        m_total.current.fetch_sub(bytes);
+        if (detail)
+            detail->counter.current.fetch_sub(bytes);
+    }
+
+    std::size_t current(Subsystem subsystem) const
+    {
+        return m_counters[index(subsystem)].current;
+    }
+    std::size_t peak(Subsystem subsystem) const { return m_counters[index(subsystem)].peak; }
+
+    // of the particles of a population, 0 before it allocates any
+    std::size_t current(std::string const& population) const
+    {
+        auto const* detail = find(population);
+        return detail ? detail->counter.current.load() : 0;
+    }
+    std::size_t peak(std::string const& population) const
+    {
+        auto const* detail = find(population);
+        return detail ? detail->counter.peak.load() : 0;
+    }
+
+    // of all the subsystems together, the peak of the sum and not the sum of the peaks
+    std::size_t current() const { return m_total.current; }
+    std::size_t peak() const { return m_total.peak; }
+
+    // peaks restart from the current bytes, e.g. to measure one phase of a run
+    void reset_peaks()
+    {
+        for (auto& counter : m_counters)
+            counter.peak.store(counter.current);
+        m_total.peak.store(m_total.current);
+        std::lock_guard lock{m_details_mutex};
+        for (auto& detail : m_details)
+            detail.counter.peak.store(detail.counter.current);
+    }
+
+    void print(std::ostream& out = std::cout) const
+    {
+        auto const megabytes = [](std::size_t bytes) { return bytes / (1024. * 1024.); };
+        auto const line      = [&](std::string const& name, Counter const& counter) {
+            out << std::left << std::setw(20) << name << std::right << std::setw(12)
+                << megabytes(counter.current) << std::setw(12) << megabytes(counter.peak) << "\n";
+        };
+        out << std::left << std::setw(20) << "memory (MB)" << std::right << std::setw(12)
+            << "current" << std::setw(12) << "peak" << "\n";
+        out << std::fixed << std::setprecision(1);
+        for (auto iSub = 0u; iSub < nbr_subsystems; ++iSub)
+        {
+            line(subsystem_names[iSub], m_counters[iSub]);
+            if (iSub == index(Subsystem::particles))
+            {
+                std::lock_guard lock{m_details_mutex};
+                for (auto const& detail : m_details)
+                    line("  " + detail.name, detail.counter);
+            }
+        }
+        line("total", m_total);
+        out.unsetf(std::ios::fixed);
+    }
+
+    // memory_<subsystem>_current and memory_<subsystem>_peak in bytes, the totals, and
+    // memory_particles_<population>_current and _peak for each population
+    template<typename Object>
+    void write_attributes(Object& object) const
+    {
+        auto const write = [&](std::string const& name, Counter const& counter) {
+            object.createAttribute("memory_" + name + "_current", counter.current.load());
+            object.createAttribute("memory_" + name + "_peak", counter.peak.load());
+        };
+        for (auto iSub = 0u; iSub < nbr_subsystems; ++iSub)
+            write(subsystem_names[iSub], m_counters[iSub]);
+        write("total", m_total);
+        std::lock_guard lock{m_details_mutex};
+        for (auto const& detail : m_details)
+            write("particles_" + detail.name, detail.counter);
+    }
+
+private:
+    static MemoryAccounting*& in_use()
+    {
+        thread_local MemoryAccounting* accounting = nullptr;
+        return accounting;
+    }
+
+    Detail const* find(std::string const& population) const
+    {
+        std::lock_guard lock{m_details_mutex};
+        for (auto const& detail : m_details)
+            if (detail.name == population)
+                return &detail;
+        return nullptr;
+    }
+
+    static std::size_t index(Subsystem subsystem) { return static_cast<std::size_t>(subsystem); }
+
+    static void raise_peak(std::atomic<std::size_t>& peak, std::size_t bytes)
+    {
+        auto seen = peak.load();
+        while (seen < bytes and !peak.compare_exchange_weak(seen, bytes))
+        {
+        }
+    }
+
+    std::array<Counter, nbr_subsystems> m_counters;
+    Counter m_total;
+    mutable std::mutex m_details_mutex;
+    std::deque<Detail> m_details; // references stay valid as details are added
+};
+
+
+// bytes counted for the lifetime of the scope, in the accounting in use when it opens
+class MemoryScope
+{
+public:
+    MemoryScope(Subsystem subsystem, std::size_t bytes)
+        : m_accounting{MemoryAccounting::current_accounting()}
+        , m_subsystem{subsystem}
+        , m_bytes{bytes}
+    {
+        m_accounting.allocated(m_subsystem, m_bytes);
+    }
+
+    ~MemoryScope() { m_accounting.released(m_subsystem, m_bytes); }
+
+    MemoryScope(MemoryScope const&)            = delete;
+    MemoryScope& operator=(MemoryScope const&) = delete;
+
+private:
+    MemoryAccounting& m_accounting;
+    Subsystem m_subsystem;
+    std::size_t m_bytes;
+};
+
+
+// bytes a run is expected to need per subsystem, see memory_estimate() in simulation.hpp.
+// The diagnostics hold some buffers for the whole run, the spectral amplitudes, the rest
+// are staging buffers. Staging buffers and writes do not overlap, only the larger of the two
+// adds to the peak.
+struct MemoryEstimate
+{
+    std::array<std::size_t, nbr_subsystems> bytes{};
+    std::size_t resident_diagnostics = 0; // part of the diagnostics held for the whole run
+
+    std::size_t& operator[](Subsystem subsystem)
+    {
+        return bytes[static_cast<std::size_t>(subsystem)];
+    }
+    std::size_t operator[](Subsystem subsystem) const
+    {
+        return bytes[static_cast<std::size_t>(subsystem)];
+    }
+
+    std::size_t peak() const
+    {
+        auto const staging = (*this)[Subsystem::diagnostics] - resident_diagnostics;
+        return (*this)[Subsystem::fields] + (*this)[Subsystem::particles] + resident_diagnostics
+               + std::max(staging, (*this)[Subsystem::io]);
+    }
+
+    void print(std::ostream& out = std::cout) const
+    {
+        out << std::fixed << std::setprecision(1) << "estimated memory (MB):";
+        for (auto iSub = 0u; iSub < nbr_subsystems; ++iSub)
+            out << " " << subsystem_names[iSub] << " " << bytes[iSub] / (1024. * 1024.) << ",";
+        out << " peak " << peak() / (1024. * 1024.) << "\n";
+        out.unsetf(std::ios::fixed);
+    }
+};
+
+
+#endif // HYBIRT_MEMORY_ACCOUNTING_HPP
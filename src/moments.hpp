@@ -4,13 +4,16 @@
 #include "field.hpp"
 #include "vecfield.hpp"
 #include "population.hpp"
+#include "timers.hpp"
 
+#include <cstddef>
 #include <vector>
 
 
 template<std::size_t dimension>
 void total_density(std::vector<Population<dimension>> const& populations, Field<dimension>& N)
 {
+    HYBIRT_TIME_SCOPE("moments");
     for (auto ix = 0; ix < N.data().size(); ++ix)
     {
         N(ix) = 0;
@@ -25,6 +28,7 @@ template<std::size_t dimension>
 void bulk_velocity(std::vector<Population<dimension>> const& populations, Field<dimension> const& N,
                    VecField<dimension>& V)
 {
+    HYBIRT_TIME_SCOPE("moments");
     for (auto ix = 0; ix < N.data().size(); ++ix)
     {
         V.x(ix) = 0;
@@ -43,4 +47,40 @@ void bulk_velocity(std::vector<Population<dimension>> const& populations, Field<
     // TODO calculate bulk velocity by dividing by density N
 }
 
+
+// single pass moments: instead of depositing each population into its own fields and summing
+// them in total_density and bulk_velocity, every population adds its density to N and its
+// flux to V directly. The ghost fill, the background of delta f populations and the filter
+// then run once on the totals rather than once per population, and finalize_moments divides
+// the flux by the density in one sweep. The moments of a population are left untouched: they
+// are only computed, with Population::deposit(), when a diagnostic needs them.
+template<std::size_t dimension>
+void accumulate_moments(std::vector<Population<dimension>> const& populations,
+                        Field<dimension>& N, VecField<dimension>& V)
+{
+    HYBIRT_TIME_SCOPE("moments");
+    for (auto& n : N)
+        n = 0.;
+    for (auto* component : {&V.x, &V.y, &V.z})
+        for (auto& v : *component)
+            v = 0.;
+    for (auto const& pop : populations)
+        pop.deposit(N, V);
+}
+
+// V holds the total flux on entry and the bulk velocity on exit, zero where there is no
+// plasma, e.g. in a cavity of an open box
+template<std::size_t dimension>
+void finalize_moments(Field<dimension> const& N, VecField<dimension>& V)
+{
+    HYBIRT_TIME_SCOPE("moments");
+    for (std::size_t ix = 0; ix < N.size(); ++ix)
+    {
+        auto const inverse = N(ix) > 0. ? 1. / N(ix) : 0.;
+        V.x(ix) *= inverse;
+        V.y(ix) *= inverse;
+        V.z(ix) *= inverse;
+    }
+}
+
 #endif
@@ -0,0 +1,187 @@
+#ifndef HYBIRT_MOVING_WINDOW_HPP
+#define HYBIRT_MOVING_WINDOW_HPP
+
+#include "field.hpp"
+#include "vecfield.hpp"
+#include "gridlayout.hpp"
+#include "population.hpp"
+#include "profiles.hpp"
+#include "timers.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// plasma the window finds ahead of it, per population: the initial profile of the run
+struct WindowPlasma
+{
+    std::string population;
+    std::size_t nppc;
+    Profile density;
+    std::array<double, 3> V;   // bulk velocity
+    std::array<double, 3> Vth; // thermal velocity
+    double mass   = 1.0;
+    double charge = 1.0;
+};
+
+
+// simulation frame that follows a structure across an unbounded domain at a fixed velocity.
+//
+// The grid keeps its local coordinates [0, L) and the window keeps offset(), the lab
+// position of the grid origin, which only moves by whole cells so that the fields are
+// shifted without interpolation. Each shift drops the cells and the particles that fall
+// behind the trailing edge and brings fresh cells in at the leading edge, with the initial
+// magnetic profiles and plasma taken at their lab position: the number of cells and, on
+// average, of particles stays the same for the whole run.
+// Fields without a profile, E and the moments, extend their last node into the new cells
+// until the next step recomputes them.
+template<std::size_t dimension>
+class MovingWindow
+{
+    static_assert(dimension == 1, "MovingWindow only implemented for 1D");
+
+public:
+    MovingWindow(std::shared_ptr<GridLayout<dimension>> grid, double velocity,
+                 std::optional<std::size_t> seed = std::nullopt)
+        : m_grid{grid}
+        , m_velocity{velocity}
+        , m_generator{getRNG(seed)}
+    {
+        if (!m_grid)
+            throw std::runtime_error("GridLayout is null");
+    }
+
+    bool moving() const { return m_velocity != 0.; }
+    double velocity() const { return m_velocity; }
+    double offset() const { return m_offset; }
+
+    void add_plasma(WindowPlasma const& plasma) { m_plasmas.push_back(plasma); }
+
+
+    // moves the window by velocity * dt and returns the number of whole cells its grid
+    // has to be shifted by, the rest is carried over to the next call
+    std::size_t advance(double dt)
+    {
+        auto const dx = m_grid->cell_size(Direction::X);
+        m_travelled += std::abs(m_velocity) * dt;
+        auto const cells = static_cast<std::size_t>(m_travelled / dx);
+        m_travelled -= cells * dx;
+        m_offset += (m_velocity > 0. ? 1. : -1.) * cells * dx;
+        return cells;
+    }
+
+
+    // shifts field by cells, already counted in offset(). New nodes take profile at their
+    // lab position if there is one, the last node of the old field otherwise.
+    // Ghosts are to be filled afterwards.
+    void shift(Field<dimension>& field, std::size_t cells, Profile const& profile = {}) const
+    {
+        HYBIRT_TIME_SCOPE("moving_window");
+        auto const size = m_grid->allocate(field.quantity())[0];
+        cells           = std::min(cells, size - 1);
+        if (cells == 0)
+            return;
+
+        auto const fill = [&](std::size_t ix, std::size_t neighbor) {
+            field(ix) = profile ? at_lab(profile, field.quantity(), ix) : field(neighbor);
+        };
+        if (m_velocity > 0.)
+        {
+            std::shift_left(field.begin(), field.end(), cells);
+            for (auto ix = size - cells; ix < size; ++ix)
+                fill(ix, ix - 1);
+        }
+        else
+        {
+            std::shift_right(field.begin(), field.end(), cells);
+            for (auto ix = cells; ix-- > 0;)
+                fill(ix, ix + 1);
+        }
+    }
+
+    void shift(VecField<dimension>& vecfield, std::size_t cells) const
+    {
+        shift(vecfield.x, cells);
+        shift(vecfield.y, cells);
+        shift(vecfield.z, cells);
+    }
+
+    // drops the particles behind the trailing edge, keeping the order of the others, and
+    // loads the new cells with the plasma of the population, if any
+    void shift(Population<dimension>& population, std::size_t cells)
+    {
+        HYBIRT_TIME_SCOPE("moving_window");
+        if (cells == 0)
+            return;
+        if (population.delta_f())
+            throw std::runtime_error("the moving window would inject full f particles in "
+                                     + population.name() + ", a delta f population");
+
+        auto& particles   = population.particles();
+        auto const dx     = m_grid->cell_size(Direction::X);
+        auto const length = m_grid->dom_size(Direction::X);
+        auto const moved  = (m_velocity > 0. ? 1. : -1.) * cells * dx;
+        std::size_t kept  = 0;
+        for (std::size_t iPart = 0; iPart < particles.size(); ++iPart)
+        {
+            auto particle = particles[iPart];
+            particle.position[0] -= moved;
+            if (particle.position[0] >= 0. and particle.position[0] < length)
+                particles[kept++] = particle;
+        }
+        particles.resize(kept);
+
+        for (auto const& plasma : m_plasmas)
+        {
+            if (plasma.population != population.name())
+                continue;
+            auto const nbr_cells = m_grid->nbr_cells(Direction::X);
+            auto const first     = m_velocity > 0. ? nbr_cells - std::min(cells, nbr_cells) : 0;
+            auto const last      = m_velocity > 0. ? nbr_cells : std::min(cells, nbr_cells);
+            particles.reserve(particles.size() + (last - first) * plasma.nppc);
+
+            std::uniform_real_distribution<> uniform{0., dx};
+            for (auto iCell = first; iCell < last; ++iCell)
+            {
+                auto const left   = iCell * dx;
+                auto const weight = plasma.density(m_offset + left + 0.5 * dx) / plasma.nppc;
+                for (std::size_t iPart = 0; iPart < plasma.nppc; ++iPart)
+                {
+                    Particle<dimension> particle;
+                    particle.position[0] = left + uniform(m_generator);
+                    maxwellianVelocity(plasma.V, plasma.Vth, m_generator, particle.v);
+                    particle.weight = weight;
+                    particle.mass   = plasma.mass;
+                    particle.charge = plasma.charge;
+                    particle.id     = population.new_particle_id();
+                    particles.push_back(particle);
+                }
+            }
+        }
+    }
+
+
+private:
+    double at_lab(Profile const& profile, Quantity qty, std::size_t ix) const
+    {
+        return profile(m_offset + m_grid->coordinate(Direction::X, qty, ix));
+    }
+
+    std::shared_ptr<GridLayout<dimension>> m_grid;
+    double m_velocity;
+    double m_offset    = 0.; // lab position of the grid origin
+    double m_travelled = 0.; // distance not shifted yet, less than a cell
+    std::mt19937_64 m_generator;
+    std::vector<WindowPlasma> m_plasmas;
+};
+
+
+#endif // HYBIRT_MOVING_WINDOW_HPP
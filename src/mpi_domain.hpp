@@ -0,0 +1,316 @@
+#ifndef HYBIRT_MPI_DOMAIN_HPP
+#define HYBIRT_MPI_DOMAIN_HPP
+
+// distributed-memory decomposition of the periodic domain, built with -DHYBIRT_MPI=ON
+
+#include "field.hpp"
+#include "vecfield.hpp"
+#include "gridlayout.hpp"
+#include "ghost_fill.hpp"
+#include "boundary_condition.hpp"
+#include "particle.hpp"
+#include "timers.hpp"
+
+#include <mpi.h>
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// splits the nbr_cells of the periodic domain into contiguous slabs, one per rank.
+// The first nbr_cells % size ranks get one more cell. Each rank has a local layout in
+// local coordinates, x = 0 at the left of its first cell, and origin() locates it.
+template<std::size_t dimension>
+class MPIDomain
+{
+    static_assert(dimension == 1, "MPIDomain only implemented for 1D");
+
+public:
+    MPIDomain(std::size_t nbr_cells, double cell_size, std::size_t nbr_ghosts,
+              MPI_Comm comm = MPI_COMM_WORLD)
+        : m_comm{comm}
+        , m_nbr_cells{nbr_cells}
+        , m_cell_size{cell_size}
+        , m_nbr_ghosts{nbr_ghosts}
+    {
+        MPI_Comm_rank(m_comm, &m_rank);
+        MPI_Comm_size(m_comm, &m_size);
+
+        if (local_cells(m_size - 1) < nbr_ghosts + 1)
+            throw std::runtime_error("too many ranks for " + std::to_string(nbr_cells) + " cells");
+
+        m_layout = std::make_shared<GridLayout<dimension>>(
+            std::array<std::size_t, dimension>{local_cells(m_rank)},
+            std::array<double, dimension>{cell_size}, nbr_ghosts);
+        m_global_layout = std::make_shared<GridLayout<dimension>>(
+            std::array<std::size_t, dimension>{nbr_cells},
+            std::array<double, dimension>{cell_size}, nbr_ghosts);
+    }
+
+    MPI_Comm comm() const { return m_comm; }
+    int rank() const { return m_rank; }
+    int size() const { return m_size; }
+    int left() const { return (m_rank - 1 + m_size) % m_size; }
+    int right() const { return (m_rank + 1) % m_size; }
+
+    // id sequence of a species on this rank, one per population: ranks take interleaved ids
+    // so that particles keep unique ids as they migrate
+    std::shared_ptr<ParticleIds> particle_ids() const
+    {
+        return std::make_shared<ParticleIds>(static_cast<std::size_t>(m_rank),
+                                             static_cast<std::size_t>(m_size));
+    }
+
+    std::size_t local_cells(int rank) const
+    {
+        auto const base  = m_nbr_cells / m_size;
+        auto const extra = m_nbr_cells % m_size;
+        return base + (static_cast<std::size_t>(rank) < extra ? 1 : 0);
+    }
+
+    std::size_t first_cell(int rank) const
+    {
+        std::size_t first = 0;
+        for (int iRank = 0; iRank < rank; ++iRank)
+            first += local_cells(iRank);
+        return first;
+    }
+
+    double origin() const { return first_cell(m_rank) * m_cell_size; }
+    double length(int rank) const { return local_cells(rank) * m_cell_size; }
+
+    auto const& layout() const { return m_layout; }
+    auto const& global_layout() const { return m_global_layout; }
+
+
+    // assembles the domain nodes of every rank into global, a field of global_layout(),
+    // on rank root only. Collective.
+    void gather(Field<dimension> const& local, Field<dimension>& global, int root = 0) const
+    {
+        HYBIRT_TIME_SCOPE("mpi_gather");
+        auto const qty = local.quantity();
+        auto const dsi = m_layout->dom_start(qty, Direction::X);
+        auto const dei = m_layout->dom_end(qty, Direction::X);
+
+        // shared primal nodes are sent by the rank on their right, except the last node
+        auto const primal = m_layout->centerings(qty)[0] == m_layout->primal;
+        auto const last   = primal and m_rank != m_size - 1 ? dei - 1 : dei;
+
+        std::vector<double> nodes;
+        for (auto ix = dsi; ix <= last; ++ix)
+            nodes.push_back(local(ix));
+
+        int const count = static_cast<int>(nodes.size());
+        std::vector<int> counts(m_size), displacements(m_size);
+        MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, root, m_comm);
+        std::exclusive_scan(counts.begin(), counts.end(), displacements.begin(), 0);
+
+        std::vector<double> all(m_rank == root ? displacements.back() + counts.back() : 0);
+        MPI_Gatherv(nodes.data(), count, MPI_DOUBLE, all.data(), counts.data(),
+                    displacements.data(), MPI_DOUBLE, root, m_comm);
+
+        if (m_rank == root)
+        {
+            auto const global_dsi = m_global_layout->dom_start(qty, Direction::X);
+            for (std::size_t iNode = 0; iNode < all.size(); ++iNode)
+                global(global_dsi + iNode) = all[iNode];
+        }
+    }
+
+    void gather(VecField<dimension> const& local, VecField<dimension>& global, int root = 0) const
+    {
+        gather(local.x, global.x, root);
+        gather(local.y, global.y, root);
+        gather(local.z, global.z, root);
+    }
+
+
+private:
+    MPI_Comm m_comm;
+    int m_rank = 0;
+    int m_size = 1;
+    std::size_t m_nbr_cells;
+    double m_cell_size;
+    std::size_t m_nbr_ghosts;
+    std::shared_ptr<GridLayout<dimension>> m_layout;
+    std::shared_ptr<GridLayout<dimension>> m_global_layout;
+};
+
+
+
+
+// boundary condition of a rank of an MPIDomain: ghosts come from the neighbour ranks with
+// non-blocking halo exchanges, leaving particles are sent to the neighbour they enter.
+// With one rank it does exactly what PeriodicBoundaryCondition does.
+template<std::size_t dimension>
+class MPIBoundaryCondition final : public BoundaryCondition<dimension>
+{
+public:
+    using BoundaryCondition<dimension>::particles;
+
+    explicit MPIBoundaryCondition(std::shared_ptr<MPIDomain<dimension>> const& domain)
+        : BoundaryCondition<dimension>(domain->layout())
+        , m_domain{domain}
+        , m_plan{*domain->layout()}
+    {
+    }
+
+    void fill(Field<dimension>& field) override
+    {
+        Field<dimension>* fields[] = {&field};
+        exchange(fields);
+    }
+
+    // the three components travel in the same messages
+    void fill(VecField<dimension>& vecfield) override
+    {
+        Field<dimension>* fields[] = {&vecfield.x, &vecfield.y, &vecfield.z};
+        exchange(fields);
+    }
+
+
+    void refill(Field<dimension>& field) override
+    {
+        HYBIRT_TIME_SCOPE("field_bc");
+        Field<dimension>* fields[] = {&field};
+        exchange(fields, false);
+    }
+
+
+    // particles may cross at most one rank per call
+    void particles(ParticleArray<dimension>& particles) override
+    {
+        HYBIRT_TIME_SCOPE("particle_bc");
+        auto const length      = m_domain->length(m_domain->rank());
+        auto const left_length = m_domain->length(m_domain->left());
+
+        m_outgoing[0].clear();
+        m_outgoing[1].clear();
+
+        std::size_t kept = 0;
+        for (std::size_t iPart = 0; iPart < particles.size(); ++iPart)
+        {
+            auto particle = particles[iPart];
+            auto& x       = particle.position[0];
+            if (x >= 0.0 and x < length)
+            {
+                if (kept != iPart)
+                    particles[kept] = particle;
+                ++kept;
+                continue;
+            }
+            if (x < -left_length or x >= length + m_domain->length(m_domain->right()))
+                throw std::runtime_error("particle crossed more than one rank");
+
+            bool const to_left = x < 0.0;
+            x += to_left ? left_length : -length;
+            m_outgoing[to_left ? 0 : 1].push_back(particle);
+        }
+        particles.resize(kept);
+
+        // counts first, then the particles themselves, as raw bytes
+        std::array<unsigned long, 2> send_counts{m_outgoing[0].size(), m_outgoing[1].size()};
+        std::array<unsigned long, 2> recv_counts{0, 0};
+        neighbour_exchange(&send_counts[0], &send_counts[1], 1, 1, &recv_counts[0],
+                           &recv_counts[1], 1, 1, MPI_UNSIGNED_LONG);
+
+        for (int side = 0; side < 2; ++side)
+            m_incoming[side].resize(recv_counts[side]);
+
+        auto const bytes = static_cast<int>(sizeof(Particle<dimension>));
+        neighbour_exchange(m_outgoing[0].data(), m_outgoing[1].data(), bytes * send_counts[0],
+                           bytes * send_counts[1], m_incoming[0].data(), m_incoming[1].data(),
+                           bytes * recv_counts[0], bytes * recv_counts[1], MPI_BYTE);
+
+        for (auto const& incoming : m_incoming)
+            particles.insert(particles.end(), incoming.begin(), incoming.end());
+    }
+
+
+private:
+    static constexpr int tag_to_right = 0;
+    static constexpr int tag_to_left  = 1;
+
+    // moments first fold the ghosts into the domain, the copies send the folded values
+    template<std::size_t nbr_fields>
+    void exchange(Field<dimension>* (&fields)[nbr_fields])
+    {
+        HYBIRT_TIME_SCOPE("field_bc");
+        exchange(fields, true);
+        exchange(fields, false);
+    }
+
+    // sends to the left what the left neighbour needs for its right ghosts and to the right
+    // what the right neighbour needs for its left ghosts, see NeighbourGhostPlan
+    template<std::size_t nbr_fields>
+    void exchange(Field<dimension>* (&fields)[nbr_fields], bool accumulate)
+    {
+        auto const transfers_of = [this, accumulate](Field<dimension> const& field) -> auto const& {
+            auto const& plan = m_plan.transfers(field.quantity());
+            return accumulate ? plan.accumulate : plan.copy;
+        };
+
+        for (auto& buffer : m_send)
+            buffer.clear();
+        for (auto const* field : fields)
+            for (auto const& transfer : transfers_of(*field))
+                m_send[transfer.neighbour < 0 ? 1 : 0].push_back((*field)(transfer.source));
+
+        // every rank has the same plans, so it receives as many values as it sends and
+        // all of them skip the accumulations of fields that are not moments
+        if (m_send[0].empty() and m_send[1].empty())
+            return;
+        m_recv[0].resize(m_send[1].size());
+        m_recv[1].resize(m_send[0].size());
+
+        neighbour_exchange(m_send[0].data(), m_send[1].data(), m_send[0].size(),
+                           m_send[1].size(), m_recv[0].data(), m_recv[1].data(),
+                           m_recv[0].size(), m_recv[1].size(), MPI_DOUBLE);
+
+        std::array<std::size_t, 2> next{0, 0};
+        for (auto* field : fields)
+            for (auto const& transfer : transfers_of(*field))
+            {
+                auto const side  = transfer.neighbour < 0 ? 0 : 1;
+                auto const value = m_recv[side][next[side]++];
+                if (accumulate)
+                    (*field)(transfer.ghost) += value;
+                else
+                    (*field)(transfer.ghost) = value;
+            }
+    }
+
+    // non-blocking exchange with both neighbours, buffers [0] are for the left one.
+    // Messages to the right are tagged apart so that two ranks, each the left and right
+    // neighbour of the other, do not mix them up.
+    void neighbour_exchange(void const* to_left, void const* to_right, int to_left_count,
+                            int to_right_count, void* from_left, void* from_right,
+                            int from_left_count, int from_right_count, MPI_Datatype type)
+    {
+        auto const left  = m_domain->left();
+        auto const right = m_domain->right();
+        auto const comm  = m_domain->comm();
+
+        std::array<MPI_Request, 4> requests;
+        MPI_Irecv(from_left, from_left_count, type, left, tag_to_right, comm, &requests[0]);
+        MPI_Irecv(from_right, from_right_count, type, right, tag_to_left, comm, &requests[1]);
+        MPI_Isend(to_left, to_left_count, type, left, tag_to_left, comm, &requests[2]);
+        MPI_Isend(to_right, to_right_count, type, right, tag_to_right, comm, &requests[3]);
+        MPI_Waitall(4, requests.data(), MPI_STATUSES_IGNORE);
+    }
+
+    std::shared_ptr<MPIDomain<dimension>> m_domain;
+    NeighbourGhostPlan<dimension> m_plan;
+
+    // buffers reused from one exchange to the next: [0] left, [1] right
+    std::array<std::vector<double>, 2> m_send, m_recv;
+    std::array<std::vector<Particle<dimension>>, 2> m_outgoing, m_incoming;
+};
+
+
+#endif // HYBIRT_MPI_DOMAIN_HPP
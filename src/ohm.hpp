@@ -2,6 +2,8 @@
 #define HYBRIDIR_OHM_HPP
 
 #include "vecfield.hpp"
+#include "timers.hpp"
+#include "perf_counters.hpp"
 
 #include <cstddef>
 #include <memory>
@@ -21,10 +23,13 @@ public:
                     VecField<dimension> const& V, VecField<dimension>& Enew)
 
     {
+        HYBIRT_TIME_SCOPE("ohm");
+        HYBIRT_COUNT_SCOPE("ohm", m_grid->nbr_cells(Direction::X), flops_per_cell);
         auto const dx = m_grid->cell_size(Direction::X);
         if constexpr (dimension == 1)
         {
             // Ex is dual in x
+#pragma omp parallel for
             for (auto ix = m_grid->dual_dom_start(Direction::X);
                  ix <= m_grid->dual_dom_end(Direction::X); ++ix)
             {
@@ -55,6 +60,7 @@ public:
             // Ey is primal in x, so is Ez
             // Ey = -(Vz * Bx - Vx * Bz) + (JzBx - JxBz) / N;
             // Ez = -(Vx * By - Vy * Bx) + (JxBy - JyBx) / N;
+#pragma omp parallel for
             for (auto ix = m_grid->primal_dom_start(Direction::X);
                  ix <= m_grid->primal_dom_end(Direction::X); ++ix)
             {
@@ -94,6 +100,9 @@ public:
     }
 
 private:
+    // Ex loop + Ey/Ez loop, counted from the expressions below
+    static constexpr std::size_t flops_per_cell = 21 + 28;
+
     std::shared_ptr<GridLayout<dimension>> m_grid;
 };
 
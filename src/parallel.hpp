@@ -0,0 +1,48 @@
+#ifndef HYBIRT_PARALLEL_HPP
+#define HYBIRT_PARALLEL_HPP
+
+// thin wrappers over OpenMP so that the code builds and runs serially without it
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+inline int max_threads()
+{
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+inline void set_threads(int nbr_threads)
+{
+#ifdef _OPENMP
+    omp_set_num_threads(nbr_threads);
+#else
+    (void)nbr_threads;
+#endif
+}
+
+inline bool in_parallel()
+{
+#ifdef _OPENMP
+    return omp_in_parallel();
+#else
+    return false;
+#endif
+}
+
+inline int thread_num()
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+
+#endif // HYBIRT_PARALLEL_HPP
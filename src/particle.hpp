@@ -1,8 +1,12 @@
 #ifndef HYBIRT_PARTICLE_HPP
 #define HYBIRT_PARTICLE_HPP
 
+#include "allocator.hpp"
+
 #include <array>
+#include <atomic>
 #include <cstddef>
+#include <vector>
 
 template<std::size_t dimension>
 struct Particle
@@ -10,7 +14,35 @@ struct Particle
     std::array<double, dimension> position;
     std::array<double, 3> v; // velocity
     double weight;
+    double total_weight = 0.; // delta f only: weight of the whole distribution, see Population
     double mass;
     double charge;
+    std::size_t id = 0; // unique within its species, used to track particles
 };
+
+
+// ids of the particles of a species: first, first + stride, first + 2 stride... Every
+// population holding the species, e.g. one per patch, shares the same sequence so that ids
+// stay unique as particles move between them, and each rank takes its own first.
+class ParticleIds
+{
+public:
+    ParticleIds(std::size_t first = 0, std::size_t stride = 1)
+        : m_first{first}
+        , m_stride{stride}
+    {
+    }
+
+    std::size_t next() { return m_first + m_stride * m_count.fetch_add(1); }
+
+private:
+    std::size_t m_first;
+    std::size_t m_stride;
+    std::atomic<std::size_t> m_count{0};
+};
+
+// particles of a population, placed for the threads that push them, see allocator.hpp
+template<std::size_t dimension>
+using ParticleArray = std::vector<Particle<dimension>,
+                                  FirstTouchAllocator<Particle<dimension>, Subsystem::particles>>;
 #endif // HYBIRT_PARTICLE_HPP
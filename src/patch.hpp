@@ -0,0 +1,598 @@
+#ifndef HYBIRT_PATCH_HPP
+#define HYBIRT_PATCH_HPP
+
+#include "field.hpp"
+#include "vecfield.hpp"
+#include "gridlayout.hpp"
+#include "ghost_fill.hpp"
+#include "particle.hpp"
+#include "population.hpp"
+#include "timers.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+
+// a piece of the periodic domain with its own layout, fields, particles and ghosts.
+// Everything in a patch uses patch-local coordinates, x = 0 at the left of its first cell,
+// so the kernels run on a patch exactly as on the whole domain; origin locates the patch.
+template<std::size_t dimension>
+struct Patch
+{
+    Patch(std::size_t index_, std::size_t first_cell_, std::array<double, dimension> origin_,
+          std::shared_ptr<GridLayout<dimension>> const& layout_,
+          std::vector<std::string> const& population_names,
+          std::vector<std::shared_ptr<ParticleIds>> const& population_ids = {})
+        : index{index_}
+        , first_cell{first_cell_}
+        , origin{origin_}
+        , layout{layout_}
+        , plan{*layout_}
+        , E{layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}}
+        , B{layout, {Quantity::Bx, Quantity::By, Quantity::Bz}}
+        , J{layout, {Quantity::Jx, Quantity::Jy, Quantity::Jz}}
+        , V{layout, {Quantity::Vx, Quantity::Vy, Quantity::Vz}}
+        , N{layout->allocate(Quantity::N), Quantity::N}
+    {
+        // populations of the same species share their ids with the other patches
+        for (std::size_t iPop = 0; iPop < population_names.size(); ++iPop)
+            populations.emplace_back(population_names[iPop], layout,
+                                     iPop < population_ids.size() ? population_ids[iPop]
+                                                                  : nullptr);
+    }
+
+    // every field of the patch, population moments included, always in the same order
+    std::vector<Field<dimension>*> fields()
+    {
+        std::vector<Field<dimension>*> all{&E.x, &E.y, &E.z, &B.x, &B.y, &B.z, &J.x,
+                                           &J.y, &J.z, &V.x, &V.y, &V.z, &N};
+        for (auto& pop : populations)
+            for (auto* field : {&pop.flux().x, &pop.flux().y, &pop.flux().z, &pop.density()})
+                all.push_back(field);
+        return all;
+    }
+
+    std::size_t nbr_particles() const
+    {
+        std::size_t count = 0;
+        for (auto const& pop : populations)
+            count += pop.particles().size();
+        return count;
+    }
+
+    std::size_t index;
+    std::size_t first_cell; // global index of the first cell
+    std::array<double, dimension> origin;
+    std::shared_ptr<GridLayout<dimension>> layout;
+    NeighbourGhostPlan<dimension> plan;
+    double cost = 0.; // seconds spent in PatchLevel::for_each_patch since the last balance
+
+    VecField<dimension> E, B, J, V;
+    Field<dimension> N;
+    std::vector<Population<dimension>> populations;
+};
+
+
+
+
+// splits costs into nbr_parts contiguous ranges of about the same total cost by cutting
+// their prefix sum at the multiples of total / nbr_parts. Every range holds at least
+// min_size items. Returns the number of items of each range.
+inline std::vector<std::size_t> partition_by_cost(std::vector<double> const& costs,
+                                                  std::size_t nbr_parts, std::size_t min_size)
+{
+    auto const nbr_items = costs.size();
+    if (nbr_parts == 0 or nbr_parts * min_size > nbr_items)
+        throw std::runtime_error("cannot split " + std::to_string(nbr_items) + " items into "
+                                 + std::to_string(nbr_parts) + " parts of "
+                                 + std::to_string(min_size) + " or more");
+
+    std::vector<double> prefix(nbr_items + 1, 0.);
+    std::partial_sum(costs.begin(), costs.end(), prefix.begin() + 1);
+    auto const total = prefix.back();
+
+    std::vector<std::size_t> sizes;
+    std::size_t start = 0;
+    for (std::size_t iPart = 1; iPart < nbr_parts; ++iPart)
+    {
+        auto const target = total * iPart / nbr_parts;
+        auto end          = static_cast<std::size_t>(
+            std::lower_bound(prefix.begin(), prefix.end(), target) - prefix.begin());
+
+        // cut where the prefix is closest to the target, leaving room for the next parts
+        if (end > 0 and target - prefix[end - 1] < prefix[end] - target)
+            --end;
+        end = std::clamp(end, start + min_size, nbr_items - (nbr_parts - iPart) * min_size);
+
+        sizes.push_back(end - start);
+        start = end;
+    }
+    sizes.push_back(nbr_items - start);
+    return sizes;
+}
+
+
+
+
+// periodic domain split into patches along x.
+//
+// Patches are independent tasks: for_each_patch() hands them out dynamically to the
+// threads, and each patch touches only its own data, so it stays in the cache and in the
+// memory of the thread that works on it. Patches talk only through fill_ghosts() and
+// migrate_particles(), both done in two phases (read the neighbours, then write) so that
+// every patch can be processed in parallel and in any order.
+//
+// Patches start with the same number of cells. for_each_patch() measures the time spent on
+// each of them, and balance() moves the patch boundaries so that they cost the same, which
+// matters when the particles are not uniformly spread (beams, shocks, density profiles).
+template<std::size_t dimension>
+class PatchLevel
+{
+    static_assert(dimension == 1, "PatchLevel only implemented for 1D");
+
+public:
+    PatchLevel(std::size_t nbr_cells, double cell_size, std::size_t nbr_ghosts,
+               std::size_t nbr_patches, std::vector<std::string> const& population_names)
+        : m_nbr_cells{nbr_cells}
+        , m_cell_size{cell_size}
+        , m_nbr_ghosts{nbr_ghosts}
+        , m_population_names{population_names}
+    {
+        for (std::size_t iPop = 0; iPop < m_population_names.size(); ++iPop)
+            m_population_ids.push_back(std::make_shared<ParticleIds>());
+        if (nbr_patches == 0 or nbr_cells < nbr_patches * min_cells())
+            throw std::runtime_error("cannot split " + std::to_string(nbr_cells) + " cells into "
+                                     + std::to_string(nbr_patches)
+                                     + " patches larger than their ghost regions");
+
+        // the first nbr_cells % nbr_patches patches get one more cell
+        std::vector<std::size_t> sizes(nbr_patches, nbr_cells / nbr_patches);
+        for (std::size_t iPatch = 0; iPatch < nbr_cells % nbr_patches; ++iPatch)
+            ++sizes[iPatch];
+        m_patches = make_patches(sizes);
+
+        m_exchange_buffers.resize(nbr_patches);
+        m_outgoing.resize(nbr_patches);
+    }
+
+
+    auto& patches() { return m_patches; }
+    auto const& patches() const { return m_patches; }
+    auto size() const { return m_patches.size(); }
+
+    static double length(Patch<dimension> const& patch)
+    {
+        return patch.layout->dom_size(Direction::X);
+    }
+
+    // smallest patch that holds its ghost regions
+    std::size_t min_cells() const { return m_nbr_ghosts + 1; }
+
+
+    // runs task(patch) on every patch in parallel, errors are rethrown once all are done.
+    // The time spent on each patch is added to its cost.
+    template<typename Task>
+    void for_each_patch(Task&& task)
+    {
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+#pragma omp parallel for schedule(dynamic, 1)
+        for (std::size_t iPatch = 0; iPatch < m_patches.size(); ++iPatch)
+        {
+            auto& patch      = m_patches[iPatch];
+            auto const start = std::chrono::steady_clock::now();
+            try
+            {
+                task(patch);
+            }
+            catch (...)
+            {
+                std::lock_guard lock{error_mutex};
+                if (!error)
+                    error = std::current_exception();
+            }
+            auto const stop = std::chrono::steady_clock::now();
+            patch.cost += std::chrono::duration<double>(stop - start).count();
+        }
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+
+    // loads nppc particles per cell of each patch, profiles are in global coordinates
+    void load_particles(std::size_t iPop, int nppc, auto density,
+                        std::array<double, 3> const& V = {0.0, 0.0, 0.0},
+                        std::array<double, 3> const& Vth = {0.2, 0.2, 0.2}, double mass = 1.0,
+                        double charge = 1.0)
+    {
+        for_each_patch([&](Patch<dimension>& patch) {
+            auto const origin = patch.origin[0];
+            patch.populations[iPop].load_particles(
+                nppc, [&](double x) { return density(origin + x); }, V, Vth, mass, charge);
+        });
+    }
+
+
+    // tracks the particles of the level for which select(particle) is true. Every patch
+    // tracks the ids of the whole species, so that tracked particles are found again in the
+    // patch they migrate to, and after a balance
+    void track(std::size_t iPop, auto select)
+    {
+        std::vector<std::size_t> ids;
+        for (auto const& patch : m_patches)
+            for (auto const& particle : patch.populations[iPop].particles())
+                if (select(particle))
+                    ids.push_back(particle.id);
+        for (auto& patch : m_patches)
+            patch.populations[iPop].track_ids(ids);
+        std::cout << "Tracking " << ids.size() << " particles of " << m_population_names[iPop]
+                  << ".\n";
+    }
+
+    auto const& population_names() const { return m_population_names; }
+
+    // ids tracked in the patches, each once, see track()
+    std::vector<std::size_t> tracked_ids(std::size_t iPop) const
+    {
+        std::vector<std::size_t> ids;
+        std::unordered_set<std::size_t> seen;
+        for (auto const& patch : m_patches)
+            for (auto const id : patch.populations[iPop].tracked_ids())
+                if (seen.insert(id).second)
+                    ids.push_back(id);
+        return ids;
+    }
+
+    // tracked particles of a species gathered from the patches in the order of their ids,
+    // positions in the domain frame, empty for the lost ones: one writer for the level
+    // instead of patches appending to the same file
+    std::vector<std::optional<Particle<dimension>>> tracked_particles(std::size_t iPop)
+    {
+        auto const nbr_tracked = tracked_ids(iPop).size();
+        std::vector<std::optional<Particle<dimension>>> tracked(nbr_tracked);
+        for (auto& patch : m_patches)
+        {
+            auto& population = patch.populations[iPop];
+            population.update_tracked();
+            auto const& indexes = population.tracked();
+            if (indexes.size() != nbr_tracked)
+                throw std::runtime_error("patches must track the same ids, see PatchLevel::track");
+            for (std::size_t iTrack = 0; iTrack < nbr_tracked; ++iTrack)
+            {
+                if (indexes[iTrack] == Population<dimension>::lost_particle)
+                    continue;
+                auto particle = population.particles()[indexes[iTrack]];
+                particle.position[0] += patch.origin[0];
+                tracked[iTrack] = particle;
+            }
+        }
+        return tracked;
+    }
+
+
+    // fills the ghosts of field_of(patch), a Field or a VecField, from the neighbour patches
+    template<typename FieldOf>
+    void fill_ghosts(FieldOf&& field_of)
+    {
+        using FieldT = std::remove_reference_t<decltype(field_of(m_patches[0]))>;
+        if constexpr (std::is_same_v<FieldT, VecField<dimension>>)
+        {
+            fill_ghosts([&](Patch<dimension>& patch) -> auto& { return field_of(patch).x; });
+            fill_ghosts([&](Patch<dimension>& patch) -> auto& { return field_of(patch).y; });
+            fill_ghosts([&](Patch<dimension>& patch) -> auto& { return field_of(patch).z; });
+        }
+        else
+        {
+            HYBIRT_TIME_SCOPE("patch_ghosts");
+            auto const qty = field_of(m_patches[0]).quantity();
+
+            // moments first fold the ghosts into the domain, the copies read folded values
+            if (!m_patches[0].plan.transfers(qty).accumulate.empty())
+                exchange(field_of, qty, true);
+            exchange(field_of, qty, false);
+        }
+    }
+
+
+    // moves the particles that left their patch to the neighbour they entered.
+    // Particles may cross at most one patch per call.
+    void migrate_particles()
+    {
+        HYBIRT_TIME_SCOPE("patch_migration");
+
+        for (std::size_t iPop = 0; iPop < m_population_names.size(); ++iPop)
+        {
+            // leaving particles go to per-patch outgoing buffers, the others are compacted
+            for_each_patch([&](Patch<dimension>& patch) {
+                auto& particles         = patch.populations[iPop].particles();
+                auto& outgoing          = m_outgoing[patch.index];
+                auto const patch_length = length(patch);
+                auto const left_length  = length(neighbour(patch, -1));
+                auto const right_length = length(neighbour(patch, +1));
+                outgoing[0].clear();
+                outgoing[1].clear();
+
+                std::size_t kept = 0;
+                for (std::size_t iPart = 0; iPart < particles.size(); ++iPart)
+                {
+                    auto particle = particles[iPart];
+                    auto& x       = particle.position[0];
+                    if (x >= 0.0 and x < patch_length)
+                    {
+                        if (kept != iPart)
+                            particles[kept] = particle;
+                        ++kept;
+                        continue;
+                    }
+                    if (x < -left_length or x >= patch_length + right_length)
+                        throw std::runtime_error("particle crossed more than one patch");
+
+                    bool const to_left = x < 0.0;
+                    x += to_left ? left_length : -patch_length;
+                    outgoing[to_left ? 0 : 1].push_back(particle);
+                }
+                particles.resize(kept);
+            });
+
+            // each patch takes what its neighbours sent its way
+            for_each_patch([&](Patch<dimension>& patch) {
+                auto& population       = patch.populations[iPop];
+                auto& particles        = population.particles();
+                auto const& from_left  = m_outgoing[neighbour(patch, -1).index][1];
+                auto const& from_right = m_outgoing[neighbour(patch, +1).index][0];
+                auto const first       = particles.size();
+                particles.insert(particles.end(), from_left.begin(), from_left.end());
+                particles.insert(particles.end(), from_right.begin(), from_right.end());
+                population.find_tracked_from(first);
+            });
+        }
+    }
+
+
+    // cost of the most expensive patch over the mean cost, 1 is a perfect balance
+    double imbalance() const
+    {
+        auto const costs = patch_costs();
+        auto const total = std::accumulate(costs.begin(), costs.end(), 0.);
+        if (total <= 0.)
+            return 1.;
+        return *std::max_element(costs.begin(), costs.end()) * costs.size() / total;
+    }
+
+
+    // moves the patch boundaries so that the patches cost about the same, and the fields
+    // and particles with them. The cost of a patch, the time measured since the last balance
+    // or its number of particles if nothing was measured yet, is spread over its cells in
+    // proportion to their particles plus cell_weight particles for the field work.
+    // Ghosts are refilled, costs reset and the new patches track the same particles.
+    // Returns whether the boundaries moved.
+    bool balance(double cell_weight = 1.)
+    {
+        HYBIRT_TIME_SCOPE("load_balance");
+
+        auto const sizes = partition_by_cost(cell_costs(cell_weight), m_patches.size(),
+                                             min_cells());
+        bool moved       = false;
+        for (auto const& patch : m_patches)
+            moved = moved or sizes[patch.index] != patch.layout->nbr_cells(Direction::X);
+
+        if (moved)
+        {
+            auto patches = make_patches(sizes);
+            move_fields(patches);
+            move_particles(patches);
+            for (std::size_t iPop = 0; iPop < m_population_names.size(); ++iPop)
+                if (auto const ids = tracked_ids(iPop); !ids.empty())
+                    for (auto& patch : patches)
+                        patch.populations[iPop].track_ids(ids);
+            m_patches = std::move(patches);
+
+            auto const nbr_fields = m_patches[0].fields().size();
+            for (std::size_t iField = 0; iField < nbr_fields; ++iField)
+                fill_ghosts([iField](auto& patch) -> auto& { return *patch.fields()[iField]; });
+        }
+
+        for (auto& patch : m_patches)
+            patch.cost = 0.;
+        return moved;
+    }
+
+    // balances only when the imbalance exceeds threshold, e.g. 1.1 for 10%
+    bool balance_if_needed(double threshold, double cell_weight = 1.)
+    {
+        if (imbalance() <= threshold)
+            return false;
+        return balance(cell_weight);
+    }
+
+
+private:
+    // one exchange of the accumulations or of the copies of the plans.
+    // Images in the left neighbour depend on its size, they are the sources of the same
+    // transfers in its own plan, see NeighbourGhostPlan.
+    template<typename FieldOf>
+    void exchange(FieldOf& field_of, Quantity qty, bool accumulate)
+    {
+        auto const transfers_of = [qty, accumulate](Patch<dimension> const& patch) -> auto const& {
+            auto const& plan = patch.plan.transfers(qty);
+            return accumulate ? plan.accumulate : plan.copy;
+        };
+
+        // read phase: neighbours are only read, so patches can go in any order
+        for_each_patch([&](Patch<dimension>& patch) {
+            auto& buffer               = m_exchange_buffers[patch.index];
+            auto const& transfers      = transfers_of(patch);
+            auto& left                 = neighbour(patch, -1);
+            auto& right                = neighbour(patch, +1);
+            auto const& left_transfers = transfers_of(left);
+
+            buffer.clear();
+            for (std::size_t iTransfer = 0; iTransfer < transfers.size(); ++iTransfer)
+            {
+                auto const& transfer = transfers[iTransfer];
+                buffer.push_back(transfer.neighbour < 0
+                                     ? field_of(left)(left_transfers[iTransfer].source)
+                                     : field_of(right)(transfer.source));
+            }
+        });
+
+        // write phase, several accumulations may update the same node of a small patch
+        for_each_patch([&](Patch<dimension>& patch) {
+            auto const& buffer    = m_exchange_buffers[patch.index];
+            auto const& transfers = transfers_of(patch);
+            auto& own             = field_of(patch);
+            for (std::size_t iTransfer = 0; iTransfer < transfers.size(); ++iTransfer)
+            {
+                if (accumulate)
+                    own(transfers[iTransfer].ghost) += buffer[iTransfer];
+                else
+                    own(transfers[iTransfer].ghost) = buffer[iTransfer];
+            }
+        });
+    }
+
+    std::vector<Patch<dimension>> make_patches(std::vector<std::size_t> const& sizes) const
+    {
+        std::vector<Patch<dimension>> patches;
+        patches.reserve(sizes.size());
+        std::size_t first_cell = 0;
+        for (std::size_t iPatch = 0; iPatch < sizes.size(); ++iPatch)
+        {
+            // one layout per patch so that nothing is shared between the threads
+            auto layout = std::make_shared<GridLayout<dimension>>(
+                std::array<std::size_t, dimension>{sizes[iPatch]},
+                std::array<double, dimension>{m_cell_size}, m_nbr_ghosts);
+            patches.emplace_back(iPatch, first_cell,
+                                 std::array<double, dimension>{first_cell * m_cell_size}, layout,
+                                 m_population_names, m_population_ids);
+            first_cell += sizes[iPatch];
+        }
+        return patches;
+    }
+
+    std::vector<double> patch_costs() const
+    {
+        bool const measured = std::any_of(m_patches.begin(), m_patches.end(),
+                                          [](auto const& patch) { return patch.cost > 0.; });
+        std::vector<double> costs;
+        for (auto const& patch : m_patches)
+            costs.push_back(measured ? patch.cost : static_cast<double>(patch.nbr_particles()));
+        return costs;
+    }
+
+    // local cell of a particle, rounding may put it a hair out of its patch
+    static std::size_t cell_of(Patch<dimension> const& patch, double x)
+    {
+        auto const nbr_cells = patch.layout->nbr_cells(Direction::X);
+        auto const cell      = x / patch.layout->cell_size(Direction::X);
+        return std::min(static_cast<std::size_t>(std::max(cell, 0.)), nbr_cells - 1);
+    }
+
+    std::vector<double> cell_costs(double cell_weight) const
+    {
+        auto const costs = patch_costs();
+        std::vector<double> cell_costs(m_nbr_cells, 0.);
+        for (auto const& patch : m_patches)
+        {
+            std::vector<double> weights(patch.layout->nbr_cells(Direction::X), cell_weight);
+            for (auto const& pop : patch.populations)
+                for (auto const& particle : pop.particles())
+                    weights[cell_of(patch, particle.position[0])] += 1.;
+
+            auto const total = std::accumulate(weights.begin(), weights.end(), 0.);
+            for (std::size_t iCell = 0; iCell < weights.size(); ++iCell)
+                cell_costs[patch.first_cell + iCell]
+                    = total > 0. ? costs[patch.index] * weights[iCell] / total : 0.;
+        }
+        return cell_costs;
+    }
+
+    // index of the patch holding the global cell, the cell after the last is the first
+    std::size_t owner(std::vector<Patch<dimension>> const& patches, std::size_t cell) const
+    {
+        cell %= m_nbr_cells;
+        auto const found = std::upper_bound(
+            patches.begin(), patches.end(), cell,
+            [](std::size_t value, auto const& patch) { return value < patch.first_cell; });
+        return static_cast<std::size_t>(found - patches.begin()) - 1;
+    }
+
+    // domain nodes of the new patches are copied from the current patches holding them,
+    // ghosts are filled afterwards
+    void move_fields(std::vector<Patch<dimension>>& patches)
+    {
+        std::vector<std::vector<Field<dimension>*>> old_fields;
+        for (auto& patch : m_patches)
+            old_fields.push_back(patch.fields());
+
+        for (auto& patch : patches)
+        {
+            auto fields = patch.fields();
+            for (std::size_t iField = 0; iField < fields.size(); ++iField)
+            {
+                auto& field    = *fields[iField];
+                auto const qty = field.quantity();
+                auto const dsi = patch.layout->dom_start(qty, Direction::X);
+                auto const dei = patch.layout->dom_end(qty, Direction::X);
+                for (auto ix = dsi; ix <= dei; ++ix)
+                {
+                    auto const cell     = (patch.first_cell + ix - dsi) % m_nbr_cells;
+                    auto const iOld     = owner(m_patches, cell);
+                    auto const& old     = m_patches[iOld];
+                    auto const old_node = old.layout->dom_start(qty, Direction::X) + cell
+                                          - old.first_cell;
+                    field(ix) = (*old_fields[iOld][iField])(old_node);
+                }
+            }
+        }
+    }
+
+    void move_particles(std::vector<Patch<dimension>>& patches)
+    {
+        for (auto& old : m_patches)
+            for (std::size_t iPop = 0; iPop < m_population_names.size(); ++iPop)
+                for (auto particle : old.populations[iPop].particles())
+                {
+                    auto const cell = old.first_cell + cell_of(old, particle.position[0]);
+                    auto& patch     = patches[owner(patches, cell)];
+                    auto& x         = particle.position[0];
+                    x = std::max(x + (old.origin[0] - patch.origin[0]), 0.);
+                    patch.populations[iPop].particles().push_back(particle);
+                }
+    }
+
+    Patch<dimension>& neighbour(Patch<dimension> const& patch, int offset)
+    {
+        auto const nbr_patches = static_cast<long>(m_patches.size());
+        auto const index = (static_cast<long>(patch.index) + offset + nbr_patches) % nbr_patches;
+        return m_patches[index];
+    }
+
+    std::size_t m_nbr_cells;
+    double m_cell_size;
+    std::size_t m_nbr_ghosts;
+    std::vector<std::string> m_population_names;
+    std::vector<std::shared_ptr<ParticleIds>> m_population_ids; // one per species
+    std::vector<Patch<dimension>> m_patches;
+
+    // reused from one exchange to the next, one per patch
+    std::vector<std::vector<double>> m_exchange_buffers;
+    std::vector<std::array<std::vector<Particle<dimension>>, 2>> m_outgoing; // left, right
+};
+
+
+#endif // HYBIRT_PATCH_HPP
@@ -0,0 +1,344 @@
+#ifndef HYBIRT_PERF_COUNTERS_HPP
+#define HYBIRT_PERF_COUNTERS_HPP
+
+// hardware performance counters per phase, based on Linux perf_event_open
+//
+//    HYBIRT_COUNT_SCOPE("push", nbr_particles, estimated_flops);
+//
+// counts cycles, instructions, last level cache references/misses and L1 data read misses
+// over the enclosing scope. A scope opened outside of a parallel region, as the kernels are,
+// sums the counters of every OpenMP thread, so that the work of the parallel loops it wraps
+// is counted; inside a region it counts the calling thread. `items` (particles, cells...)
+// and the estimated flop count of the scope are used for derived metrics: IPC, miss rates,
+// DRAM bytes per item (LLC misses * cache line size), bandwidth and GFLOP/s.
+//
+// Counters are compiled in only when HYBIRT_PERF_COUNTERS is defined
+// (cmake -DHYBIRT_PERF_COUNTERS=ON). If the kernel refuses to open them
+// (not Linux, perf_event_paranoid, containers...) a note is printed once and the
+// scopes only measure wall-clock time.
+
+#include "parallel.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+enum class PerfEvent : std::size_t {
+    cycles = 0,
+    instructions,
+    llc_references,
+    llc_misses,
+    l1d_read_misses,
+    count
+};
+
+
+// counter group of the calling thread, opened on first use
+class ThreadCounters
+{
+public:
+    static constexpr std::size_t nbr_events = static_cast<std::size_t>(PerfEvent::count);
+    using Values                            = std::array<std::uint64_t, nbr_events>;
+
+    ThreadCounters()
+    {
+#if defined(__linux__)
+        auto const configs = std::array<std::pair<std::uint32_t, std::uint64_t>, nbr_events>{{
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                     | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+        }};
+
+        for (auto iEvent = 0u; iEvent < nbr_events; ++iEvent)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size           = sizeof(attr);
+            attr.type           = configs[iEvent].first;
+            attr.config         = configs[iEvent].second;
+            attr.disabled       = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            // this thread, any cpu, no group so that unsupported events can be skipped
+            m_fds[iEvent] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (m_fds[iEvent] >= 0)
+            {
+                ioctl(m_fds[iEvent], PERF_EVENT_IOC_RESET, 0);
+                ioctl(m_fds[iEvent], PERF_EVENT_IOC_ENABLE, 0);
+                m_available = true;
+            }
+        }
+#endif
+    }
+
+    ~ThreadCounters()
+    {
+#if defined(__linux__)
+        for (auto const fd : m_fds)
+            if (fd >= 0)
+                close(fd);
+#endif
+    }
+
+    ThreadCounters(ThreadCounters const&)            = delete;
+    ThreadCounters& operator=(ThreadCounters const&) = delete;
+
+    bool available() const { return m_available; }
+    bool available(PerfEvent event) const { return m_fds[static_cast<std::size_t>(event)] >= 0; }
+
+    // counter values since opening, scaled if the kernel multiplexed them
+    Values read() const
+    {
+        Values values{};
+#if defined(__linux__)
+        for (auto iEvent = 0u; iEvent < nbr_events; ++iEvent)
+        {
+            if (m_fds[iEvent] < 0)
+                continue;
+            std::uint64_t buffer[3]; // value, time enabled, time running
+            if (::read(m_fds[iEvent], buffer, sizeof(buffer)) != sizeof(buffer))
+                continue;
+            values[iEvent] = buffer[2] > 0 and buffer[2] < buffer[1]
+                                 ? static_cast<std::uint64_t>(
+                                       static_cast<double>(buffer[0]) * buffer[1] / buffer[2])
+                                 : buffer[0];
+        }
+#endif
+        return values;
+    }
+
+private:
+    std::array<int, nbr_events> m_fds{-1, -1, -1, -1, -1};
+    bool m_available = false;
+};
+
+
+
+class PerfCounters
+{
+public:
+    static constexpr std::size_t cache_line_size = 64;
+
+    struct PhaseCounts
+    {
+        std::size_t calls = 0;
+        double seconds    = 0.;
+        double items      = 0.;
+        double flops      = 0.;
+        ThreadCounters::Values events{};
+    };
+
+
+    static PerfCounters& instance()
+    {
+        static PerfCounters counters;
+        return counters;
+    }
+
+    ThreadCounters& this_thread()
+    {
+        thread_local ThreadCounters counters;
+        thread_local bool reported = false;
+        if (!reported)
+        {
+            reported = true;
+            std::lock_guard lock{m_mutex};
+            m_available = m_available and counters.available();
+            if (!counters.available() and !m_warned)
+            {
+                std::cout << "perf counters unavailable (check /proc/sys/kernel/perf_event_paranoid)"
+                          << ", only timing phases\n";
+                m_warned = true;
+            }
+        }
+        return counters;
+    }
+
+    std::size_t phase_id(std::string const& name)
+    {
+        std::lock_guard lock{m_mutex};
+        for (auto iPhase = 0u; iPhase < m_names.size(); ++iPhase)
+            if (m_names[iPhase] == name)
+                return iPhase;
+        m_names.push_back(name);
+        m_phases.emplace_back();
+        return m_phases.size() - 1;
+    }
+
+    void record(std::size_t phase, double seconds, double items, double flops,
+                ThreadCounters::Values const& start, ThreadCounters::Values const& stop)
+    {
+        std::lock_guard lock{m_mutex};
+        auto& counts = m_phases[phase];
+        ++counts.calls;
+        counts.seconds += seconds;
+        counts.items += items;
+        counts.flops += flops;
+        for (auto iEvent = 0u; iEvent < ThreadCounters::nbr_events; ++iEvent)
+            counts.events[iEvent] += stop[iEvent] - start[iEvent];
+    }
+
+    auto const& phases() const { return m_phases; }
+    auto const& names() const { return m_names; }
+
+
+    void print_summary(std::ostream& out = std::cout) const
+    {
+        std::lock_guard lock{m_mutex};
+        auto const event = [](PhaseCounts const& counts, PerfEvent e) {
+            return static_cast<double>(counts.events[static_cast<std::size_t>(e)]);
+        };
+
+        out << std::left << std::setw(16) << "phase" << std::right << std::setw(10) << "calls"
+            << std::setw(12) << "time (s)" << std::setw(8) << "IPC" << std::setw(12)
+            << "LLC miss %" << std::setw(12) << "L1D miss/it" << std::setw(12) << "bytes/item"
+            << std::setw(10) << "GB/s" << std::setw(10) << "GFLOP/s" << "\n";
+
+        for (auto iPhase = 0u; iPhase < m_phases.size(); ++iPhase)
+        {
+            auto const& counts = m_phases[iPhase];
+            if (counts.calls == 0)
+                continue;
+
+            auto const cycles       = event(counts, PerfEvent::cycles);
+            auto const instructions = event(counts, PerfEvent::instructions);
+            auto const references   = event(counts, PerfEvent::llc_references);
+            auto const misses       = event(counts, PerfEvent::llc_misses);
+            auto const l1d_misses   = event(counts, PerfEvent::l1d_read_misses);
+            auto const bytes        = misses * cache_line_size;
+
+            auto const print = [&](double value, int width, bool valid) {
+                if (valid)
+                    out << std::setw(width) << value;
+                else
+                    out << std::setw(width) << "-";
+            };
+
+            out << std::left << std::setw(16) << m_names[iPhase] << std::right << std::setw(10)
+                << counts.calls << std::fixed << std::setprecision(4) << std::setw(12)
+                << counts.seconds << std::setprecision(2);
+            print(instructions / cycles, 8, m_available and cycles > 0);
+            print(100. * misses / references, 12, m_available and references > 0);
+            print(l1d_misses / counts.items, 12, m_available and counts.items > 0);
+            print(bytes / counts.items, 12, m_available and counts.items > 0);
+            print(1e-9 * bytes / counts.seconds, 10, m_available and counts.seconds > 0);
+            print(1e-9 * counts.flops / counts.seconds, 10, counts.flops > 0 and counts.seconds > 0);
+            out << "\n";
+            out.unsetf(std::ios::fixed);
+        }
+    }
+
+
+private:
+    PerfCounters() = default;
+
+    mutable std::mutex m_mutex;
+    std::vector<std::string> m_names;
+    std::vector<PhaseCounts> m_phases;
+    bool m_available = true;
+    bool m_warned    = false;
+};
+
+
+
+// counters summed over the threads of the team when called outside of a parallel region,
+// each thread reading its own. Increments are differences of sums, so that they do not
+// depend on which thread gets which number in the region.
+inline ThreadCounters::Values read_team_counters()
+{
+    ThreadCounters::Values total{};
+    auto const add = [&total](ThreadCounters::Values const& values) {
+        for (auto iEvent = 0u; iEvent < ThreadCounters::nbr_events; ++iEvent)
+            total[iEvent] += values[iEvent];
+    };
+
+    if (in_parallel())
+    {
+        add(PerfCounters::instance().this_thread().read());
+        return total;
+    }
+#pragma omp parallel
+    {
+        auto const values = PerfCounters::instance().this_thread().read();
+#pragma omp critical(hybirt_perf_counters)
+        add(values);
+    }
+    return total;
+}
+
+
+
+class ScopedCounters
+{
+public:
+    ScopedCounters(std::size_t phase, double items, double flops)
+        : m_phase{phase}
+        , m_items{items}
+        , m_flops{flops}
+        , m_start{read_team_counters()}
+        , m_start_time{std::chrono::steady_clock::now()}
+    {
+    }
+
+    // the time excludes the parallel regions that read the counters
+    ~ScopedCounters()
+    {
+        auto const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                           - m_start_time)
+                                 .count();
+        auto const stop = read_team_counters();
+        PerfCounters::instance().record(m_phase, seconds, m_items, m_flops, m_start, stop);
+    }
+
+    ScopedCounters(ScopedCounters const&)            = delete;
+    ScopedCounters& operator=(ScopedCounters const&) = delete;
+
+private:
+    std::size_t m_phase;
+    double m_items;
+    double m_flops;
+    ThreadCounters::Values m_start;
+    std::chrono::steady_clock::time_point m_start_time;
+};
+
+
+
+#define HYBIRT_PERF_CONCAT_IMPL(a, b) a##b
+#define HYBIRT_PERF_CONCAT(a, b) HYBIRT_PERF_CONCAT_IMPL(a, b)
+
+#ifdef HYBIRT_PERF_COUNTERS
+#define HYBIRT_COUNT_SCOPE(name, items, flops)                                                    \
+    static std::size_t const HYBIRT_PERF_CONCAT(hybirt_counted_phase_, __LINE__)                  \
+        = PerfCounters::instance().phase_id(name);                                                \
+    ScopedCounters HYBIRT_PERF_CONCAT(hybirt_counters_, __LINE__)                                 \
+    {                                                                                             \
+        HYBIRT_PERF_CONCAT(hybirt_counted_phase_, __LINE__), static_cast<double>(items),          \
+            static_cast<double>(flops)                                                            \
+    }
+#else
+#define HYBIRT_COUNT_SCOPE(name, items, flops)
+#endif
+
+
+#endif // HYBIRT_PERF_COUNTERS_HPP
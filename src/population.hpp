@@ -4,12 +4,21 @@
 #include "field.hpp"
 #include "vecfield.hpp"
 #include "particle.hpp"
+#include "interpolator.hpp"
+#include "timers.hpp"
+#include "perf_counters.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <random>
 #include <optional>
+#include <unordered_map>
+#include <stdexcept>
 #include <iostream>
 #include <string>
 #include <functional>
+#include <vector>
 
 
 std::mt19937_64 getRNG(std::optional<std::size_t> const& seed)
@@ -38,29 +47,44 @@ void maxwellianVelocity(std::array<double, 3> const& V, std::array<double, 3> co
 }
 
 
+// analytic background distribution of a delta f population, uniform in space
+struct Maxwellian
+{
+    double density            = 1.0;
+    std::array<double, 3> V   = {0.0, 0.0, 0.0}; // bulk velocity
+    std::array<double, 3> Vth = {0.2, 0.2, 0.2}; // thermal velocity
+};
+
+
 
 
 template<std::size_t dimension>
 class Population
 {
 public:
-    Population(std::string name, std::shared_ptr<GridLayout<dimension>> grid)
+    // populations of the same species share their ids, a new sequence is started by default
+    Population(std::string name, std::shared_ptr<GridLayout<dimension>> grid,
+               std::shared_ptr<ParticleIds> ids = nullptr)
         : m_name{name}
         , m_grid{grid}
-        , m_flux{grid, {Quantity::Vx, Quantity::Vy, Quantity::Vz}}
-        , m_density(m_grid->allocate(Quantity::N), {Quantity::N})
+        , m_ids{ids ? ids : std::make_shared<ParticleIds>()}
+        , m_particles{typename ParticleArray<dimension>::allocator_type{m_name}}
     {
         if (!grid)
             throw std::runtime_error("GridLayout is null");
     }
 
 
-    void load_particles(int nppc, auto density)
+    // V is the bulk velocity, Vth the thermal velocity in each direction. Velocities are
+    // drawn from a random seed unless one is given
+    void load_particles(int nppc, auto density, std::array<double, 3> const& V = {0.0, 0.0, 0.0},
+                        std::array<double, 3> const& Vth = {0.2, 0.2, 0.2}, double mass = 1.0,
+                        double charge = 1.0, std::optional<std::size_t> const& seed = std::nullopt)
     {
         static_assert(dimension == 1, "Population only implemented for 1D");
-        auto randGen = getRNG(std::nullopt);
-        std::array<double, 3> Vth{0.2, 0.2, 0.2}; // thermal velocity in each direction
-        std::array<double, 3> V{0.0, 0.0, 0.0};   // bulk velocity
+        auto randGen = getRNG(seed);
+        m_mass       = mass;
+        m_particles.reserve(m_particles.size() + m_grid->nbr_cells(Direction::X) * nppc);
 
         for (auto iCell = m_grid->dual_dom_start(Direction::X);
              iCell <= m_grid->dual_dom_end(Direction::X); ++iCell)
@@ -76,8 +100,9 @@ public:
                     = x + 0.0 * m_grid->cell_size(Direction::X); // center of the cell
                 maxwellianVelocity(V, Vth, randGen, particle.v);
                 particle.weight = cell_weight;
-                particle.mass   = 1.0; // hard-coded mass
-                particle.charge = 1.0; // hard-coded charge
+                particle.mass   = mass;
+                particle.charge = charge;
+                particle.id     = m_ids->next();
 
                 m_particles.push_back(particle);
             }
@@ -85,38 +110,250 @@ public:
         std::cout << "Loaded " << m_particles.size() << " particles.\n";
     }
 
+    // delta f mode: particles are markers drawn from the background and their weight is the
+    // perturbation of the distribution they carry, delta_density(x) / nppc at the load.
+    // Moments are the background plus the deposited perturbation, so that their noise scales
+    // with the perturbation instead of the whole distribution.
+    // Each marker also keeps the weight of the whole distribution it carries, p + W0 with p
+    // the marker weight: it is constant along the orbit, see evolve_weights.
+    void load_delta_f(int nppc, Maxwellian const& background, auto delta_density,
+                      double mass = 1.0, double charge = 1.0,
+                      std::optional<std::size_t> const& seed = std::nullopt)
+    {
+        if (!m_particles.empty())
+            throw std::runtime_error("delta f markers are loaded in an empty population");
+        for (auto const vth : background.Vth)
+            if (vth <= 0.)
+                throw std::runtime_error("a delta f background needs positive thermal velocities");
+
+        m_background             = background;
+        auto const marker_weight = background.density / nppc;
+        load_particles(
+            nppc, [&](double) { return background.density; }, background.V, background.Vth,
+            mass, charge, seed);
+        for (auto& particle : m_particles)
+        {
+            particle.weight       = delta_density(particle.position[0]) / nppc;
+            particle.total_weight = marker_weight + particle.weight;
+        }
+    }
+
+    // advances the weights of a delta f population over dt along the orbits, so that the
+    // total distribution is conserved while the background is not. Markers are drawn from
+    // the background f0, so W = P - p f0(z) / f0(z0) with P = p + W0 the total weight and
+    //   dW/dt = (P - W) sum_i (v_i - V_i) a_i / Vth_i^2
+    // with a = q/m (E + v x B). The rate is integrated exactly over the step, the update is
+    // second order when the velocities are centered on it.
+    template<std::size_t order = interp_order>
+    void evolve_weights(VecField<dimension> const& E, VecField<dimension> const& B, double dt)
+    {
+        HYBIRT_TIME_SCOPE("delta_f_weights");
+        if (!m_background)
+            throw std::runtime_error(m_name + " is not a delta f population");
+        auto const& V   = m_background->V;
+        auto const& Vth = m_background->Vth;
+
+        for (auto& particle : m_particles)
+        {
+            auto const at = [&](Field<dimension> const& field) {
+                return interpolate<order>(field, *m_grid, particle.position);
+            };
+            std::array<double, 3> const e{at(E.x), at(E.y), at(E.z)};
+            std::array<double, 3> const b{at(B.x), at(B.y), at(B.z)};
+            auto const& v = particle.v;
+            std::array<double, 3> const force{e[0] + v[1] * b[2] - v[2] * b[1],
+                                              e[1] + v[2] * b[0] - v[0] * b[2],
+                                              e[2] + v[0] * b[1] - v[1] * b[0]};
+
+            double rate = 0.;
+            for (std::size_t iComp = 0; iComp < 3; ++iComp)
+                rate += (v[iComp] - V[iComp]) * force[iComp] / (Vth[iComp] * Vth[iComp]);
+            rate *= particle.charge / particle.mass;
+
+            particle.weight = particle.total_weight
+                              - (particle.total_weight - particle.weight) * std::exp(-rate * dt);
+        }
+    }
+
+    // adds the background to the moments of a delta f population, on every node: call it
+    // once the ghosts of the deposit are filled. Full f populations have nothing to add.
+    void add_background() { add_background(density(), flux()); }
+
+    // same onto other moments, e.g. the totals of all the populations
+    void add_background(Field<dimension>& density, VecField<dimension>& flux) const
+    {
+        if (!m_background)
+            return;
+        auto const n0 = m_background->density;
+        auto const& V = m_background->V;
+        for (auto& n : density)
+            n += n0;
+        for (auto& fx : flux.x)
+            fx += n0 * V[0];
+        for (auto& fy : flux.y)
+            fy += n0 * V[1];
+        for (auto& fz : flux.z)
+            fz += n0 * V[2];
+    }
+
+    bool delta_f() const { return m_background.has_value(); }
+    auto const& background() const { return m_background; }
+    double mass() const { return m_mass; }
+
+    // density and flux on the primal nodes with the particle shape of the given order, the
+    // one of the gather. Ghosts get what the shape spills over the domain edges, the ghost
+    // fill folds it back. In delta f mode this is the perturbation only, see add_background.
+    template<std::size_t order = interp_order>
     void deposit()
     {
-        static_assert(dimension == 1, "Population only implemented for 1D");
-        for (auto& n : m_density)
+        auto& density = this->density();
+        auto& flux    = this->flux();
+        for (auto& n : density)
         {
             n = 0.0; // Reset the field
         }
 
-        for (auto& fx : m_flux.x)
+        for (auto& fx : flux.x)
             fx = 0.0;
-        for (auto& fy : m_flux.y)
+        for (auto& fy : flux.y)
             fy = 0.0;
-        for (auto& fz : m_flux.z)
+        for (auto& fz : flux.z)
             fz = 0.0;
 
+        deposit<order>(density, flux);
+    }
+
+    // adds the density and flux of the particles to other moments, e.g. to the totals of all
+    // the populations in a single pass, see moments.hpp
+    template<std::size_t order = interp_order>
+    void deposit(Field<dimension>& density, VecField<dimension>& flux) const
+    {
+        HYBIRT_TIME_SCOPE("deposit");
+        HYBIRT_COUNT_SCOPE("deposit", m_particles.size(), 0);
+        static_assert(dimension == 1, "Population only implemented for 1D");
+        if (m_grid->nbr_ghosts() < Shape<order>::nbr_ghosts)
+            throw std::runtime_error("particle shapes of order " + std::to_string(order)
+                                     + " need " + std::to_string(Shape<order>::nbr_ghosts)
+                                     + " ghost nodes");
+
         for (auto const& particle : m_particles)
         {
-            double const iCell_float = particle.position[0] / m_grid->cell_size(Direction::X);
-            int const iCell_         = static_cast<int>(iCell_float);
-            double const reminder    = iCell_float - iCell_;
-            auto const iCell         = iCell_ + m_grid->dual_dom_start(Direction::X);
+            auto const stencil
+                = Shape<order>::at(node_position(*m_grid, Quantity::N, particle.position[0]));
 
+            unroll<Shape<order>::nbr_points>([&](std::size_t point) {
+                auto const ix     = stencil.first + point;
+                auto const weight = particle.weight * stencil.weights[point];
+                density(ix) += weight;
+                flux.x(ix) += weight * particle.v[0];
+                flux.y(ix) += weight * particle.v[1];
+                flux.z(ix) += weight * particle.v[2];
+            });
+        }
+    }
 
-            // TODO implement linear weighting deposit for the density and flux
+    // tag the particles for which select(particle) is true
+    // their index is kept so that tracking diagnostics only scan the population after
+    // particles moved in it, see update_tracked
+    void track(auto select)
+    {
+        m_tracked.clear();
+        m_tracked_ids.clear();
+        m_tracked_slots.clear();
+        for (std::size_t iPart = 0; iPart < m_particles.size(); ++iPart)
+        {
+            if (select(m_particles[iPart]))
+            {
+                m_tracked_slots[m_particles[iPart].id] = m_tracked.size();
+                m_tracked.push_back(iPart);
+                m_tracked_ids.push_back(m_particles[iPart].id);
+            }
         }
+        std::cout << "Tracking " << m_tracked.size() << " particles of " << m_name << ".\n";
+    }
+
+    // tracks the particles of these ids, in this order, whether they are in this population
+    // or not yet: patches of a species all track the ids of the whole species
+    void track_ids(std::vector<std::size_t> const& ids)
+    {
+        m_tracked_ids = ids;
+        m_tracked.assign(ids.size(), lost_particle);
+        m_tracked_slots.clear();
+        for (std::size_t iTrack = 0; iTrack < ids.size(); ++iTrack)
+            m_tracked_slots[ids[iTrack]] = iTrack;
+        find_tracked_from(0);
+    }
+
+    // looks the particles from index first on up in the tracked ones, for particles appended
+    // from another patch or rank, which update_tracked does not look for when nothing moved
+    void find_tracked_from(std::size_t first)
+    {
+        if (m_tracked_slots.empty())
+            return;
+        for (std::size_t iPart = first; iPart < m_particles.size(); ++iPart)
+            if (auto const slot = m_tracked_slots.find(m_particles[iPart].id);
+                slot != m_tracked_slots.end())
+                m_tracked[slot->second] = iPart;
+    }
+
+    // finds the tracked particles again once particles moved in the array. Boundaries,
+    // patches, refinement and ranks remove and append particles in no particular order, so
+    // if any index no longer points to its particle, one pass over the particles looks
+    // each id up in the tracked ones. Particles not found are marked lost_particle.
+    void update_tracked()
+    {
+        auto const in_place = [&](std::size_t iTrack) {
+            auto const index = m_tracked[iTrack];
+            return index == lost_particle
+                   or (index < m_particles.size()
+                       and m_particles[index].id == m_tracked_ids[iTrack]);
+        };
+        bool stale = false;
+        for (std::size_t iTrack = 0; iTrack < m_tracked.size() and !stale; ++iTrack)
+            stale = !in_place(iTrack);
+        if (!stale)
+            return;
+
+        std::fill(m_tracked.begin(), m_tracked.end(), lost_particle);
+        find_tracked_from(0);
     }
 
-    auto& density() { return m_density; }
-    auto const& density() const { return m_density; }
+    // indexes of the tracked particles in particles() as of the last update_tracked(),
+    // lost_particle for those that left the population
+    auto const& tracked() const { return m_tracked; }
+    auto const& tracked_ids() const { return m_tracked_ids; }
+
+    static constexpr std::size_t lost_particle = std::numeric_limits<std::size_t>::max();
 
-    auto& flux() { return m_flux; }
-    auto const& flux() const { return m_flux; }
+    // ids are never reused, particles created after the load must take theirs from here
+    std::size_t new_particle_id() { return m_ids->next(); }
+    auto const& ids() const { return m_ids; }
+
+    // moments of the population alone, allocated on first use: populations that only deposit
+    // into the totals, see accumulate_moments, never hold them
+    auto& density()
+    {
+        allocate_moments();
+        return *m_density;
+    }
+    auto const& density() const
+    {
+        check_moments();
+        return *m_density;
+    }
+
+    auto& flux()
+    {
+        allocate_moments();
+        return *m_flux;
+    }
+    auto const& flux() const
+    {
+        check_moments();
+        return *m_flux;
+    }
+
+    bool has_moments() const { return m_density.has_value(); }
 
     auto& particles() { return m_particles; }
     auto const& particles() const { return m_particles; }
@@ -124,11 +361,31 @@ public:
     auto name() const { return m_name; }
 
 private:
+    void allocate_moments()
+    {
+        if (m_density)
+            return;
+        m_flux.emplace(m_grid, std::array<Quantity, 3>{Quantity::Vx, Quantity::Vy, Quantity::Vz});
+        m_density.emplace(m_grid->allocate(Quantity::N), Quantity::N);
+    }
+
+    void check_moments() const
+    {
+        if (!m_density)
+            throw std::runtime_error("the moments of " + m_name + " were never deposited");
+    }
+
     std::string m_name;
     std::shared_ptr<GridLayout<dimension>> m_grid;
-    VecField<dimension> m_flux;
-    Field<dimension> m_density;
-    std::vector<Particle<dimension>> m_particles;
+    std::shared_ptr<ParticleIds> m_ids;
+    std::optional<VecField<dimension>> m_flux;
+    std::optional<Field<dimension>> m_density;
+    ParticleArray<dimension> m_particles;
+    std::vector<std::size_t> m_tracked; // indexes of tracked particles in m_particles
+    std::vector<std::size_t> m_tracked_ids;
+    std::unordered_map<std::size_t, std::size_t> m_tracked_slots; // id to its place in m_tracked
+    std::optional<Maxwellian> m_background; // set in delta f mode only
+    double m_mass = 1.0;                    // of the particles, as last loaded
 };
 
 #endif
@@ -0,0 +1,123 @@
+#ifndef HYBIRT_PROFILES_HPP
+#define HYBIRT_PROFILES_HPP
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <numbers>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// initial profiles f(x) built from a short text description "kind:p0,p1,...":
+//
+//   uniform:v                    v
+//   sine:mean,amplitude,k        mean + amplitude * sin(k * x)
+//   cosine:mean,amplitude,k      mean + amplitude * cos(k * x)
+//   tanh:left,right,x0,width     left + (right - left) * 0.5 * (1 + tanh((x - x0) / width))
+//   harris:background,peak,x0,width  background + peak / cosh((x - x0) / width)^2
+//   gaussian:background,peak,x0,width  background + peak * exp(-((x - x0) / width)^2)
+//
+// a plain number is a uniform profile
+using Profile = std::function<double(double)>;
+
+
+// numbers of the text descriptions: the whole text, blanks around apart, must be the number,
+// so that "100abc" or "1,5" are errors instead of 100 or 1
+inline std::string_view trim_blanks(std::string const& value)
+{
+    auto const first = value.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+        return {};
+    auto const last = value.find_last_not_of(" \t\r");
+    return std::string_view{value}.substr(first, last - first + 1);
+}
+
+inline double parse_double(std::string const& value)
+{
+    auto const text         = trim_blanks(value);
+    double number           = 0.;
+    auto const [end, error] = std::from_chars(text.data(), text.data() + text.size(), number);
+    if (text.empty() or error != std::errc{} or end != text.data() + text.size())
+        throw std::runtime_error("expected a number, got '" + value + "'");
+    return number;
+}
+
+// counts and sizes: a negative value is an error, not a huge one
+inline std::size_t parse_unsigned(std::string const& value)
+{
+    auto const text         = trim_blanks(value);
+    std::size_t number      = 0;
+    auto const [end, error] = std::from_chars(text.data(), text.data() + text.size(), number);
+    if (text.empty() or error != std::errc{} or end != text.data() + text.size())
+        throw std::runtime_error("expected a non negative integer, got '" + value + "'");
+    return number;
+}
+
+
+inline Profile make_profile(std::string const& description)
+{
+    auto const colon = description.find(':');
+    auto const kind  = description.substr(0, colon);
+
+    std::vector<double> p;
+    if (colon != std::string::npos)
+    {
+        std::stringstream stream{description.substr(colon + 1)};
+        std::string item;
+        while (std::getline(stream, item, ','))
+            p.push_back(parse_double(item));
+    }
+
+    auto const expect = [&](std::size_t nbr_params) {
+        if (p.size() != nbr_params)
+            throw std::runtime_error("profile " + kind + " expects " + std::to_string(nbr_params)
+                                     + " parameters: " + description);
+    };
+
+    if (colon == std::string::npos)
+    {
+        auto const value = parse_double(description);
+        return [value](double) { return value; };
+    }
+    if (kind == "uniform")
+    {
+        expect(1);
+        return [v = p[0]](double) { return v; };
+    }
+    if (kind == "sine")
+    {
+        expect(3);
+        return [p](double x) { return p[0] + p[1] * std::sin(p[2] * x); };
+    }
+    if (kind == "cosine")
+    {
+        expect(3);
+        return [p](double x) { return p[0] + p[1] * std::cos(p[2] * x); };
+    }
+    if (kind == "tanh")
+    {
+        expect(4);
+        return [p](double x) {
+            return p[0] + (p[1] - p[0]) * 0.5 * (1. + std::tanh((x - p[2]) / p[3]));
+        };
+    }
+    if (kind == "harris")
+    {
+        expect(4);
+        return [p](double x) { return p[0] + p[1] / std::pow(std::cosh((x - p[2]) / p[3]), 2); };
+    }
+    if (kind == "gaussian")
+    {
+        expect(4);
+        return [p](double x) { return p[0] + p[1] * std::exp(-std::pow((x - p[2]) / p[3], 2)); };
+    }
+    throw std::runtime_error("unknown profile: " + description);
+}
+
+
+#endif // HYBIRT_PROFILES_HPP
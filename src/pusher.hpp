@@ -4,8 +4,15 @@
 
 #include "vecfield.hpp"
 #include "particle.hpp"
+#include "interpolator.hpp"
+#include "timers.hpp"
+#include "perf_counters.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
 
@@ -15,6 +22,8 @@ class Pusher
 protected:
     std::shared_ptr<GridLayout<dimension>> layout_;
     double dt_;
+    double max_speed_       = 0.;
+    std::size_t nbr_pushed_ = 0;
 
 public:
     Pusher(std::shared_ptr<GridLayout<dimension>> layout, double dt)
@@ -23,44 +32,64 @@ public:
     {
     }
 
-    virtual void operator()(std::vector<Particle<dimension>>& particles,
-                            VecField<dimension> const& E, VecField<dimension> const& B)
+    virtual void operator()(ParticleArray<dimension>& particles, VecField<dimension> const& E,
+                            VecField<dimension> const& B)
         = 0;
 
+    // the time step may change from one push to the next, see time_step.hpp
+    void set_dt(double dt) { dt_ = dt; }
+    double dt() const { return dt_; }
+
+    // largest |vx| over the pushes since the last reset, e.g. over all the populations of a
+    // step, for the particle CFL. nbr_pushed() tells whether there was any push at all.
+    double max_speed() const { return max_speed_; }
+    std::size_t nbr_pushed() const { return nbr_pushed_; }
+    void reset_max_speed()
+    {
+        max_speed_  = 0.;
+        nbr_pushed_ = 0;
+    }
+
     virtual ~Pusher() {}
 };
 
 
 
-template<std::size_t dimension>
-class Boris : public Pusher<dimension>
+// E and B are gathered with the particle shape of the given order, the one of the deposit
+template<std::size_t dimension, std::size_t order = interp_order>
+class Boris final : public Pusher<dimension>
 {
 public:
     Boris(std::shared_ptr<GridLayout<dimension>> layout, double dt)
         : Pusher<dimension>{layout, dt}
     {
+        if (layout->nbr_ghosts() < Shape<order>::nbr_ghosts)
+            throw std::runtime_error("particle shapes of order " + std::to_string(order)
+                                     + " need " + std::to_string(Shape<order>::nbr_ghosts)
+                                     + " ghost nodes");
     }
 
-    void operator()(std::vector<Particle<dimension>>& particles, VecField<dimension> const& E,
+    void operator()(ParticleArray<dimension>& particles, VecField<dimension> const& E,
                     VecField<dimension> const& B) override
     {
+        HYBIRT_TIME_SCOPE("push");
+        HYBIRT_COUNT_SCOPE("push", particles.size(), 0);
+        double max_speed = 0.;
+#pragma omp parallel for reduction(max : max_speed)
         for (auto& particle : particles)
         {
             // TODO implement the Boris pusher
+
+            max_speed = std::max(max_speed, std::abs(particle.v[0]));
         }
+        this->max_speed_ = std::max(this->max_speed_, max_speed);
+        this->nbr_pushed_ += particles.size();
     }
 
 private:
-    double interpolate(Field<dimension> const& field, int iCell, double reminder) const
+    double interpolate(Field<dimension> const& field, Particle<dimension> const& particle) const
     {
-        if (this->layout_->centerings(field.quantity())[0] == this->layout_->dual)
-        {
-            if (reminder < 0.5)
-                return field(iCell - 1) * (1.0 - reminder) + field(iCell) * reminder;
-            else
-                return field(iCell) * (1.0 - reminder) + field(iCell + 1) * reminder;
-        }
-        return field(iCell) * (1.0 - reminder) + field(iCell + 1) * reminder;
+        return ::interpolate<order>(field, *this->layout_, particle.position);
     }
 };
 
@@ -0,0 +1,302 @@
+#ifndef HYBIRT_REDUCED_DIAGNOSTICS_HPP
+#define HYBIRT_REDUCED_DIAGNOSTICS_HPP
+
+#include "field.hpp"
+#include "vecfield.hpp"
+#include "particle.hpp"
+#include "population.hpp"
+#include "diagnostics.hpp"
+#include "timers.hpp"
+
+#include "highfive/highfive.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// 1D or 2D histogram of the particle velocities, optionally restricted to a spatial window
+// bins are uniform in [vmin, vmax[, particles outside the range are ignored
+class VelocityHistogram
+{
+public:
+    VelocityHistogram(std::string name, std::vector<std::size_t> components,
+                      std::vector<std::size_t> nbr_bins, std::vector<double> vmin,
+                      std::vector<double> vmax,
+                      std::optional<std::array<double, 2>> window = std::nullopt)
+        : m_name{name}
+        , m_components{components}
+        , m_nbr_bins{nbr_bins}
+        , m_vmin{vmin}
+        , m_vmax{vmax}
+        , m_window{window}
+    {
+        auto const ndim = m_components.size();
+        if (ndim < 1 or ndim > 2)
+            throw std::runtime_error("VelocityHistogram " + m_name + " must be 1D or 2D");
+        if (m_nbr_bins.size() != ndim or m_vmin.size() != ndim or m_vmax.size() != ndim)
+            throw std::runtime_error("VelocityHistogram " + m_name + " inconsistent bins");
+
+        std::size_t size = 1;
+        for (auto i = 0u; i < ndim; ++i)
+        {
+            if (m_components[i] > 2 or m_nbr_bins[i] == 0 or m_vmax[i] <= m_vmin[i])
+                throw std::runtime_error("VelocityHistogram " + m_name + " invalid bins");
+            m_inv_bin_size.push_back(m_nbr_bins[i] / (m_vmax[i] - m_vmin[i]));
+            size *= m_nbr_bins[i];
+        }
+        m_values.resize(size, 0.0);
+    }
+
+    void reset() { std::fill(m_values.begin(), m_values.end(), 0.0); }
+
+    template<std::size_t dimension>
+    void add(Particle<dimension> const& particle, double weight)
+    {
+        if (m_window
+            and (particle.position[0] < (*m_window)[0] or particle.position[0] >= (*m_window)[1]))
+            return;
+
+        std::size_t flat = 0;
+        for (auto i = 0u; i < m_components.size(); ++i)
+        {
+            auto const v = particle.v[m_components[i]];
+            if (v < m_vmin[i] or v >= m_vmax[i])
+                return;
+            auto const bin = static_cast<std::size_t>((v - m_vmin[i]) * m_inv_bin_size[i]);
+            flat           = flat * m_nbr_bins[i] + std::min(bin, m_nbr_bins[i] - 1);
+        }
+        m_values[flat] += weight;
+    }
+
+    auto const& name() const { return m_name; }
+    auto const& values() const { return m_values; }
+    auto const& nbr_bins() const { return m_nbr_bins; }
+    auto const& vmin() const { return m_vmin; }
+    auto const& vmax() const { return m_vmax; }
+    auto const& components() const { return m_components; }
+    auto const& window() const { return m_window; }
+
+private:
+    std::string m_name;
+    std::vector<std::size_t> m_components;
+    std::vector<std::size_t> m_nbr_bins;
+    std::vector<double> m_vmin;
+    std::vector<double> m_vmax;
+    std::vector<double> m_inv_bin_size;
+    std::optional<std::array<double, 2>> m_window;
+    std::vector<double> m_values; // row-major, last component varies fastest
+};
+
+
+
+
+// in-situ reductions of particles and fields written as small time series in reduced.h5
+// - per population: velocity histograms, kinetic energy and momentum. Energy and momentum
+//   are of the whole distribution, the background of a delta f population is added
+//   analytically, its histograms count the particle weights only, the perturbation
+// - total magnetic and electric energy
+// particles are visited once per population, all reductions are accumulated in that pass
+template<std::size_t dimension>
+class ReducedDiagnostics
+{
+public:
+    ReducedDiagnostics(std::shared_ptr<GridLayout<dimension>> grid,
+                       std::vector<std::string> population_names, std::string prefix = "")
+        : m_grid{grid}
+        , m_population_names{population_names}
+        , m_prefix{prefix}
+        , m_histograms(population_names.size())
+        , m_kinetic(population_names.size())
+        , m_momentum(population_names.size())
+    {
+        if (!m_grid)
+            throw std::runtime_error("GridLayout is null");
+    }
+
+    void add_histogram(std::string const& population, VelocityHistogram histogram)
+    {
+        m_histograms[population_index(population)].push_back(std::move(histogram));
+    }
+
+
+    void compute(std::vector<Population<dimension>> const& populations,
+                 VecField<dimension> const& E, VecField<dimension> const& B)
+    {
+        HYBIRT_TIME_SCOPE("diagnostics");
+        static_assert(dimension == 1, "ReducedDiagnostics only implemented for 1D");
+        if (populations.size() != m_population_names.size())
+            throw std::runtime_error("ReducedDiagnostics population count mismatch");
+
+        // particle weights are densities, dx turns them into numbers of physical particles
+        auto const dx = m_grid->cell_size(Direction::X);
+
+        for (auto iPop = 0u; iPop < populations.size(); ++iPop)
+        {
+            auto& histograms = m_histograms[iPop];
+            for (auto& histogram : histograms)
+                histogram.reset();
+
+            double kinetic = 0.0;
+            std::array<double, 3> momentum{0.0, 0.0, 0.0};
+
+            for (auto const& particle : populations[iPop].particles())
+            {
+                auto const w  = particle.weight * dx;
+                auto const mw = particle.mass * w;
+                auto const& v = particle.v;
+
+                kinetic += 0.5 * mw * (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+                momentum[0] += mw * v[0];
+                momentum[1] += mw * v[1];
+                momentum[2] += mw * v[2];
+
+                for (auto& histogram : histograms)
+                    histogram.add(particle, w);
+            }
+
+            // delta f weights only carry the perturbation, the Maxwellian background over
+            // the domain has momentum m n0 V L and energy m n0 (|V|^2 + sum Vth^2) L / 2
+            if (auto const& background = populations[iPop].background())
+            {
+                auto const mass = populations[iPop].mass() * background->density
+                                  * m_grid->nbr_cells(Direction::X) * dx;
+                for (std::size_t iComp = 0; iComp < 3; ++iComp)
+                {
+                    auto const V   = background->V[iComp];
+                    auto const Vth = background->Vth[iComp];
+                    momentum[iComp] += mass * V;
+                    kinetic += 0.5 * mass * (V * V + Vth * Vth);
+                }
+            }
+            m_kinetic[iPop]  = kinetic;
+            m_momentum[iPop] = momentum;
+        }
+
+        m_magnetic = 0.5 * (square_sum(B.x) + square_sum(B.y) + square_sum(B.z)) * dx;
+        m_electric = 0.5 * (square_sum(E.x) + square_sum(E.y) + square_sum(E.z)) * dx;
+
+        if (!m_initial_energy)
+            m_initial_energy = total_energy();
+    }
+
+
+    double kinetic_energy(std::size_t iPop) const { return m_kinetic[iPop]; }
+    auto const& momentum(std::size_t iPop) const { return m_momentum[iPop]; }
+    auto const& histograms(std::size_t iPop) const { return m_histograms[iPop]; }
+    double magnetic_energy() const { return m_magnetic; }
+    double electric_energy() const { return m_electric; }
+
+    double total_energy() const
+    {
+        double total = m_magnetic + m_electric;
+        for (auto const kinetic : m_kinetic)
+            total += kinetic;
+        return total;
+    }
+
+    // relative change of the total energy since the first call to compute()
+    double energy_drift() const
+    {
+        if (!m_initial_energy or *m_initial_energy == 0.0)
+            return 0.0;
+        return std::abs(total_energy() - *m_initial_energy) / std::abs(*m_initial_energy);
+    }
+
+
+    void write(double time, HighFive::File::AccessMode mode = HighFive::File::ReadWrite) const
+    {
+        HYBIRT_TIME_SCOPE("diagnostics");
+        std::lock_guard lock{hdf5_mutex()};
+        std::string filename = m_prefix + "reduced.h5";
+        HighFive::File file(filename, mode);
+
+        if (!file.exist("/time"))
+            create_datasets(file);
+
+        diags_append_row(file, "/time", {time});
+        diags_append_row(file, "/energy/magnetic", {m_magnetic});
+        diags_append_row(file, "/energy/electric", {m_electric});
+        diags_append_row(file, "/energy/total", {total_energy()});
+
+        for (auto iPop = 0u; iPop < m_population_names.size(); ++iPop)
+        {
+            auto const path      = "/" + m_population_names[iPop];
+            auto const& momentum = m_momentum[iPop];
+            diags_append_row(file, path + "/kinetic_energy", {m_kinetic[iPop]});
+            diags_append_row(file, path + "/momentum",
+                             std::vector<double>{momentum.begin(), momentum.end()});
+            for (auto const& histogram : m_histograms[iPop])
+                diags_append_row(file, path + "/" + histogram.name(), histogram.values());
+        }
+    }
+
+
+private:
+    std::size_t population_index(std::string const& name) const
+    {
+        for (auto iPop = 0u; iPop < m_population_names.size(); ++iPop)
+            if (m_population_names[iPop] == name)
+                return iPop;
+        throw std::runtime_error("ReducedDiagnostics: unknown population " + name);
+    }
+
+    // sum of squares over the domain nodes, the last primal node is the periodic image
+    // of the first one and is not counted
+    double square_sum(Field<dimension> const& field) const
+    {
+        auto const start = m_grid->dom_start(field.quantity(), Direction::X);
+        auto const end   = start + m_grid->nbr_cells(Direction::X);
+        double sum       = 0.0;
+        for (auto ix = start; ix < end; ++ix)
+            sum += field(ix) * field(ix);
+        return sum;
+    }
+
+    void create_datasets(HighFive::File& file) const
+    {
+        diags_create_timeseries(file, "/time", 1);
+        diags_create_timeseries(file, "/energy/magnetic", 1);
+        diags_create_timeseries(file, "/energy/electric", 1);
+        diags_create_timeseries(file, "/energy/total", 1);
+
+        for (auto iPop = 0u; iPop < m_population_names.size(); ++iPop)
+        {
+            auto const path = "/" + m_population_names[iPop];
+            diags_create_timeseries(file, path + "/kinetic_energy", 1);
+            diags_create_timeseries(file, path + "/momentum", 3);
+            for (auto const& histogram : m_histograms[iPop])
+            {
+                auto const name = path + "/" + histogram.name();
+                diags_create_timeseries(file, name, histogram.values().size());
+                auto dataset = file.getDataSet(name);
+                dataset.createAttribute("components", histogram.components());
+                dataset.createAttribute("nbr_bins", histogram.nbr_bins());
+                dataset.createAttribute("vmin", histogram.vmin());
+                dataset.createAttribute("vmax", histogram.vmax());
+                if (histogram.window())
+                    dataset.createAttribute("window", *histogram.window());
+            }
+        }
+    }
+
+    std::shared_ptr<GridLayout<dimension>> m_grid;
+    std::vector<std::string> m_population_names;
+    std::string m_prefix;
+    std::vector<std::vector<VelocityHistogram>> m_histograms;
+    std::vector<double> m_kinetic;
+    std::vector<std::array<double, 3>> m_momentum;
+    double m_magnetic = 0.0;
+    double m_electric = 0.0;
+    std::optional<double> m_initial_energy;
+};
+
+
+#endif // HYBIRT_REDUCED_DIAGNOSTICS_HPP
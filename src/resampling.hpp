@@ -0,0 +1,320 @@
+#ifndef HYBIRT_RESAMPLING_HPP
+#define HYBIRT_RESAMPLING_HPP
+
+#include "gridlayout.hpp"
+#include "particle.hpp"
+#include "timers.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+
+// merging and splitting of particles that keeps the number of particles of every cell within
+// [min_ppc, max_ppc], so that compressed regions do not pile up particles and rarefied ones do
+// not go noisy. Cells out of the band are brought back to the middle of it.
+//
+// Merging bins the velocities of a crowded cell on a coarse grid spanning the cell and turns
+// groups of particles of the same bin into two particles of half its weight, at the centroid
+// of the group and at U +- sigma e, U being its mean velocity and sigma its velocity spread:
+// the weight, the momentum and the kinetic energy of the group are conserved. Particles of
+// distant velocities, two beams for instance, are not merged together unless the cell
+// cannot reach the band otherwise.
+// Splitting halves the heaviest particle of a sparse cell in two particles of the same
+// velocity, placed symmetrically around it inside the cell, which conserves everything too.
+//
+// Particles keep their order: merged particles reuse the slots and ids of the first two of
+// their group, the others are removed by a stable compaction, and split halves are appended
+// with new ids.
+template<std::size_t dimension>
+class Resampler
+{
+    using Particles = ParticleArray<dimension>;
+
+public:
+    Resampler(std::shared_ptr<GridLayout<dimension>> grid, std::size_t min_ppc,
+              std::size_t max_ppc, std::size_t nbr_velocity_bins = 8)
+        : m_grid{grid}
+        , m_min_ppc{min_ppc}
+        , m_max_ppc{max_ppc}
+        , m_nbr_velocity_bins{nbr_velocity_bins}
+    {
+        if (!m_grid)
+            throw std::runtime_error("GridLayout is null");
+        if (m_max_ppc < 2 or m_min_ppc > m_max_ppc)
+            throw std::runtime_error("resampling needs 2 <= max_ppc and min_ppc <= max_ppc");
+        if (m_nbr_velocity_bins == 0)
+            throw std::runtime_error("resampling needs at least one velocity bin");
+    }
+
+
+    template<typename Population>
+    void operator()(Population& population)
+    {
+        static_assert(dimension == 1, "Resampler only implemented for 1D");
+        HYBIRT_TIME_SCOPE("resampling");
+        if (population.delta_f())
+            throw std::runtime_error("delta f weights are signed and cannot be resampled");
+
+        auto& particles = population.particles();
+        sort_by_cell(particles);
+        m_removed.assign(particles.size(), false);
+
+        auto const target = std::max<std::size_t>((m_min_ppc + m_max_ppc) / 2, 2);
+        for (std::size_t iCell = 0; iCell + 1 < m_cell_start.size(); ++iCell)
+        {
+            m_cell.assign(m_order.begin() + m_cell_start[iCell],
+                          m_order.begin() + m_cell_start[iCell + 1]);
+            auto const count = m_cell.size();
+            if (count > m_max_ppc)
+                merge(particles, count - target);
+            else if (count > 0 and count < m_min_ppc)
+                split(population, iCell, target - count);
+        }
+
+        // appended halves are past m_removed and always kept
+        std::size_t kept = 0;
+        for (std::size_t iPart = 0; iPart < particles.size(); ++iPart)
+        {
+            if (iPart < m_removed.size() and m_removed[iPart])
+                continue;
+            if (kept != iPart)
+                particles[kept] = particles[iPart];
+            ++kept;
+        }
+        particles.resize(kept);
+    }
+
+
+private:
+    std::size_t cell_of(Particle<dimension> const& particle) const
+    {
+        auto const nbr_cells = m_grid->nbr_cells(Direction::X);
+        auto const cell      = particle.position[0] / m_grid->cell_size(Direction::X);
+        return cell <= 0. ? 0 : std::min(static_cast<std::size_t>(cell), nbr_cells - 1);
+    }
+
+    // counting sort of the particle indexes by cell, each cell keeps the order of the array
+    void sort_by_cell(Particles const& particles)
+    {
+        auto const nbr_cells = m_grid->nbr_cells(Direction::X);
+        m_cell_start.assign(nbr_cells + 1, 0);
+        for (auto const& particle : particles)
+            ++m_cell_start[cell_of(particle) + 1];
+        for (std::size_t iCell = 0; iCell < nbr_cells; ++iCell)
+            m_cell_start[iCell + 1] += m_cell_start[iCell];
+
+        m_order.resize(particles.size());
+        auto next = m_cell_start;
+        for (std::size_t iPart = 0; iPart < particles.size(); ++iPart)
+            m_order[next[cell_of(particles[iPart])]++] = iPart;
+    }
+
+
+    // removes reduction particles from the cell in m_cell. Each bin gives a share of the
+    // reduction proportional to what it can give, so that no part of the distribution is
+    // merged first; bins are made coarser only when every bin is down to two particles.
+    void merge(Particles& particles, std::size_t reduction)
+    {
+        for (auto bins = m_nbr_velocity_bins; reduction > 0 and bins > 0; --bins)
+        {
+            std::erase_if(m_cell, [this](std::size_t iPart) { return m_removed[iPart]; });
+            bin_velocities(particles, bins);
+
+            m_bins.clear();
+            std::size_t reducible = 0;
+            for (std::size_t first = 0; first < m_keyed.size();)
+            {
+                auto last = first;
+                while (last < m_keyed.size() and m_keyed[last].first == m_keyed[first].first)
+                    ++last;
+                auto const size = last - first;
+                m_bins.push_back({first, size > 2 ? size - 2 : 0, 0});
+                reducible += m_bins.back().reducible;
+                first = last;
+            }
+            if (reducible == 0)
+                continue;
+
+            auto const wanted = std::min(reduction, reducible);
+            auto left         = wanted;
+            for (auto& bin : m_bins)
+            {
+                bin.share = bin.reducible * wanted / reducible;
+                left -= bin.share;
+            }
+            for (auto& bin : m_bins) // what the rounding down left over
+            {
+                auto const extra = std::min(left, bin.reducible - bin.share);
+                bin.share += extra;
+                left -= extra;
+            }
+
+            for (auto const& bin : m_bins)
+            {
+                if (bin.share == 0)
+                    continue;
+                merge_group(particles, bin.first, bin.first + bin.share + 2);
+                reduction -= bin.share;
+            }
+        }
+    }
+
+    // sorts the particles of m_cell into m_keyed by velocity bin. Bins are cubes, the same
+    // width in every direction, so that a cold direction is not cut in as many bins as a
+    // hot one.
+    void bin_velocities(Particles const& particles, std::size_t bins)
+    {
+        std::array<double, 3> vmin;
+        double width = 0.;
+        for (std::size_t iComp = 0; iComp < 3; ++iComp)
+        {
+            auto const [low, high] = std::minmax_element(
+                m_cell.begin(), m_cell.end(), [&](std::size_t a, std::size_t b) {
+                    return particles[a].v[iComp] < particles[b].v[iComp];
+                });
+            vmin[iComp] = particles[*low].v[iComp];
+            width       = std::max(width, (particles[*high].v[iComp] - vmin[iComp]) / bins);
+        }
+
+        m_keyed.clear();
+        for (auto const iPart : m_cell)
+        {
+            std::size_t key = 0;
+            for (std::size_t iComp = 0; iComp < 3; ++iComp)
+            {
+                auto const offset = particles[iPart].v[iComp] - vmin[iComp];
+                std::size_t bin   = 0;
+                if (width > 0.)
+                    bin = std::min(static_cast<std::size_t>(offset / width), bins - 1);
+                key = key * bins + bin;
+            }
+            m_keyed.emplace_back(key, iPart);
+        }
+        std::sort(m_keyed.begin(), m_keyed.end());
+    }
+
+    // turns the particles m_keyed[first, last) into two, in the slots of the first two
+    void merge_group(Particles& particles, std::size_t first, std::size_t last)
+    {
+        double weight = 0., position = 0.;
+        std::array<double, 3> mean{0., 0., 0.};
+        for (auto iKey = first; iKey < last; ++iKey)
+        {
+            auto const& particle = particles[m_keyed[iKey].second];
+            weight += particle.weight;
+            position += particle.weight * particle.position[0];
+            for (std::size_t iComp = 0; iComp < 3; ++iComp)
+                mean[iComp] += particle.weight * particle.v[iComp];
+        }
+        position /= weight;
+        for (auto& component : mean)
+            component /= weight;
+
+        // spread around the mean, taken along the particle that deviates the most
+        double variance = 0., largest = 0.;
+        std::array<double, 3> direction{0., 0., 0.};
+        for (auto iKey = first; iKey < last; ++iKey)
+        {
+            auto const& particle = particles[m_keyed[iKey].second];
+            std::array<double, 3> deviation;
+            double norm2 = 0.;
+            for (std::size_t iComp = 0; iComp < 3; ++iComp)
+            {
+                deviation[iComp] = particle.v[iComp] - mean[iComp];
+                norm2 += deviation[iComp] * deviation[iComp];
+            }
+            variance += particle.weight * norm2;
+            if (norm2 > largest)
+            {
+                largest   = norm2;
+                direction = deviation;
+            }
+        }
+        auto const spread = std::sqrt(variance / weight);
+        auto const scale  = largest > 0. ? spread / std::sqrt(largest) : 0.;
+
+        // indexes are sorted within a bin, the first two slots keep the smallest ids
+        for (auto iKey = first; iKey < last; ++iKey)
+        {
+            auto const iPart = m_keyed[iKey].second;
+            if (iKey - first >= 2)
+            {
+                m_removed[iPart] = true;
+                continue;
+            }
+            auto& particle       = particles[iPart];
+            auto const sign      = iKey == first ? 1. : -1.;
+            particle.position[0] = position;
+            particle.weight      = 0.5 * weight;
+            for (std::size_t iComp = 0; iComp < 3; ++iComp)
+                particle.v[iComp] = mean[iComp] + sign * scale * direction[iComp];
+        }
+    }
+
+
+    // adds addition particles to the cell in m_cell by halving its heaviest ones
+    template<typename Population>
+    void split(Population& population, std::size_t iCell, std::size_t addition)
+    {
+        auto& particles  = population.particles();
+        auto const dx    = m_grid->cell_size(Direction::X);
+        auto const left  = iCell * dx;
+        auto const right = left + dx;
+
+        auto const lighter = [&](std::size_t a, std::size_t b) {
+            return particles[a].weight < particles[b].weight;
+        };
+        std::make_heap(m_cell.begin(), m_cell.end(), lighter);
+
+        for (; addition > 0; --addition)
+        {
+            std::pop_heap(m_cell.begin(), m_cell.end(), lighter);
+            auto const iPart = m_cell.back();
+
+            auto const x     = particles[iPart].position[0];
+            auto const shift = 0.5 * std::max(std::min(x - left, right - x), 0.);
+            particles[iPart].weight *= 0.5;
+
+            auto half        = particles[iPart];
+            half.position[0] = x + shift;
+            half.id          = population.new_particle_id();
+            particles[iPart].position[0] = x - shift;
+            particles.push_back(half);
+
+            std::push_heap(m_cell.begin(), m_cell.end(), lighter);
+            m_cell.push_back(particles.size() - 1);
+            std::push_heap(m_cell.begin(), m_cell.end(), lighter);
+        }
+    }
+
+
+    // a velocity bin starting at m_keyed[first], share of its particles are merged away
+    struct Bin
+    {
+        std::size_t first;
+        std::size_t reducible; // its size minus the two particles a merge leaves
+        std::size_t share;
+    };
+
+    std::shared_ptr<GridLayout<dimension>> m_grid;
+    std::size_t m_min_ppc;
+    std::size_t m_max_ppc;
+    std::size_t m_nbr_velocity_bins; // per velocity component, at the first merging attempt
+
+    // buffers reused from one call to the next
+    std::vector<std::size_t> m_cell_start; // m_order[m_cell_start[i], m_cell_start[i + 1])
+    std::vector<std::size_t> m_order;      // particle indexes sorted by cell
+    std::vector<std::size_t> m_cell;       // particle indexes of the cell being resampled
+    std::vector<std::pair<std::size_t, std::size_t>> m_keyed; // (velocity bin, index)
+    std::vector<Bin> m_bins;
+    std::vector<bool> m_removed;
+};
+
+
+#endif // HYBIRT_RESAMPLING_HPP
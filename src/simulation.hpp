@@ -0,0 +1,664 @@
+#ifndef HYBIRT_SIMULATION_HPP
+#define HYBIRT_SIMULATION_HPP
+
+#include "vecfield.hpp"
+#include "field.hpp"
+
+#include "faraday.hpp"
+#include "ampere.hpp"
+#include "ohm.hpp"
+#include "utils.hpp"
+#include "gridlayout.hpp"
+#include "boundary_condition.hpp"
+#include "moments.hpp"
+#include "pusher.hpp"
+#include "diagnostics.hpp"
+#include "memory_accounting.hpp"
+#include "filter.hpp"
+#include "resampling.hpp"
+#include "moving_window.hpp"
+#include "time_step.hpp"
+#include "reduced_diagnostics.hpp"
+#include "spectral_diagnostics.hpp"
+#include "population.hpp"
+#include "profiles.hpp"
+#include "timers.hpp"
+
+#include "highfive/highfive.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+struct PopulationParameters
+{
+    std::string name             = "main";
+    std::size_t nppc             = 100;
+    Profile density              = make_profile("1.");
+    std::array<double, 3> V      = {0.0, 0.0, 0.0}; // bulk velocity
+    std::array<double, 3> Vth    = {0.2, 0.2, 0.2}; // thermal velocity
+    double mass                  = 1.0;
+    double charge                = 1.0;
+    std::size_t track_one_out_of = 100;    // 0 tracks no particle
+    std::string inflow           = "none"; // none, left, right or both, for open boundaries
+    bool delta_f                 = false;  // density - background_density is then a perturbation
+    double background_density    = 1.0;    // of the delta f Maxwellian background
+};
+
+
+// velocity histogram written for every population in the reduced diagnostics, one entry
+// per histogram dimension, see VelocityHistogram
+struct HistogramParameters
+{
+    std::string name;
+    std::vector<std::size_t> components; // 0, 1, 2 for vx, vy, vz
+    std::vector<std::size_t> bins;
+    std::vector<double> vmin;
+    std::vector<double> vmax;
+    std::optional<std::array<double, 2>> window; // x range, absent for the whole domain
+};
+
+
+// cadences are in number of steps, 0 disables the diagnostics
+struct DiagnosticsParameters
+{
+    std::size_t fields_every    = 1;
+    std::size_t particles_every = 0;
+    std::size_t tracked_every   = 1;
+    std::size_t reduced_every   = 1;
+    std::size_t spectral_every  = 1;
+
+    std::vector<HistogramParameters> histograms{
+        {"fvx", {0}, {100}, {-1.}, {1.}, std::nullopt},
+        {"fvxvy", {0, 1}, {50, 50}, {-1., -1.}, {1., 1.}, std::nullopt}};
+};
+
+
+// binomial smoothing of the moments after the deposit and of the current after Ampere
+struct FilterParameters
+{
+    std::size_t passes = 0; // 0 disables the filter
+    bool compensate    = false;
+};
+
+
+// merging and splitting of particles that keeps every cell within [min_ppc, max_ppc]
+struct ResamplingParameters
+{
+    std::size_t every         = 0; // steps between two passes, 0 disables the resampling
+    std::size_t min_ppc       = 50;
+    std::size_t max_ppc       = 200;
+    std::size_t velocity_bins = 8; // per direction, in the velocity grid of the merging
+};
+
+
+// frame following a structure at velocity, with boundary = open, 0 keeps the frame fixed
+struct WindowParameters
+{
+    double velocity = 0.;
+};
+
+
+// time step adapted every step to the particle and whistler limits, see time_step.hpp,
+// dt of the run is the first one. Diagnostics are stamped with the time they are written at
+// and steps are shortened to land on the spectral samples and on final_time.
+struct TimeStepParameters
+{
+    bool adaptive     = false;
+    double cfl        = 0.5; // fraction of the stability limit
+    double min_dt     = 0.;  // 0 is dt / 1000
+    double max_dt     = 0.;  // 0 is 10 dt
+    double hysteresis = 1.5; // dt grows once the limit exceeds it by this factor
+    double max_growth = 1.2; // per step
+};
+
+
+// everything that defines a run
+struct SimulationParameters
+{
+    std::size_t dimension  = 1;
+    std::size_t nbr_cells  = 100;
+    double cell_size       = 0.2;
+    std::size_t nbr_ghosts = Shape<interp_order>::nbr_ghosts; // what the particle shape needs
+    double dt              = 0.001;
+    double final_time      = 10.;
+    std::string pusher     = "boris";
+    std::string boundary   = "periodic";
+
+    // all populations deposit into the total moments, see accumulate_moments: no per
+    // population moments, which no diagnostic reads yet
+    bool single_pass_moments = false;
+
+    Profile bx = make_profile("0.");
+    Profile by = make_profile("1.");
+    Profile bz = make_profile("0.");
+
+    std::vector<PopulationParameters> populations{PopulationParameters{}};
+    FilterParameters filter;
+    ResamplingParameters resampling;
+    WindowParameters window;
+    TimeStepParameters time_step;
+    DiagnosticsParameters diagnostics;
+
+    // diagnostics file names are prefixed with this, e.g. "run_003/" or "run_003_"
+    std::string diag_prefix;
+    bool verbose = true;
+};
+
+
+// k-omega analysis of every run, see SpectralDiagnostics: the transverse magnetic field,
+// with the samples of a window
+inline constexpr std::size_t spectral_window = 1024;
+
+inline std::vector<Quantity> spectral_quantities()
+{
+    return {Quantity::By, Quantity::Bz};
+}
+
+inline std::size_t spectral_modes(SimulationParameters const& params)
+{
+    return std::min<std::size_t>(16, params.nbr_cells / 2 + 1);
+}
+
+
+
+
+template<std::size_t dimension>
+void average(Field<dimension> const& F1, Field<dimension> const& F2, Field<dimension>& Favg)
+{
+    // use std::transform to do an average of F1 and F2
+}
+
+
+template<std::size_t dimension>
+void average(VecField<dimension> const& V1, VecField<dimension> const& V2,
+             VecField<dimension>& Vavg)
+{
+    average(V1.x, V2.x, Vavg.x);
+    average(V1.y, V2.y, Vavg.y);
+    average(V1.z, V2.z, Vavg.z);
+}
+
+
+inline void magnetic_init(VecField<1>& B, GridLayout<1> const& layout,
+                          SimulationParameters const& params)
+{
+    // Initialize magnetic field B
+    for (auto ix = layout.primal_dom_start(Direction::X); ix <= layout.primal_dom_end(Direction::X);
+         ++ix)
+    {
+        auto x = layout.coordinate(Direction::X, Quantity::Bx, ix);
+
+        B.x(ix) = params.bx(x); // Bx
+    }
+    for (auto ix = layout.dual_dom_start(Direction::X); ix <= layout.dual_dom_end(Direction::X);
+         ++ix)
+    {
+        auto x = layout.coordinate(Direction::X, Quantity::By, ix);
+
+        B.y(ix) = params.by(x); // By
+        B.z(ix) = params.bz(x); // Bz
+    }
+}
+
+
+
+
+// owns the fields, populations, kernels and diagnostics of a run and advances them in time.
+// The pusher and the boundary condition are template parameters so that their calls in the
+// loop are resolved at compile time and can be inlined, run() below picks the instantiation
+// from the parameters. It counts its own memory, what it allocates while constructing and
+// running, see memory().
+template<std::size_t dimension, typename PusherT, typename BoundaryT>
+class Simulation
+{
+    static_assert(dimension == 1, "Simulation only implemented for 1D");
+
+public:
+    explicit Simulation(SimulationParameters const& params)
+        : m_construction_memory{m_memory}
+        , m_params{params}
+        , m_layout{std::make_shared<GridLayout<dimension>>(
+              std::array<std::size_t, dimension>{params.nbr_cells},
+              std::array<double, dimension>{params.cell_size}, params.nbr_ghosts)}
+        , m_dt{params.dt}
+        , m_E{m_layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}}
+        , m_B{m_layout, {Quantity::Bx, Quantity::By, Quantity::Bz}}
+        , m_Enew{m_layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}}
+        , m_Bnew{m_layout, {Quantity::Bx, Quantity::By, Quantity::Bz}}
+        , m_Eavg{m_layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}}
+        , m_Bavg{m_layout, {Quantity::Bx, Quantity::By, Quantity::Bz}}
+        , m_J{m_layout, {Quantity::Jx, Quantity::Jy, Quantity::Jz}}
+        , m_V{m_layout, {Quantity::Vx, Quantity::Vy, Quantity::Vz}}
+        , m_N{m_layout->allocate(Quantity::N), Quantity::N}
+        , m_boundary{m_layout}
+        // , m_faraday{m_layout, params.dt}  // TODO uncomment when Faraday is implemented
+        , m_ampere{m_layout}
+        , m_ohm{m_layout}
+        , m_push{m_layout, params.dt}
+        , m_filter{m_layout, params.filter.passes, params.filter.compensate}
+        , m_resample{m_layout, params.resampling.min_ppc, params.resampling.max_ppc,
+                     params.resampling.velocity_bins}
+        , m_window{m_layout, params.window.velocity}
+        , m_time_step{m_layout,
+                      params.dt,
+                      params.time_step.cfl,
+                      params.time_step.min_dt > 0. ? params.time_step.min_dt : params.dt / 1000,
+                      params.time_step.max_dt > 0. ? params.time_step.max_dt : 10 * params.dt,
+                      params.time_step.hysteresis,
+                      params.time_step.max_growth}
+        , m_reduced{m_layout, population_names(params), params.diag_prefix}
+        , m_spectral{m_layout,
+                     spectral_quantities(),
+                     spectral_modes(params),
+                     spectral_window,
+                     params.dt * std::max<std::size_t>(params.diagnostics.spectral_every, 1),
+                     params.diag_prefix}
+        , m_tracked{params.diag_prefix}
+    {
+        if (m_window.moving() and !std::is_same_v<BoundaryT, OpenBoundaryCondition<dimension>>)
+            throw std::runtime_error("a moving window needs open boundaries");
+
+        for (auto const& pop_params : params.populations)
+        {
+            auto& pop = m_populations.emplace_back(pop_params.name, m_layout);
+            if (pop_params.delta_f)
+                load_delta_f(pop, pop_params);
+            else
+                pop.load_particles(pop_params.nppc, pop_params.density, pop_params.V,
+                                   pop_params.Vth, pop_params.mass, pop_params.charge);
+            if (auto const stride = pop_params.track_one_out_of; stride > 0)
+                pop.track([stride](auto const& particle) { return particle.id % stride == 0; });
+
+            if constexpr (std::is_same_v<BoundaryT, OpenBoundaryCondition<dimension>>)
+                add_inflows(pop_params);
+            if (m_window.moving())
+                add_window_plasma(pop_params);
+
+            for (auto const& histogram : params.diagnostics.histograms)
+                m_reduced.add_histogram(pop_params.name,
+                                        VelocityHistogram{histogram.name, histogram.components,
+                                                          histogram.bins, histogram.vmin,
+                                                          histogram.vmax, histogram.window});
+        }
+
+        magnetic_init(m_B, *m_layout, params);
+        m_boundary.fill(m_B);
+
+        m_ampere(m_B, m_J);
+        m_boundary.fill(m_J);
+        m_filter(m_J, m_boundary);
+        moments();
+        m_ohm(m_B, m_J, m_N, m_V, m_E);
+        m_boundary.fill(m_E);
+
+        if (params.verbose)
+        {
+            print_memory_placement();
+            m_memory.print();
+        }
+        m_construction_memory.release();
+    }
+
+
+    void run()
+    {
+        MemoryAccounting::Use const use{m_memory};
+        write_diagnostics();
+
+        while (m_time < m_params.final_time)
+        {
+            if (m_params.verbose)
+                std::cout << "Time: " << m_time << " / " << m_params.final_time
+                          << (m_params.time_step.adaptive ? " dt: " + std::to_string(m_dt) : "")
+                          << "\n";
+
+            advance();
+            if (auto const every = m_params.resampling.every; every > 0 and m_step % every == 0)
+                for (auto& pop : m_populations)
+                    m_resample(pop);
+            if (m_window.moving())
+                move_window();
+
+            write_diagnostics();
+            if (m_params.verbose)
+                std::cout << "**********************************\n";
+        }
+        if (m_params.diagnostics.spectral_every > 0)
+            m_spectral.write();
+        if (m_params.verbose)
+            m_memory.print();
+    }
+
+
+    // one step of the ICN temporal integration
+    void advance()
+    {
+        MemoryAccounting::Use const use{m_memory};
+        auto const adaptive = m_params.time_step.adaptive;
+        auto const stop     = next_stop();
+        m_dt                = adaptive ? std::min(m_time_step.dt(), stop - m_time) : m_params.dt;
+        m_push.set_dt(m_dt);
+        m_push.reset_max_speed();
+        if constexpr (std::is_same_v<BoundaryT, OpenBoundaryCondition<dimension>>)
+            m_boundary.set_dt(m_dt);
+
+        // TODO implement ICN temporal integration over m_dt
+        // delta f populations evolve their weights with evolve_weights() along the push and
+        // complete their moments with add_background() once the deposit ghosts are filled
+
+
+        // a step that reaches the stop lands on it exactly, with no rounding left over
+        m_time = adaptive and m_time + m_dt >= stop ? stop : m_time + m_dt;
+        ++m_step;
+        if (adaptive)
+        {
+            warn_if_unpushed();
+            m_time_step.update(m_push.max_speed(), m_B, m_N);
+        }
+    }
+
+    double time() const { return m_time; }
+    double dt() const { return m_dt; }
+    double window_offset() const { return m_window.offset(); }
+    auto const& populations() const { return m_populations; }
+    MemoryAccounting const& memory() const { return m_memory; }
+
+
+private:
+    // a step that pushes no particle has no particle limit, only the whistler one bounds dt
+    void warn_if_unpushed()
+    {
+        if (m_push.nbr_pushed() > 0 or m_warned_unpushed)
+            return;
+        m_warned_unpushed = true;
+        std::cout << "WARNING: no particle was pushed in step " << m_step
+                  << ", the particle limit of the adaptive time step is inactive and only the "
+                     "whistler limit bounds dt\n";
+    }
+
+    // time the next step must not overshoot: the next spectral sample or the end of the run
+    double next_stop() const
+    {
+        if (m_params.diagnostics.spectral_every > 0 and m_next_sample > m_time)
+            return std::min(m_next_sample, m_params.final_time);
+        return m_params.final_time;
+    }
+
+    // N and V from the particles, through the moments of each population or in a single pass
+    void moments()
+    {
+        if (m_params.single_pass_moments)
+        {
+            accumulate_moments(m_populations, m_N, m_V);
+            m_boundary.fill_all(m_V, m_N);
+            for (auto const& pop : m_populations)
+                pop.add_background(m_N, m_V);
+            m_filter(m_V, m_boundary);
+            m_filter(m_N, m_boundary);
+            finalize_moments(m_N, m_V);
+            return;
+        }
+
+        for (auto& pop : m_populations)
+        {
+            pop.deposit();
+            m_boundary.fill_all(pop.flux(), pop.density());
+            pop.add_background();
+            m_filter(pop.flux(), m_boundary);
+            m_filter(pop.density(), m_boundary);
+        }
+        total_density(m_populations, m_N);
+        bulk_velocity<dimension>(m_populations, m_N, m_V);
+    }
+
+    static void load_delta_f(Population<dimension>& pop, PopulationParameters const& pop_params)
+    {
+        if (pop_params.inflow != "none")
+            throw std::runtime_error("inflows would inject full f particles in " + pop_params.name
+                                     + ", a delta f population");
+        auto const background = pop_params.background_density;
+        pop.load_delta_f(
+            pop_params.nppc, Maxwellian{background, pop_params.V, pop_params.Vth},
+            [&](double x) { return pop_params.density(x) - background; }, pop_params.mass,
+            pop_params.charge);
+    }
+
+    void add_inflows(PopulationParameters const& pop_params)
+    {
+        m_boundary.set_dt(m_params.dt);
+
+        auto const add_side = [&](Inflow::Side side, double x) {
+            m_boundary.add_inflow({pop_params.name, side, pop_params.nppc, pop_params.density(x),
+                                   pop_params.V, pop_params.Vth, pop_params.mass,
+                                   pop_params.charge});
+        };
+        auto const& inflow = pop_params.inflow;
+        if (inflow == "left" or inflow == "both")
+            add_side(Inflow::Side::left, 0.);
+        if (inflow == "right" or inflow == "both")
+            add_side(Inflow::Side::right, m_layout->dom_size(Direction::X));
+        if (inflow != "none" and inflow != "left" and inflow != "right" and inflow != "both")
+            throw std::runtime_error("unknown inflow " + inflow + " for " + pop_params.name);
+    }
+
+    void add_window_plasma(PopulationParameters const& pop_params)
+    {
+        if (pop_params.delta_f)
+            throw std::runtime_error("the moving window would inject full f particles in "
+                                     + pop_params.name + ", a delta f population");
+        m_window.add_plasma({pop_params.name, pop_params.nppc, pop_params.density, pop_params.V,
+                             pop_params.Vth, pop_params.mass, pop_params.charge});
+    }
+
+    // shifts the fields and the particles by the whole cells the window moved past, B takes
+    // the initial profiles in the new cells
+    void move_window()
+    {
+        auto const cells = m_window.advance(m_dt);
+        if (cells == 0)
+            return;
+
+        m_window.shift(m_B.x, cells, m_params.bx);
+        m_window.shift(m_B.y, cells, m_params.by);
+        m_window.shift(m_B.z, cells, m_params.bz);
+        for (auto* vecfield : {&m_E, &m_J, &m_V})
+            m_window.shift(*vecfield, cells);
+        m_window.shift(m_N, cells);
+        m_boundary.fill_all(m_B, m_E, m_J);
+        for (auto* moment : {&m_V.x, &m_V.y, &m_V.z, &m_N})
+            m_boundary.refill(*moment); // shifted, already folded
+
+        for (auto& pop : m_populations)
+        {
+            m_window.shift(pop, cells);
+            if (pop.has_moments())
+            {
+                m_window.shift(pop.flux(), cells);
+                m_window.shift(pop.density(), cells);
+            }
+        }
+    }
+
+    // where the first touch and the huge pages put the fields and the particles
+    void print_memory_placement() const
+    {
+        MemoryPlacement fields;
+        for (auto const* vecfield : {&m_E, &m_B, &m_Enew, &m_Bnew, &m_Eavg, &m_Bavg, &m_J, &m_V})
+            for (auto const* field : {&vecfield->x, &vecfield->y, &vecfield->z})
+                fields += memory_placement(*field);
+        fields += memory_placement(m_N);
+        fields.print("fields");
+
+        MemoryPlacement particles;
+        for (auto const& pop : m_populations)
+            particles += memory_placement(pop.particles());
+        particles.print("particles");
+    }
+
+    static std::vector<std::string> population_names(SimulationParameters const& params)
+    {
+        std::vector<std::string> names;
+        for (auto const& pop_params : params.populations)
+            names.push_back(pop_params.name);
+        return names;
+    }
+
+    // first write of each diagnostics truncates its files
+    void write_diagnostics()
+    {
+        auto const& diags  = m_params.diagnostics;
+        auto const& prefix = m_params.diag_prefix;
+        auto const mode    = m_step == 0 ? HighFive::File::Truncate : HighFive::File::ReadWrite;
+        auto const due     = [this](std::size_t every) {
+            return every > 0 and m_step % every == 0;
+        };
+
+        if (due(diags.fields_every))
+            diags_write_fields(m_B, m_E, m_V, m_N, m_time, mode, prefix);
+        if (due(diags.particles_every))
+            diags_write_particles(m_populations, m_time, mode, prefix);
+        if (due(diags.tracked_every))
+            m_tracked.write(m_populations, m_time, mode);
+        // the spectra need evenly spaced samples, in time when dt changes
+        if (m_params.time_step.adaptive and diags.spectral_every > 0 and m_time >= m_next_sample)
+        {
+            m_spectral.sample(m_E, m_B);
+            m_next_sample += m_params.dt * diags.spectral_every;
+        }
+        else if (!m_params.time_step.adaptive and due(diags.spectral_every))
+            m_spectral.sample(m_E, m_B);
+        if (due(diags.reduced_every))
+        {
+            m_reduced.compute(m_populations, m_E, m_B);
+            m_reduced.write(m_time, mode);
+            if (m_reduced.energy_drift() > 0.05)
+                std::cout << prefix << "WARNING: total energy changed by "
+                          << 100 * m_reduced.energy_drift() << "% since t=0\n";
+        }
+    }
+
+
+    // first, so that everything else is counted in it and released before it goes
+    MemoryAccounting m_memory;
+    MemoryAccounting::Use m_construction_memory;
+
+    SimulationParameters m_params;
+    std::shared_ptr<GridLayout<dimension>> m_layout;
+    double m_time        = 0.;
+    double m_dt          = 0.;
+    double m_next_sample = 0.; // time of the next spectral sample with an adaptive dt
+    std::size_t m_step   = 0;
+    bool m_warned_unpushed = false; // see warn_if_unpushed
+
+    VecField<dimension> m_E, m_B, m_Enew, m_Bnew, m_Eavg, m_Bavg, m_J, m_V;
+    Field<dimension> m_N;
+    std::vector<Population<dimension>> m_populations;
+
+    BoundaryT m_boundary;
+    Ampere<dimension> m_ampere;
+    Ohm<dimension> m_ohm;
+    PusherT m_push;
+    BinomialFilter<dimension> m_filter;
+    Resampler<dimension> m_resample;
+    MovingWindow<dimension> m_window;
+    TimeStepController<dimension> m_time_step;
+
+    ReducedDiagnostics<dimension> m_reduced;
+    SpectralDiagnostics<dimension> m_spectral;
+    TrackedDiagnostics m_tracked;
+};
+
+
+
+
+// footprint of a run from its parameters, before anything is allocated, per subsystem as
+// MemoryAccounting counts it: the fields of the Simulation, the moments of the populations
+// and the filter buffer, the particles as loaded, the spectral store and the largest
+// diagnostics staging buffer, and the fields write. Inflows, the moving window and the
+// resampling change the number of particles from there on, the accounting reports the
+// actual peak.
+inline MemoryEstimate memory_estimate(SimulationParameters const& params)
+{
+    if (params.dimension != 1)
+        throw std::runtime_error("no kernels for dimension " + std::to_string(params.dimension));
+
+    GridLayout<1> const layout{{params.nbr_cells}, {params.cell_size}, params.nbr_ghosts};
+    auto const nodes = [&](std::initializer_list<Quantity> quantities) {
+        std::size_t nbr_nodes = 0;
+        for (auto const qty : quantities)
+            nbr_nodes += layout.allocate(qty)[0];
+        return nbr_nodes;
+    };
+    auto const field_bytes = [&](std::initializer_list<Quantity> quantities) {
+        std::size_t bytes = 0;
+        for (auto const qty : quantities)
+            bytes += allocated_bytes(nodes({qty}) * sizeof(double));
+        return bytes;
+    };
+
+    MemoryEstimate estimate;
+    auto const E = field_bytes({Quantity::Ex, Quantity::Ey, Quantity::Ez});
+    auto const B = field_bytes({Quantity::Bx, Quantity::By, Quantity::Bz});
+    auto const J = field_bytes({Quantity::Jx, Quantity::Jy, Quantity::Jz});
+    auto const V = field_bytes({Quantity::Vx, Quantity::Vy, Quantity::Vz});
+    auto const N = field_bytes({Quantity::N});
+    estimate[Subsystem::fields] = 3 * E + 3 * B + J + V + N;
+    if (!params.single_pass_moments)
+        estimate[Subsystem::fields] += params.populations.size() * (V + N);
+    if (params.filter.passes > 0)
+        estimate[Subsystem::fields] += allocated_bytes(
+            std::max({nodes({Quantity::Jx}), nodes({Quantity::Jy}), nodes({Quantity::Vx}),
+                      nodes({Quantity::N})})
+            * sizeof(double));
+
+    std::size_t staging = 0;
+    for (auto const& pop : params.populations)
+    {
+        auto const nbr_particles = params.nbr_cells * pop.nppc;
+        estimate[Subsystem::particles]
+            += allocated_bytes(nbr_particles * sizeof(Particle<1>));
+        if (params.diagnostics.particles_every > 0)
+            staging = std::max(staging, 4 * nbr_particles * sizeof(double));
+        if (auto const stride = pop.track_one_out_of; stride > 0)
+            staging = std::max(staging, 4 * (nbr_particles / stride + 1) * sizeof(double));
+    }
+    estimate.resident_diagnostics = SpectralDiagnostics<1>::store_bytes(
+        spectral_quantities().size(), spectral_modes(params), spectral_window);
+    estimate[Subsystem::diagnostics] = estimate.resident_diagnostics + staging;
+    if (params.diagnostics.fields_every > 0)
+        estimate[Subsystem::io]
+            = nodes({Quantity::Bx, Quantity::By, Quantity::Bz, Quantity::Ex, Quantity::Ey,
+                     Quantity::Ez, Quantity::Vx, Quantity::Vy, Quantity::Vz, Quantity::N})
+              * sizeof(double);
+    return estimate;
+}
+
+
+// thin runtime dispatch over the instantiations compiled in, add a line here for each new
+// (dimension, pusher, boundary) combination
+inline void run(SimulationParameters const& params)
+{
+    if (params.dimension != 1)
+        throw std::runtime_error("no kernels for dimension " + std::to_string(params.dimension));
+
+    if (params.pusher == "boris" and params.boundary == "periodic")
+        Simulation<1, Boris<1>, PeriodicBoundaryCondition<1>>{params}.run();
+    else if (params.pusher == "boris" and params.boundary == "open")
+        Simulation<1, Boris<1>, OpenBoundaryCondition<1>>{params}.run();
+    else
+        throw std::runtime_error("no simulation with pusher " + params.pusher + " and boundary "
+                                 + params.boundary);
+}
+
+
+#endif // HYBIRT_SIMULATION_HPP
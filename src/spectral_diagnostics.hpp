@@ -0,0 +1,270 @@
+#ifndef HYBIRT_SPECTRAL_DIAGNOSTICS_HPP
+#define HYBIRT_SPECTRAL_DIAGNOSTICS_HPP
+
+#include "field.hpp"
+#include "vecfield.hpp"
+#include "gridlayout.hpp"
+#include "fft.hpp"
+#include "allocator.hpp"
+#include "memory_accounting.hpp"
+#include "diagnostics.hpp"
+#include "timers.hpp"
+
+#include "highfive/highfive.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+inline std::string quantity_name(Quantity qty)
+{
+    switch (qty)
+    {
+        case Quantity::Ex: return "Ex";
+        case Quantity::Ey: return "Ey";
+        case Quantity::Ez: return "Ez";
+        case Quantity::Bx: return "Bx";
+        case Quantity::By: return "By";
+        case Quantity::Bz: return "Bz";
+        case Quantity::Jx: return "Jx";
+        case Quantity::Jy: return "Jy";
+        case Quantity::Jz: return "Jz";
+        case Quantity::Vx: return "Vx";
+        case Quantity::Vy: return "Vy";
+        case Quantity::Vz: return "Vz";
+        case Quantity::N: return "N";
+        default: throw std::runtime_error{"quantity has no name"};
+    }
+}
+
+
+
+
+// in-situ k-omega analysis of selected field components along x
+//
+// each sample() takes the spatial FFT of the domain nodes and keeps the first nbr_modes
+// complex amplitudes. Every `window` samples, a Hann-windowed FFT in time of each mode is
+// accumulated into a k-omega power spectrum; windows overlap by half (Welch averaging).
+// Amplitudes are kept in a ring buffer of one window, so memory does not grow with the run;
+// it and the spectra are counted as diagnostics for the life of the object, see store_bytes().
+// write() stores the power spectra and the amplitudes of the last window in spectra.h5
+template<std::size_t dimension>
+class SpectralDiagnostics
+{
+    template<typename T>
+    using Buffer = std::vector<T, FirstTouchAllocator<T, Subsystem::diagnostics>>;
+
+public:
+    SpectralDiagnostics(std::shared_ptr<GridLayout<dimension>> grid,
+                        std::vector<Quantity> quantities, std::size_t nbr_modes,
+                        std::size_t window, double sampling_dt, std::string prefix = "")
+        : m_grid{grid}
+        , m_quantities{quantities}
+        , m_nbr_modes{nbr_modes}
+        , m_window{window}
+        , m_sampling_dt{sampling_dt}
+        , m_prefix{prefix}
+        , m_amplitudes(quantities.size())
+        , m_power(quantities.size())
+    {
+        static_assert(dimension == 1, "SpectralDiagnostics only implemented for 1D");
+        if (!m_grid)
+            throw std::runtime_error("GridLayout is null");
+        if (m_nbr_modes == 0 or m_nbr_modes > m_grid->nbr_cells(Direction::X) / 2 + 1)
+            throw std::runtime_error("SpectralDiagnostics: invalid number of modes");
+        if (m_window < 2)
+            throw std::runtime_error("SpectralDiagnostics: window must have at least 2 samples");
+
+        for (auto iQty = 0u; iQty < m_quantities.size(); ++iQty)
+        {
+            m_amplitudes[iQty].resize(m_window * m_nbr_modes);
+            m_power[iQty].resize(m_window * m_nbr_modes, 0.0);
+        }
+    }
+
+
+    void sample(VecField<dimension> const& E, VecField<dimension> const& B)
+    {
+        HYBIRT_TIME_SCOPE("diagnostics");
+        auto const nbr_cells = m_grid->nbr_cells(Direction::X);
+        std::vector<std::complex<double>> line(nbr_cells);
+
+        for (auto iQty = 0u; iQty < m_quantities.size(); ++iQty)
+        {
+            auto const& field = select(E, B, m_quantities[iQty]);
+            auto const start  = m_grid->dom_start(field.quantity(), Direction::X);
+
+            // the last primal node is the periodic image of the first one
+            for (auto ix = 0u; ix < nbr_cells; ++ix)
+                line[ix] = field(start + ix);
+            fft(line);
+
+            for (auto iMode = 0u; iMode < m_nbr_modes; ++iMode)
+                amplitude(iQty, m_nbr_samples, iMode)
+                    = line[iMode] / static_cast<double>(nbr_cells);
+        }
+
+        ++m_nbr_samples;
+        if (m_nbr_samples >= m_window and (m_nbr_samples - m_window) % (m_window / 2) == 0)
+            accumulate_window();
+    }
+
+
+    void write(HighFive::File::AccessMode mode = HighFive::File::Truncate) const
+    {
+        std::lock_guard lock{hdf5_mutex()};
+        std::string filename = m_prefix + "spectra.h5";
+        HighFive::File file(filename, mode);
+
+        auto const dx    = m_grid->cell_size(Direction::X);
+        auto const L     = m_grid->nbr_cells(Direction::X) * dx;
+        auto const twopi = 2 * std::numbers::pi;
+
+        std::vector<double> k(m_nbr_modes), omega(m_window);
+        for (auto iMode = 0u; iMode < m_nbr_modes; ++iMode)
+            k[iMode] = twopi * iMode / L;
+        for (auto iOmega = 0u; iOmega < m_window; ++iOmega)
+        {
+            auto const shifted = static_cast<double>(iOmega) - static_cast<double>(m_window / 2);
+            omega[iOmega]      = twopi * shifted / (m_window * m_sampling_dt);
+        }
+        file.createDataSet("/k", k);
+        file.createDataSet("/omega", omega);
+        file.createDataSet("/nbr_windows", m_nbr_windows);
+        file.createDataSet("/sampling_dt", m_sampling_dt);
+
+        // the amplitudes of the last window, from sample first_sample on
+        auto const nbr_kept = std::min(m_nbr_samples, m_window);
+        auto const first    = m_nbr_samples - nbr_kept;
+        file.createDataSet("/first_sample", first);
+
+        for (auto iQty = 0u; iQty < m_quantities.size(); ++iQty)
+        {
+            auto const path = "/" + quantity_name(m_quantities[iQty]);
+
+            std::vector<std::vector<double>> power(m_window, std::vector<double>(m_nbr_modes));
+            for (auto iOmega = 0u; iOmega < m_window; ++iOmega)
+                for (auto iMode = 0u; iMode < m_nbr_modes; ++iMode)
+                    power[iOmega][iMode] = this->power(iQty, iOmega, iMode);
+            file.createDataSet(path + "/power", power);
+
+            std::vector<std::vector<double>> re(nbr_kept, std::vector<double>(m_nbr_modes));
+            std::vector<std::vector<double>> im(nbr_kept, std::vector<double>(m_nbr_modes));
+            for (auto iSample = 0u; iSample < nbr_kept; ++iSample)
+                for (auto iMode = 0u; iMode < m_nbr_modes; ++iMode)
+                {
+                    auto const& a      = amplitude(iQty, first + iSample, iMode);
+                    re[iSample][iMode] = a.real();
+                    im[iSample][iMode] = a.imag();
+                }
+            file.createDataSet(path + "/modes_real", re);
+            file.createDataSet(path + "/modes_imag", im);
+        }
+    }
+
+
+    // bytes of the amplitudes and spectra held for the quantities
+    static std::size_t store_bytes(std::size_t nbr_quantities, std::size_t nbr_modes,
+                                   std::size_t window)
+    {
+        auto const values = window * nbr_modes;
+        return nbr_quantities
+               * (allocated_bytes(values * sizeof(std::complex<double>))
+                  + allocated_bytes(values * sizeof(double)));
+    }
+
+    auto nbr_windows() const { return m_nbr_windows; }
+
+    // power of mode iMode at frequency bin iOmega (omega ascending), averaged over windows
+    double power(std::size_t iQty, std::size_t iOmega, std::size_t iMode) const
+    {
+        return m_nbr_windows > 0 ? m_power[iQty][iOmega * m_nbr_modes + iMode] / m_nbr_windows
+                                 : 0.0;
+    }
+
+
+private:
+    static Field<dimension> const& select(VecField<dimension> const& E,
+                                          VecField<dimension> const& B, Quantity qty)
+    {
+        switch (qty)
+        {
+            case Quantity::Ex: return E.x;
+            case Quantity::Ey: return E.y;
+            case Quantity::Ez: return E.z;
+            case Quantity::Bx: return B.x;
+            case Quantity::By: return B.y;
+            case Quantity::Bz: return B.z;
+            default: throw std::runtime_error{"SpectralDiagnostics: only E and B components"};
+        }
+    }
+
+    // Hann-windowed FFT in time over the last m_window samples of each mode
+    void accumulate_window()
+    {
+        auto const first = m_nbr_samples - m_window;
+        std::vector<std::complex<double>> series(m_window);
+
+        double hann_norm = 0.0;
+        for (auto it = 0u; it < m_window; ++it)
+            hann_norm += std::pow(hann(it), 2);
+
+        for (auto iQty = 0u; iQty < m_quantities.size(); ++iQty)
+        {
+            for (auto iMode = 0u; iMode < m_nbr_modes; ++iMode)
+            {
+                for (auto it = 0u; it < m_window; ++it)
+                    series[it] = hann(it) * amplitude(iQty, first + it, iMode);
+
+                // exp(-i omega t) convention: a mode exp(i(kx - omega t)) peaks at +omega
+                fft(series, true);
+
+                for (auto it = 0u; it < m_window; ++it)
+                {
+                    auto const iOmega = (it + m_window / 2) % m_window;
+                    m_power[iQty][iOmega * m_nbr_modes + iMode]
+                        += std::norm(series[it]) / hann_norm;
+                }
+            }
+        }
+        ++m_nbr_windows;
+    }
+
+    // amplitude of a mode at a sample, which the ring buffer keeps for a window
+    std::complex<double>& amplitude(std::size_t iQty, std::size_t iSample, std::size_t iMode)
+    {
+        return m_amplitudes[iQty][(iSample % m_window) * m_nbr_modes + iMode];
+    }
+    std::complex<double> const& amplitude(std::size_t iQty, std::size_t iSample,
+                                          std::size_t iMode) const
+    {
+        return m_amplitudes[iQty][(iSample % m_window) * m_nbr_modes + iMode];
+    }
+
+    double hann(std::size_t it) const
+    {
+        return 0.5 * (1.0 - std::cos(2 * std::numbers::pi * it / (m_window - 1)));
+    }
+
+    std::shared_ptr<GridLayout<dimension>> m_grid;
+    std::vector<Quantity> m_quantities;
+    std::size_t m_nbr_modes;
+    std::size_t m_window;
+    double m_sampling_dt;
+    std::string m_prefix;
+    std::size_t m_nbr_samples = 0;
+    std::size_t m_nbr_windows = 0;
+    std::vector<Buffer<std::complex<double>>> m_amplitudes; // [qty][slot * modes + mode]
+    std::vector<Buffer<double>> m_power;                     // [qty][omega * modes + mode]
+};
+
+
+#endif // HYBIRT_SPECTRAL_DIAGNOSTICS_HPP
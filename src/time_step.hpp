@@ -0,0 +1,131 @@
+#ifndef HYBIRT_TIME_STEP_HPP
+#define HYBIRT_TIME_STEP_HPP
+
+#include "field.hpp"
+#include "vecfield.hpp"
+#include "gridlayout.hpp"
+#include "timers.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+
+
+// adaptive time step: dt is kept at a fraction, cfl, of the smallest of two stability limits
+//
+//    particles  dx / max |vx|             no particle crosses more than a cell per step
+//    whistler   dx^2 min N / (pi max |B|)  the fastest grid whistler, w = k^2 B / N at
+//                                          k = pi / dx, is resolved
+//
+// max |vx| comes from the push, B and N from the end of the step, and the limits are taken
+// over the whole domain so that they hold on every node whatever the centering.
+// dt shrinks as soon as the limit drops below it, and grows by at most max_growth per step
+// and only once the limit exceeds it by the hysteresis factor, so that a noisy limit does not
+// make dt flicker. It stays within [min_dt, max_dt], a limit below min_dt stops the run.
+template<std::size_t dimension>
+class TimeStepController
+{
+public:
+    TimeStepController(std::shared_ptr<GridLayout<dimension>> grid, double dt, double cfl,
+                       double min_dt, double max_dt, double hysteresis = 1.5,
+                       double max_growth = 1.2)
+        : m_grid{grid}
+        , m_dt{dt}
+        , m_cfl{cfl}
+        , m_min_dt{min_dt}
+        , m_max_dt{max_dt}
+        , m_hysteresis{hysteresis}
+        , m_max_growth{max_growth}
+    {
+        if (!m_grid)
+            throw std::runtime_error("GridLayout is null");
+        if (m_cfl <= 0. or m_cfl > 1.)
+            throw std::runtime_error("the time step controller needs 0 < cfl <= 1");
+        if (m_min_dt <= 0. or m_min_dt > m_dt or m_dt > m_max_dt)
+            throw std::runtime_error(
+                "the time step controller needs 0 < min_dt <= dt <= max_dt");
+        if (m_hysteresis < 1. or m_max_growth < 1.)
+            throw std::runtime_error(
+                "the time step controller needs hysteresis >= 1 and max_growth >= 1");
+    }
+
+    double dt() const { return m_dt; }
+
+
+    double particle_limit(double max_speed) const
+    {
+        if (max_speed <= 0.)
+            return std::numeric_limits<double>::infinity();
+        return m_grid->cell_size(Direction::X) / max_speed;
+    }
+
+    double whistler_limit(VecField<dimension> const& B, Field<dimension> const& N) const
+    {
+        static_assert(dimension == 1, "TimeStepController only implemented for 1D");
+        double B2 = 0.;
+        for (auto const* component : {&B.x, &B.y, &B.z})
+        {
+            double max = 0.;
+            for_domain(*component, [&](double b) { max = std::max(max, std::abs(b)); });
+            B2 += max * max;
+        }
+
+        // nodes without plasma carry no whistler
+        auto min_density = std::numeric_limits<double>::infinity();
+        for_domain(N, [&](double n) {
+            if (n > 0.)
+                min_density = std::min(min_density, n);
+        });
+
+        if (B2 == 0. or std::isinf(min_density))
+            return std::numeric_limits<double>::infinity();
+        auto const dx = m_grid->cell_size(Direction::X);
+        return dx * dx * min_density / (std::numbers::pi * std::sqrt(B2));
+    }
+
+
+    // the dt of the next step from the state at the end of this one
+    double update(double max_speed, VecField<dimension> const& B, Field<dimension> const& N)
+    {
+        HYBIRT_TIME_SCOPE("time_step");
+        auto const limit = m_cfl * std::min(particle_limit(max_speed), whistler_limit(B, N));
+        if (limit < m_min_dt)
+            throw std::runtime_error("stable time step " + std::to_string(limit)
+                                     + " below min_dt " + std::to_string(m_min_dt));
+
+        if (limit < m_dt)
+            m_dt = limit;
+        else if (limit > m_hysteresis * m_dt)
+            m_dt = std::min(limit, m_max_growth * m_dt);
+        m_dt = std::min(m_dt, m_max_dt);
+        return m_dt;
+    }
+
+
+private:
+    template<typename Function>
+    void for_domain(Field<dimension> const& field, Function&& function) const
+    {
+        auto const qty = field.quantity();
+        for (auto ix = m_grid->dom_start(qty, Direction::X);
+             ix <= m_grid->dom_end(qty, Direction::X); ++ix)
+            function(field(ix));
+    }
+
+    std::shared_ptr<GridLayout<dimension>> m_grid;
+    double m_dt;
+    double m_cfl;
+    double m_min_dt;
+    double m_max_dt;
+    double m_hysteresis;
+    double m_max_growth;
+};
+
+
+#endif // HYBIRT_TIME_STEP_HPP
@@ -0,0 +1,298 @@
+#ifndef HYBIRT_TIMERS_HPP
+#define HYBIRT_TIMERS_HPP
+
+// per-phase scoped timers
+//
+//    HYBIRT_TIME_SCOPE("push");
+//
+// times the enclosing scope and accumulates it under the given phase name.
+// Timers are compiled in only when HYBIRT_TIMERS is defined (cmake -DHYBIRT_TIMERS=ON),
+// otherwise the macro expands to nothing.
+// Scopes nest: the total of a phase includes the scopes timed inside it (the deposit in the
+// moments, the boundary fill in the filter), its self time does not, so the self times of
+// all the phases add up to the timed time once.
+// When tracing is enabled, each scope is also recorded as an event that
+// write_chrome_trace() exports in the Chrome/Perfetto JSON format, one track per thread.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+class Timers
+{
+public:
+    struct PhaseStats
+    {
+        std::size_t count  = 0;
+        std::int64_t total = 0; // ns
+        std::int64_t self  = 0; // ns, total minus the nested scopes
+        std::int64_t min   = std::numeric_limits<std::int64_t>::max();
+        std::int64_t max   = 0;
+    };
+
+    struct Event
+    {
+        std::size_t phase;
+        std::int64_t start; // ns since the Timers creation
+        std::int64_t duration;
+    };
+
+    // everything a thread records, owned by Timers so that it outlives the thread
+    struct ThreadRecord
+    {
+        std::size_t thread_id;
+        std::vector<PhaseStats> stats; // indexed by phase id
+        std::vector<Event> events;
+    };
+
+
+    static Timers& instance()
+    {
+        static Timers timers;
+        return timers;
+    }
+
+    // returns the id of a phase, registering it on first call
+    std::size_t phase_id(std::string const& name)
+    {
+        std::lock_guard lock{m_mutex};
+        auto const found = std::find(m_phases.begin(), m_phases.end(), name);
+        if (found != m_phases.end())
+            return std::distance(m_phases.begin(), found);
+        m_phases.push_back(name);
+        return m_phases.size() - 1;
+    }
+
+    // may be switched while other threads record
+    void enable_trace(bool enable = true) { m_trace.store(enable, std::memory_order_relaxed); }
+    bool trace_enabled() const { return m_trace.load(std::memory_order_relaxed); }
+
+    // forgets all recorded stats and events, phases stay registered
+    void reset()
+    {
+        std::lock_guard lock{m_mutex};
+        for (auto& thread : m_threads)
+        {
+            thread->stats.clear();
+            thread->events.clear();
+        }
+    }
+
+    std::int64_t now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - m_origin)
+            .count();
+    }
+
+    // nested is the time spent in the scopes timed inside this one
+    void record(std::size_t phase, std::int64_t start, std::int64_t stop,
+                std::int64_t nested = 0)
+    {
+        auto& thread = this_thread();
+        if (phase >= thread.stats.size())
+            thread.stats.resize(phase + 1);
+
+        auto const duration = stop - start;
+        auto& stats         = thread.stats[phase];
+        ++stats.count;
+        stats.total += duration;
+        stats.self += duration - nested;
+        stats.min = std::min(stats.min, duration);
+        stats.max = std::max(stats.max, duration);
+
+        if (trace_enabled())
+            thread.events.push_back({phase, start, duration});
+    }
+
+
+    // per-phase totals merged over all threads
+    std::vector<PhaseStats> summary() const
+    {
+        std::lock_guard lock{m_mutex};
+        std::vector<PhaseStats> merged(m_phases.size());
+        for (auto const& thread : m_threads)
+        {
+            for (auto iPhase = 0u; iPhase < thread->stats.size(); ++iPhase)
+            {
+                auto const& stats = thread->stats[iPhase];
+                auto& total       = merged[iPhase];
+                total.count += stats.count;
+                total.total += stats.total;
+                total.self += stats.self;
+                total.min = std::min(total.min, stats.min);
+                total.max = std::max(total.max, stats.max);
+            }
+        }
+        return merged;
+    }
+
+    // per-phase wall time in ns: the longest total of a thread, as threads time the same
+    // phase side by side and summing them counts the phase once per thread
+    std::vector<std::int64_t> wall_times() const
+    {
+        std::lock_guard lock{m_mutex};
+        std::vector<std::int64_t> wall(m_phases.size(), 0);
+        for (auto const& thread : m_threads)
+            for (auto iPhase = 0u; iPhase < thread->stats.size(); ++iPhase)
+                wall[iPhase] = std::max(wall[iPhase], thread->stats[iPhase].total);
+        return wall;
+    }
+
+    auto const& phases() const { return m_phases; }
+
+
+    // % is the share of the self time, so that nested phases are not counted twice
+    void print_summary(std::ostream& out = std::cout) const
+    {
+        auto const stats = summary();
+
+        std::int64_t grand_total = 0;
+        for (auto const& phase : stats)
+            grand_total += phase.self;
+
+        out << std::left << std::setw(20) << "phase" << std::right << std::setw(10) << "calls"
+            << std::setw(14) << "total (s)" << std::setw(14) << "self (s)" << std::setw(14)
+            << "mean (us)" << std::setw(14) << "min (us)" << std::setw(14) << "max (us)"
+            << std::setw(8) << "%" << "\n";
+
+        for (auto iPhase = 0u; iPhase < stats.size(); ++iPhase)
+        {
+            auto const& phase = stats[iPhase];
+            if (phase.count == 0)
+                continue;
+            auto const mean    = 1e-3 * phase.total / phase.count;
+            auto const percent = grand_total > 0 ? 100. * phase.self / grand_total : 0.;
+            out << std::left << std::setw(20) << m_phases[iPhase] << std::right << std::setw(10)
+                << phase.count << std::fixed << std::setprecision(4) << std::setw(14)
+                << 1e-9 * phase.total << std::setw(14) << 1e-9 * phase.self
+                << std::setprecision(2) << std::setw(14) << mean << std::setw(14)
+                << 1e-3 * phase.min << std::setw(14) << 1e-3 * phase.max << std::setprecision(1)
+                << std::setw(8) << percent << "\n";
+            out.unsetf(std::ios::fixed);
+        }
+    }
+
+
+    void write_chrome_trace(std::string const& filename) const
+    {
+        std::lock_guard lock{m_mutex};
+        std::ofstream out{filename};
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        for (auto const& thread : m_threads)
+        {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+                << "\"tid\":" << thread->thread_id << ",\"args\":{\"name\":\"thread "
+                << thread->thread_id << "\"}}";
+            first = false;
+            for (auto const& event : thread->events)
+            {
+                // chrome trace timestamps are in microseconds
+                out << ",\n{\"name\":\"" << m_phases[event.phase]
+                    << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread->thread_id
+                    << ",\"ts\":" << std::fixed << std::setprecision(3) << 1e-3 * event.start
+                    << ",\"dur\":" << 1e-3 * event.duration << "}";
+            }
+        }
+        out << "\n]}\n";
+    }
+
+
+private:
+    Timers()
+        : m_origin{std::chrono::steady_clock::now()}
+    {
+    }
+
+    ThreadRecord& this_thread()
+    {
+        thread_local ThreadRecord* record = nullptr;
+        if (!record)
+        {
+            std::lock_guard lock{m_mutex};
+            m_threads.push_back(std::make_unique<ThreadRecord>());
+            record            = m_threads.back().get();
+            record->thread_id = m_threads.size() - 1;
+        }
+        return *record;
+    }
+
+    std::chrono::steady_clock::time_point m_origin;
+    std::atomic<bool> m_trace = false;
+    mutable std::mutex m_mutex;
+    std::vector<std::string> m_phases;
+    std::vector<std::unique_ptr<ThreadRecord>> m_threads;
+};
+
+
+
+// the innermost timer of each thread knows its parent, to which it adds its time when it
+// stops, so that the parent can tell its self time
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(std::size_t phase)
+        : m_phase{phase}
+        , m_parent{innermost()}
+        , m_start{Timers::instance().now()}
+    {
+        innermost() = this;
+    }
+
+    ~ScopedTimer()
+    {
+        auto& timers    = Timers::instance();
+        auto const stop = timers.now();
+        timers.record(m_phase, m_start, stop, m_nested);
+        if (m_parent)
+            m_parent->m_nested += stop - m_start;
+        innermost() = m_parent;
+    }
+
+    ScopedTimer(ScopedTimer const&)            = delete;
+    ScopedTimer& operator=(ScopedTimer const&) = delete;
+
+private:
+    static ScopedTimer*& innermost()
+    {
+        thread_local ScopedTimer* timer = nullptr;
+        return timer;
+    }
+
+    std::size_t m_phase;
+    ScopedTimer* m_parent;
+    std::int64_t m_start;
+    std::int64_t m_nested = 0;
+};
+
+
+
+#define HYBIRT_CONCAT_IMPL(a, b) a##b
+#define HYBIRT_CONCAT(a, b) HYBIRT_CONCAT_IMPL(a, b)
+
+#ifdef HYBIRT_TIMERS
+#define HYBIRT_TIME_SCOPE(name)                                                                   \
+    static std::size_t const HYBIRT_CONCAT(hybirt_phase_, __LINE__)                               \
+        = Timers::instance().phase_id(name);                                                      \
+    ScopedTimer HYBIRT_CONCAT(hybirt_timer_, __LINE__)                                            \
+    {                                                                                             \
+        HYBIRT_CONCAT(hybirt_phase_, __LINE__)                                                    \
+    }
+#else
+#define HYBIRT_TIME_SCOPE(name)
+#endif
+
+
+#endif // HYBIRT_TIMERS_HPP
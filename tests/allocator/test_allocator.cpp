@@ -0,0 +1,72 @@
+#include "allocator.hpp"
+#include "field.hpp"
+#include "particle.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <stdexcept>
+
+
+// large blocks are mapped and touched by the allocator, and hold what the vector puts in them
+// through copies and growth like any vector
+void large_blocks_behave_like_vectors()
+{
+    std::cout << "Running large_blocks_behave_like_vectors test...\n";
+    std::size_t constexpr size = 3 * huge_page_bytes / sizeof(double) + 7;
+    Field<1> field{{size}, Quantity::Ex};
+    std::size_t index = 0;
+    for (auto& node : field)
+        node = static_cast<double>(index++);
+
+    auto const* data = std::to_address(field.begin());
+    if (maps_memory and huge_pages_policy() != HugePages::none
+        and reinterpret_cast<std::uintptr_t>(data) % huge_page_bytes != 0)
+        throw std::runtime_error("huge blocks do not start on a huge page");
+
+    auto const copy = field;
+    ParticleArray<1> particles;
+    for (std::size_t iPart = 0; iPart < 100'000; ++iPart)
+    {
+        Particle<1> particle;
+        particle.id = iPart;
+        particles.push_back(particle);
+    }
+    for (std::size_t ix = 0; ix < size; ++ix)
+        if (copy(ix) != static_cast<double>(ix))
+            throw std::runtime_error("a copy of a field lost its values");
+    for (std::size_t iPart = 0; iPart < particles.size(); ++iPart)
+        if (particles[iPart].id != iPart)
+            throw std::runtime_error("growing the particle array lost particles");
+}
+
+
+// every byte is accounted for and every sampled page is on a node, possibly unknown when
+// the kernel does not tell
+void placement_is_reported()
+{
+    std::cout << "Running placement_is_reported test...\n";
+    std::size_t constexpr size = huge_page_bytes / sizeof(double);
+    Field<1> field{{size}, Quantity::Ex};
+    auto const placement = memory_placement(field);
+
+    std::size_t sampled = 0;
+    for (auto const& [node, pages] : placement.pages_per_node)
+        sampled += pages;
+    if (placement.bytes != size * sizeof(double) or sampled != huge_page_bytes / page_bytes
+        or placement.huge_page_bytes > placement.bytes)
+        throw std::runtime_error("wrong memory placement report");
+    placement.print("a test field");
+
+    auto const small = memory_placement(Field<1>{{10}, Quantity::Ex});
+    if (small.bytes != 10 * sizeof(double))
+        throw std::runtime_error("wrong memory placement report of a small block");
+}
+
+
+int main()
+{
+    large_blocks_behave_like_vectors();
+    placement_is_reported();
+}
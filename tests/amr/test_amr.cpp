@@ -0,0 +1,221 @@
+#include "amr.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+std::size_t constexpr dimension  = 1;
+std::size_t constexpr nbr_cells  = 64;
+double constexpr cell_size       = 0.5;
+std::size_t constexpr nbr_ghosts = Shape<interp_order>::nbr_ghosts;
+double constexpr bump_position   = 20.2;
+
+
+// By bump exp(-((x - x0) / w)^2) about a cell wide, the only place that needs refinement
+void set_bump(Hierarchy<dimension>& hierarchy)
+{
+    auto& coarse      = hierarchy.coarse();
+    auto const layout = coarse.layout;
+    for (auto ix = 0u; ix < layout->allocate(Quantity::By)[0]; ++ix)
+    {
+        auto const x   = layout->coordinate(Direction::X, Quantity::By, ix);
+        coarse.B.y(ix) = std::exp(-std::pow((x - bump_position) / 0.4, 2));
+    }
+    hierarchy.boundary().fill(coarse.B);
+}
+
+
+void boxes_follow_the_gradient()
+{
+    std::cout << "Running boxes_follow_the_gradient test...\n";
+    auto const tagged = [](std::vector<std::size_t> const& cells) {
+        std::vector<bool> tags(20, false);
+        for (auto const cell : cells)
+            tags[cell] = true;
+        return tags;
+    };
+    if (cluster(tagged({3, 4, 12}), 1) != std::vector<Box>{{2, 5}, {11, 13}}
+        or cluster(tagged({3, 6}), 1) != std::vector<Box>{{2, 7}}
+        or cluster(tagged({0, 19}), 2) != std::vector<Box>{{0, 2}, {17, 19}})
+        throw std::runtime_error("wrong clustering of the tagged cells");
+
+    Hierarchy<dimension> hierarchy{nbr_cells, cell_size, nbr_ghosts, {}, {0.1, 2}};
+    set_bump(hierarchy);
+    hierarchy.regrid(hierarchy.coarse().B.y);
+
+    auto const bump_cell = static_cast<std::size_t>(bump_position / cell_size);
+    auto const& boxes    = hierarchy.boxes();
+    if (boxes.size() != 1 or boxes[0].lower > bump_cell - 2 or boxes[0].upper < bump_cell + 2
+        or boxes[0].size() > 10)
+        throw std::runtime_error("boxes do not cover the bump tightly");
+
+    auto const& patch = hierarchy.fine()[0];
+    if (patch.layout->nbr_cells(Direction::X) != 2 * boxes[0].size()
+        or patch.layout->cell_size(Direction::X) != cell_size / 2
+        or patch.origin[0] != boxes[0].lower * cell_size)
+        throw std::runtime_error("wrong fine patch layout");
+
+    if (hierarchy.regrid(hierarchy.coarse().B.y))
+        throw std::runtime_error("regrid changed boxes that still fit");
+}
+
+
+// fine fields interpolated linearly from the coarse ones, in space and in time, and back
+void fields_move_between_levels()
+{
+    std::cout << "Running fields_move_between_levels test...\n";
+    Hierarchy<dimension> hierarchy{nbr_cells, cell_size, nbr_ghosts, {}, {0.1, 2}};
+    auto& coarse      = hierarchy.coarse();
+    auto const layout = coarse.layout;
+
+    auto const set_linear = [&](double slope) {
+        for (auto* field : {&coarse.E.x, &coarse.E.y, &coarse.B.z})
+            for (auto ix = 0u; ix < layout->allocate(field->quantity())[0]; ++ix)
+                (*field)(ix) = 1. + slope * layout->coordinate(Direction::X, field->quantity(), ix);
+    };
+    set_linear(0.1);
+    set_bump(hierarchy);
+    hierarchy.regrid(coarse.B.y);
+
+    auto& patch      = hierarchy.fine()[0];
+    auto const check = [&](double slope, bool ghosts, std::string const& what) {
+        for (auto* field : {&patch.E.x, &patch.E.y, &patch.B.z})
+        {
+            auto const qty = field->quantity();
+            auto const dsi = patch.layout->dom_start(qty, Direction::X);
+            auto const dei = patch.layout->dom_end(qty, Direction::X);
+            for (auto ix = 0u; ix < patch.layout->allocate(qty)[0]; ++ix)
+            {
+                if (ghosts == (ix >= dsi and ix <= dei))
+                    continue;
+                auto const x = patch.origin[0] + patch.layout->coordinate(Direction::X, qty, ix);
+                if (std::abs((*field)(ix) - (1. + slope * x)) > 1e-12)
+                    throw std::runtime_error(what);
+            }
+        }
+    };
+    check(0.1, false, "fine fields are not interpolated linearly");
+    check(0.1, true, "fine ghosts are not interpolated linearly");
+
+    hierarchy.begin_coarse_step();
+    set_linear(0.3);
+    hierarchy.fill_fine_ghosts(0.25);
+    check(0.15, true, "fine ghosts are not interpolated in time");
+    check(0.1, false, "fine domain nodes were filled as ghosts");
+
+    // the coarse nodes under the patch take the fine values, equal to the old ones here
+    hierarchy.synchronize();
+    auto const& box = hierarchy.boxes()[0];
+    for (auto cell = box.lower; cell <= box.upper; ++cell)
+    {
+        auto const ix = nbr_ghosts + cell;
+        auto const x  = layout->coordinate(Direction::X, Quantity::Ex, ix);
+        if (std::abs(coarse.E.x(ix) - (1. + 0.1 * x)) > 1e-12)
+            throw std::runtime_error("coarse nodes under the patch were not synchronized");
+    }
+    auto const outside = nbr_ghosts + box.upper + 3;
+    if (std::abs(coarse.E.x(outside)
+                 - (1. + 0.3 * layout->coordinate(Direction::X, Quantity::Ex, outside)))
+        > 1e-12)
+        throw std::runtime_error("synchronize changed the coarse level outside the patches");
+}
+
+
+// particles go to the level that covers them, and the composite coarse moments keep the
+// amount of plasma: uniform particles give a uniform density across the levels
+void particles_and_moments_across_levels()
+{
+    std::cout << "Running particles_and_moments_across_levels test...\n";
+    for (std::size_t max_ppc : {0, 24})
+    {
+        Hierarchy<dimension> hierarchy{nbr_cells, cell_size, nbr_ghosts, {"protons"},
+                                       {0.1, 2, 16, max_ppc}};
+        auto& coarse = hierarchy.coarse();
+        // particles evenly spread over their cell deposit a uniform density exactly
+        auto& particles = coarse.populations[0].particles();
+        coarse.populations[0].load_particles(20, [](double) { return 1.; });
+        for (std::size_t iPart = 0; iPart < particles.size(); ++iPart)
+            particles[iPart].position[0] = (iPart / 20 + (iPart % 20 + 0.5) / 20) * cell_size;
+        set_bump(hierarchy);
+        hierarchy.regrid(coarse.B.y);
+
+        auto const& box   = hierarchy.boxes()[0];
+        auto const& patch = hierarchy.fine()[0];
+        auto const amount = [&]() {
+            double total = 0.;
+            for (auto const& particle : coarse.populations[0].particles())
+            {
+                total += particle.weight * cell_size;
+                if (particle.position[0] >= box.lower * cell_size
+                    and particle.position[0] < (box.upper + 1) * cell_size)
+                    throw std::runtime_error("coarse particle left inside a box");
+            }
+            for (auto const& particle : patch.populations[0].particles())
+                total += particle.weight * cell_size / 2;
+            return total;
+        };
+        auto const expected = nbr_cells * cell_size;
+        if (std::abs(amount() - expected) > 1e-10)
+            throw std::runtime_error("moving particles between levels lost plasma");
+
+        if (max_ppc > 0)
+        {
+            std::vector<std::size_t> counts(patch.layout->nbr_cells(Direction::X), 0);
+            for (auto const& particle : patch.populations[0].particles())
+                ++counts[static_cast<std::size_t>(particle.position[0] / (cell_size / 2))];
+            for (auto const count : counts)
+                if (count < 16 or count > 24)
+                    throw std::runtime_error("fine cells were not resampled to the band");
+        }
+
+        hierarchy.deposit();
+        // the fine deposit restricted to the coarse nodes is the coarse one for linear shapes
+        // only, with higher orders the composite density wiggles at the patch edges
+        bool const exact_composite = max_ppc == 0 and interp_order == 1;
+        auto const& density        = coarse.populations[0].density();
+        for (auto ix = 0u; exact_composite and ix < coarse.layout->allocate(Quantity::N)[0]; ++ix)
+            if (std::abs(density(ix) - 1.) > 1e-10)
+                throw std::runtime_error("composite density is not uniform");
+        auto const& fine_density = patch.populations[0].density();
+        auto const dsi           = patch.layout->dom_start(Quantity::N, Direction::X);
+        auto const dei           = patch.layout->dom_end(Quantity::N, Direction::X);
+        for (auto ix = 0u; max_ppc == 0 and ix < patch.layout->allocate(Quantity::N)[0]; ++ix)
+            if ((exact_composite or (ix >= dsi and ix <= dei))
+                and std::abs(fine_density(ix) - 1.) > 1e-10)
+                throw std::runtime_error("fine density is not uniform across the patch edges");
+
+        // a shift of a third of a fine cell moves particles across the patch edges
+        for (auto* level : {&coarse, &hierarchy.fine()[0]})
+            for (auto& particle : level->populations[0].particles())
+            {
+                particle.position[0] += cell_size / 6;
+                if (level == &coarse and particle.position[0] >= nbr_cells * cell_size)
+                    particle.position[0] -= nbr_cells * cell_size;
+            }
+        hierarchy.migrate_particles();
+        if (std::abs(amount() - expected) > 1e-10)
+            throw std::runtime_error("migration between levels lost plasma");
+
+        hierarchy.deposit();
+        double total = 0.;
+        for (auto ix = coarse.layout->dom_start(Quantity::N, Direction::X);
+             ix < coarse.layout->dom_end(Quantity::N, Direction::X); ++ix)
+            total += density(ix) * cell_size;
+        if (std::abs(total - expected) > 1e-10)
+            throw std::runtime_error("composite moments lost plasma");
+    }
+}
+
+
+int main()
+{
+    boxes_follow_the_gradient();
+    fields_move_between_levels();
+    particles_and_moments_across_levels();
+}
@@ -16,7 +16,7 @@ void uniform_bz()
     particle.weight      = 1.0;
     particle.mass        = 1.0;
     particle.charge      = 1.0;
-    std::vector<Particle<1>> particles{particle};
+    ParticleArray<1> particles{particle};
 
     double time                     = 0.;
     double final_time               = 3.141592 * 4;
@@ -25,7 +25,7 @@ void uniform_bz()
 
     std::array<std::size_t, dimension> grid_size = {1000};
     std::array<double, dimension> cell_size      = {0.1};
-    auto constexpr nbr_ghosts                    = 1;
+    auto constexpr nbr_ghosts                    = Shape<interp_order>::nbr_ghosts;
     auto layout = std::make_shared<GridLayout<dimension>>(grid_size, cell_size, nbr_ghosts);
 
     VecField<dimension> E{layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
@@ -93,7 +93,7 @@ void drift_ey()
     particle.weight      = 1.0;
     particle.mass        = 1.0;
     particle.charge      = 1.0;
-    std::vector<Particle<1>> particles{particle};
+    ParticleArray<1> particles{particle};
 
     double time                     = 0.;
     double final_time               = 3.141592 * 4;
@@ -102,7 +102,7 @@ void drift_ey()
 
     std::array<std::size_t, dimension> grid_size = {1000};
     std::array<double, dimension> cell_size      = {0.1};
-    auto constexpr nbr_ghosts                    = 1;
+    auto constexpr nbr_ghosts                    = Shape<interp_order>::nbr_ghosts;
     auto layout = std::make_shared<GridLayout<dimension>>(grid_size, cell_size, nbr_ghosts);
 
     VecField<dimension> E{layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
@@ -0,0 +1,179 @@
+#include "population.hpp"
+#include "boundary_condition.hpp"
+#include "reduced_diagnostics.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <numbers>
+#include <stdexcept>
+#include <vector>
+
+
+std::size_t constexpr dimension = 1;
+std::size_t constexpr nbr_cells = 32;
+double constexpr cell_size      = 0.25;
+Maxwellian const background{2.0, {0.1, -0.2, 0.}, {0.3, 0.2, 0.25}};
+
+
+auto make_layout()
+{
+    return std::make_shared<GridLayout<dimension>>(std::array<std::size_t, dimension>{nbr_cells},
+                                                   std::array<double, dimension>{cell_size}, 1);
+}
+
+
+// without perturbation, the moments are the background on every node, free of noise
+void unperturbed_moments_are_exact()
+{
+    std::cout << "Running unperturbed_moments_are_exact test...\n";
+    auto const layout = make_layout();
+    PeriodicBoundaryCondition<dimension> boundary_condition{layout};
+    Population<dimension> population{"protons", layout};
+    population.load_delta_f(20, background, [](double) { return 0.; }, 1., 1., 42);
+
+    population.deposit<1>();
+    boundary_condition.fill_all(population.flux(), population.density());
+    population.add_background();
+
+    for (auto ix = 0u; ix < layout->allocate(Quantity::N)[0]; ++ix)
+    {
+        if (population.density()(ix) != background.density
+            or population.flux().x(ix) != background.density * background.V[0]
+            or population.flux().y(ix) != background.density * background.V[1]
+            or population.flux().z(ix) != background.density * background.V[2])
+            throw std::runtime_error("unperturbed delta f moments differ from the background");
+    }
+}
+
+
+// markers at the cell centers deposit the perturbation of their cell, half on each node
+void perturbation_is_deposited()
+{
+    std::cout << "Running perturbation_is_deposited test...\n";
+    auto const layout = make_layout();
+    PeriodicBoundaryCondition<dimension> boundary_condition{layout};
+    Population<dimension> population{"protons", layout};
+
+    auto const k            = 2 * std::numbers::pi / layout->dom_size(Direction::X);
+    auto const perturbation = [k](double x) { return 0.01 * std::sin(k * x); };
+    population.load_delta_f(20, background, perturbation, 1., 1., 43);
+
+    population.deposit<1>();
+    boundary_condition.fill_all(population.flux(), population.density());
+    population.add_background();
+
+    for (auto ix = 0u; ix < layout->allocate(Quantity::N)[0]; ++ix)
+    {
+        auto const x        = layout->coordinate(Direction::X, Quantity::N, ix);
+        auto const expected = background.density
+                              + 0.5 * (perturbation(x - 0.5 * cell_size)
+                                       + perturbation(x + 0.5 * cell_size));
+        if (std::abs(population.density()(ix) - expected) > 1e-12)
+            throw std::runtime_error("wrong delta f density");
+    }
+}
+
+
+// in a uniform E, the velocity is linear in time. The markers are drawn from f0 and the total
+// distribution f = f0 (1 + delta_density / n0) at the load is conserved along the orbit, so
+// W = p (f(z0) - f0(z)) / f0(z0) exactly, with p the marker weight
+void weights_follow_the_orbits()
+{
+    std::cout << "Running weights_follow_the_orbits test...\n";
+    auto const layout = make_layout();
+    Population<dimension> population{"protons", layout};
+    auto const nppc          = 4;
+    auto const delta_density = [](double x) { return 0.05 * x; };
+    population.load_delta_f(nppc, background, delta_density, 2., 1., 44);
+
+    std::array<double, 3> const efield{0.3, -0.2, 0.1};
+    VecField<dimension> E{layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
+    VecField<dimension> B{layout, {Quantity::Bx, Quantity::By, Quantity::Bz}};
+    for (auto& node : E.x)
+        node = efield[0];
+    for (auto& node : E.y)
+        node = efield[1];
+    for (auto& node : E.z)
+        node = efield[2];
+
+    // the background is uniform, its normalization cancels out of the ratios
+    auto const f0 = [](std::array<double, 3> const& v) {
+        double exponent = 0.;
+        for (std::size_t iComp = 0; iComp < 3; ++iComp)
+        {
+            auto const u = (v[iComp] - background.V[iComp]) / background.Vth[iComp];
+            exponent -= 0.5 * u * u;
+        }
+        return std::exp(exponent);
+    };
+
+    auto& particles    = population.particles();
+    auto const initial = particles;
+    double const dt    = 0.05;
+    auto const kick = [&]() {
+        for (auto& particle : particles)
+            for (std::size_t iComp = 0; iComp < 3; ++iComp)
+                particle.v[iComp] += 0.5 * dt * particle.charge / particle.mass * efield[iComp];
+    };
+    for (int iStep = 0; iStep < 40; ++iStep)
+    {
+        kick();
+        population.evolve_weights<1>(E, B, dt);
+        kick();
+    }
+
+    auto const n0            = background.density;
+    auto const marker_weight = n0 / nppc;
+    for (std::size_t iPart = 0; iPart < particles.size(); ++iPart)
+    {
+        auto const& start   = initial[iPart];
+        auto const f_start  = f0(start.v) * (1. + delta_density(start.position[0]) / n0);
+        auto const expected = marker_weight * (f_start - f0(particles[iPart].v)) / f0(start.v);
+        auto const scale    = std::max(marker_weight, std::abs(expected));
+        if (std::abs(particles[iPart].weight - expected) > 1e-12 * scale)
+            throw std::runtime_error("delta f weight drifted from the orbit");
+    }
+}
+
+
+// markers without perturbation carry no weight, the energy and momentum of the population
+// are those of the background over the domain
+void reduced_diagnostics_count_the_background()
+{
+    std::cout << "Running reduced_diagnostics_count_the_background test...\n";
+    auto const layout = make_layout();
+    std::vector<Population<dimension>> populations;
+    populations.emplace_back("protons", layout);
+    populations[0].load_delta_f(10, background, [](double) { return 0.; }, 2., 1., 45);
+
+    VecField<dimension> E{layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
+    VecField<dimension> B{layout, {Quantity::Bx, Quantity::By, Quantity::Bz}};
+    ReducedDiagnostics<dimension> reduced{layout, {"protons"}};
+    reduced.compute(populations, E, B);
+
+    auto const mass = 2. * background.density * nbr_cells * cell_size;
+    double kinetic  = 0.;
+    for (std::size_t iComp = 0; iComp < 3; ++iComp)
+    {
+        auto const V   = background.V[iComp];
+        auto const Vth = background.Vth[iComp];
+        kinetic += 0.5 * mass * (V * V + Vth * Vth);
+        if (std::abs(reduced.momentum(0)[iComp] - mass * V) > 1e-12 * mass)
+            throw std::runtime_error("delta f momentum misses the background");
+    }
+    if (std::abs(reduced.kinetic_energy(0) - kinetic) > 1e-12 * kinetic)
+        throw std::runtime_error("delta f kinetic energy misses the background");
+}
+
+
+int main()
+{
+    unperturbed_moments_are_exact();
+    perturbation_is_deposited();
+    weights_follow_the_orbits();
+    reduced_diagnostics_count_the_background();
+}
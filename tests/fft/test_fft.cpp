@@ -0,0 +1,107 @@
+#include "fft.hpp"
+#include "spectral_diagnostics.hpp"
+
+#include <cmath>
+#include <complex>
+#include <iostream>
+#include <numbers>
+#include <stdexcept>
+#include <vector>
+
+
+std::vector<std::complex<double>> naive_dft(std::vector<std::complex<double>> const& data)
+{
+    auto const size = data.size();
+    std::vector<std::complex<double>> result(size);
+    for (std::size_t k = 0; k < size; ++k)
+        for (std::size_t n = 0; n < size; ++n)
+        {
+            auto const angle = -2 * std::numbers::pi * k * n / size;
+            result[k] += data[n] * std::complex<double>{std::cos(angle), std::sin(angle)};
+        }
+    return result;
+}
+
+
+void compare_with_dft(std::size_t size)
+{
+    std::cout << "Running fft size " << size << " test...\n";
+    std::vector<std::complex<double>> data(size);
+    for (std::size_t n = 0; n < size; ++n)
+        data[n] = {std::sin(0.3 * n) + 0.1 * n, std::cos(1.7 * n)};
+
+    auto expected = naive_dft(data);
+    auto result   = data;
+    fft(result);
+
+    for (std::size_t k = 0; k < size; ++k)
+        if (std::abs(result[k] - expected[k]) > 1e-9 * size)
+            throw std::runtime_error("fft differs from the naive DFT");
+
+    // unnormalized inverse gives back size * data
+    fft(result, true);
+    for (std::size_t n = 0; n < size; ++n)
+        if (std::abs(result[n] / static_cast<double>(size) - data[n]) > 1e-9 * size)
+            throw std::runtime_error("inverse fft does not give back the input");
+}
+
+
+// a wave By = cos(k x - omega t) must peak in the k-omega spectrum at (k, +omega)
+void travelling_wave()
+{
+    std::cout << "Running travelling_wave test...\n";
+    std::size_t constexpr dimension = 1;
+
+    std::array<std::size_t, dimension> grid_size = {100};
+    std::array<double, dimension> cell_size      = {0.2};
+    auto constexpr nbr_ghosts                    = 1;
+    auto layout = std::make_shared<GridLayout<dimension>>(grid_size, cell_size, nbr_ghosts);
+
+    VecField<dimension> E{layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
+    VecField<dimension> B{layout, {Quantity::Bx, Quantity::By, Quantity::Bz}};
+
+    std::size_t constexpr window = 128;
+    std::size_t constexpr mode   = 3;
+    double constexpr dt          = 0.05;
+    std::size_t constexpr iOmega = 10; // omega on an exact frequency bin
+    auto const L                 = grid_size[0] * cell_size[0];
+    auto const k                 = 2 * std::numbers::pi * mode / L;
+    auto const omega             = 2 * std::numbers::pi * iOmega / (window * dt);
+
+    SpectralDiagnostics<dimension> spectral{layout, {Quantity::By}, 8, window, dt};
+
+    for (std::size_t it = 0; it < 2 * window; ++it)
+    {
+        for (auto ix = layout->dual_dom_start(Direction::X);
+             ix <= layout->dual_dom_end(Direction::X); ++ix)
+        {
+            auto const x = layout->coordinate(Direction::X, Quantity::By, ix);
+            B.y(ix)      = std::cos(k * x - omega * it * dt);
+        }
+        spectral.sample(E, B);
+    }
+
+    if (spectral.nbr_windows() != 3)
+        throw std::runtime_error("expected 3 half-overlapping windows");
+
+    std::size_t peak_omega = 0, peak_mode = 0;
+    for (std::size_t io = 0; io < window; ++io)
+        for (std::size_t im = 0; im < 8; ++im)
+            if (spectral.power(0, io, im) > spectral.power(0, peak_omega, peak_mode))
+            {
+                peak_omega = io;
+                peak_mode  = im;
+            }
+
+    if (peak_mode != mode or peak_omega != window / 2 + iOmega)
+        throw std::runtime_error("spectral peak at the wrong (k, omega)");
+}
+
+
+int main()
+{
+    compare_with_dft(64);
+    compare_with_dft(100);
+    compare_with_dft(7);
+    travelling_wave();
+}
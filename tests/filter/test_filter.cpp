@@ -0,0 +1,115 @@
+#include "filter.hpp"
+#include "boundary_condition.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+
+
+std::size_t constexpr dimension = 1;
+std::size_t constexpr nbr_cells = 32;
+double constexpr cell_size      = 0.2;
+
+
+auto make_layout()
+{
+    return std::make_shared<GridLayout<dimension>>(std::array<std::size_t, dimension>{nbr_cells},
+                                                   std::array<double, dimension>{cell_size}, 1);
+}
+
+
+// a single pass removes the grid scale mode
+void removes_grid_scale()
+{
+    std::cout << "Running removes_grid_scale test...\n";
+    auto const layout = make_layout();
+    PeriodicBoundaryCondition<dimension> boundary_condition{layout};
+    BinomialFilter<dimension> filter{layout, 1};
+
+    Field<dimension> field{layout->allocate(Quantity::Ex), Quantity::Ex};
+    for (auto ix = 0u; ix < layout->allocate(Quantity::Ex)[0]; ++ix)
+        field(ix) = ix % 2 == 0 ? 1. : -1.;
+
+    filter(field, boundary_condition);
+    for (auto const node : field)
+        if (std::abs(node) > 1e-15)
+            throw std::runtime_error("grid scale mode survived a binomial pass");
+}
+
+
+// passes and compensation damp a mode k by cos^2(k dx / 2)^n (1 + n/2 - n/2 cos(k dx))
+void transfer_function()
+{
+    std::cout << "Running transfer_function test...\n";
+    auto const layout      = make_layout();
+    auto const length      = layout->dom_size(Direction::X);
+    std::size_t nbr_passes = 2;
+    PeriodicBoundaryCondition<dimension> boundary_condition{layout};
+    BinomialFilter<dimension> filter{layout, nbr_passes, true};
+
+    for (auto mode : {1, 3, 8})
+    {
+        auto const k  = 2 * std::numbers::pi * mode / length;
+        auto const kd = k * cell_size;
+        auto const expected_gain = std::pow(std::cos(kd / 2), 2 * nbr_passes)
+                                   * (1 + nbr_passes / 2. * (1 - std::cos(kd)));
+
+        Field<dimension> field{layout->allocate(Quantity::Ey), Quantity::Ey};
+        for (auto ix = 0u; ix < layout->allocate(Quantity::Ey)[0]; ++ix)
+            field(ix) = std::sin(k * layout->coordinate(Direction::X, Quantity::Ey, ix));
+
+        filter(field, boundary_condition);
+        for (auto ix = 0u; ix < layout->allocate(Quantity::Ey)[0]; ++ix)
+        {
+            auto const x = layout->coordinate(Direction::X, Quantity::Ey, ix);
+            if (std::abs(field(ix) - expected_gain * std::sin(k * x)) > 1e-12)
+                throw std::runtime_error("wrong filter transfer function");
+        }
+    }
+}
+
+
+// filtering a deposited moment keeps its total and leaves its ghosts equal to their images,
+// they must not be folded again between passes
+void moments_keep_their_total()
+{
+    std::cout << "Running moments_keep_their_total test...\n";
+    auto const layout = make_layout();
+    PeriodicBoundaryCondition<dimension> boundary_condition{layout};
+    BinomialFilter<dimension> filter{layout, 3, true};
+
+    std::mt19937_64 generator{11};
+    std::uniform_real_distribution<> uniform{0., 1.};
+    Field<dimension> density{layout->allocate(Quantity::N), Quantity::N};
+    for (auto& node : density)
+        node = uniform(generator);
+    boundary_condition.fill(density);
+
+    auto const dsi   = layout->dom_start(Quantity::N, Direction::X);
+    auto const dei   = layout->dom_end(Quantity::N, Direction::X);
+    auto const total = [&]() {
+        double sum = 0.;
+        for (auto ix = dsi; ix < dei; ++ix)
+            sum += density(ix);
+        return sum;
+    };
+    auto const before = total();
+
+    filter(density, boundary_condition);
+    if (std::abs(total() - before) > 1e-12 * before)
+        throw std::runtime_error("filter changed the total of a moment");
+    if (density(dei) != density(dsi) or density(dsi - 1) != density(dei - 1))
+        throw std::runtime_error("moment ghosts differ from their images after filtering");
+}
+
+
+int main()
+{
+    removes_grid_scale();
+    transfer_function();
+    moments_keep_their_total();
+}
@@ -0,0 +1,77 @@
+#include "ghost_fill.hpp"
+#include "boundary_condition.hpp"
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+
+// the periodic fill the plan replaces, one field at a time
+void reference_fill(GridLayout<1> const& layout, Field<1>& field)
+{
+    auto const qty       = field.quantity();
+    auto const gsi       = layout.ghost_start(qty, Direction::X);
+    auto const dsi       = layout.dom_start(qty, Direction::X);
+    auto const dei       = layout.dom_end(qty, Direction::X);
+    auto const gei       = layout.ghost_end(qty, Direction::X);
+    auto const nbr_nodes = layout.nbr_cells(Direction::X);
+
+    if (qty == Quantity::N or qty == Quantity::Vx or qty == Quantity::Vy or qty == Quantity::Vz)
+    {
+        // ghosts (and the last node) fold into their image, which is then copied back
+        for (auto ix_right = dei; ix_right <= gei; ++ix_right)
+            field(ix_right - nbr_nodes) += field(ix_right);
+        for (std::size_t ix_left = gsi; ix_left < dsi; ++ix_left)
+            field(ix_left + nbr_nodes) += field(ix_left);
+        for (std::size_t ix_left = gsi; ix_left < dsi; ++ix_left)
+            field(ix_left) = field(ix_left + nbr_nodes);
+        for (auto ix_right = dei; ix_right <= gei; ++ix_right)
+            field(ix_right) = field(ix_right - nbr_nodes);
+    }
+    else
+    {
+        for (std::size_t ix_left = gsi; ix_left < dsi; ++ix_left)
+            field(ix_left) = field(ix_left + nbr_nodes);
+        for (auto ix_right = gei; ix_right > dei; --ix_right)
+            field(ix_right) = field(ix_right - nbr_nodes);
+    }
+}
+
+
+void compare_with_reference(std::size_t nbr_ghosts)
+{
+    std::cout << "Running compare_with_reference test with " << nbr_ghosts << " ghosts...\n";
+    std::size_t constexpr dimension = 1;
+
+    std::array<std::size_t, dimension> grid_size = {20};
+    std::array<double, dimension> cell_size      = {0.2};
+    auto layout = std::make_shared<GridLayout<dimension>>(grid_size, cell_size, nbr_ghosts);
+
+    PeriodicBoundaryCondition<dimension> boundary_condition{layout};
+
+    for (auto qty : {Quantity::Ex, Quantity::Ey, Quantity::Ez, Quantity::Bx, Quantity::By,
+                     Quantity::Bz, Quantity::Jx, Quantity::Jy, Quantity::Jz, Quantity::N,
+                     Quantity::Vx, Quantity::Vy, Quantity::Vz})
+    {
+        Field<dimension> field{layout->allocate(qty), qty};
+        auto value = 1.0;
+        for (auto& node : field)
+            node = value++;
+        auto expected = field;
+
+        reference_fill(*layout, expected);
+        boundary_condition.fill(field);
+
+        for (auto ix = 0u; ix < layout->allocate(qty)[0]; ++ix)
+            if (field(ix) != expected(ix))
+                throw std::runtime_error("ghost plan differs from the reference periodic fill");
+    }
+}
+
+
+int main()
+{
+    compare_with_reference(1);
+    compare_with_reference(2);
+}
@@ -0,0 +1,187 @@
+#include "input_deck.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+void full_deck()
+{
+    std::cout << "Running full_deck test...\n";
+    std::stringstream deck{R"(
+# two species Alfven wave
+[simulation]
+nbr_cells  = 64    ; inline comment
+cell_size  = 0.5
+dt         = 0.002
+final_time = 1
+single_pass_moments = true
+
+[fields]
+by = 1
+bz = sine:0,0.01,0.5
+
+[population.protons]
+nppc          = 50
+density       = gaussian:1,0.5,16,2
+bulk_velocity = 0.1, 0, 0
+
+[population.alphas]
+mass               = 4
+charge             = 2
+delta_f            = true
+background_density = 0.1
+
+[filter]
+passes     = 2
+compensate = yes
+
+[resampling]
+every   = 10
+max_ppc = 300
+
+[window]
+velocity = -0.25
+
+[time_step]
+adaptive = true
+max_dt   = 0.01
+
+[diagnostics]
+prefix       = alfven_
+fields_every = 10
+
+[histogram.fvy]
+components = vy
+bins       = 20
+vmin       = -2
+vmax       = 2
+window     = 4, 8.5
+)"};
+
+    auto const params = read_input_deck(deck);
+
+    if (params.nbr_cells != 64 or params.cell_size != 0.5 or params.dt != 0.002
+        or params.final_time != 1. or params.nbr_ghosts != Shape<interp_order>::nbr_ghosts
+        or !params.single_pass_moments)
+        throw std::runtime_error("wrong [simulation] parameters");
+
+    if (params.by(3.) != 1. or std::abs(params.bz(std::numbers::pi) - 0.01) > 1e-12)
+        throw std::runtime_error("wrong [fields] profiles");
+
+    if (params.populations.size() != 2 or params.populations[0].name != "protons"
+        or params.populations[1].name != "alphas")
+        throw std::runtime_error("populations must come in the deck order");
+
+    auto const& protons = params.populations[0];
+    auto const& alphas  = params.populations[1];
+    if (protons.nppc != 50 or protons.V[0] != 0.1 or protons.density(16.) != 1.5)
+        throw std::runtime_error("wrong protons parameters");
+    if (alphas.mass != 4. or alphas.charge != 2. or alphas.nppc != 100 or !alphas.delta_f
+        or alphas.background_density != 0.1 or protons.delta_f)
+        throw std::runtime_error("wrong alphas parameters");
+
+    if (params.diag_prefix != "alfven_" or params.diagnostics.fields_every != 10
+        or params.diagnostics.reduced_every != 1)
+        throw std::runtime_error("wrong [diagnostics] parameters");
+
+    auto const& histograms = params.diagnostics.histograms;
+    if (histograms.size() != 1 or histograms[0].name != "fvy"
+        or histograms[0].components != std::vector<std::size_t>{1}
+        or histograms[0].bins != std::vector<std::size_t>{20}
+        or histograms[0].vmin != std::vector<double>{-2.}
+        or histograms[0].vmax != std::vector<double>{2.} or !histograms[0].window
+        or (*histograms[0].window)[0] != 4. or (*histograms[0].window)[1] != 8.5)
+        throw std::runtime_error("wrong [histogram.fvy] parameters");
+
+    if (params.filter.passes != 2 or !params.filter.compensate)
+        throw std::runtime_error("wrong [filter] parameters");
+
+    auto const& resampling = params.resampling;
+    if (resampling.every != 10 or resampling.min_ppc != 50 or resampling.max_ppc != 300)
+        throw std::runtime_error("wrong [resampling] parameters");
+
+    if (params.window.velocity != -0.25)
+        throw std::runtime_error("wrong [window] parameters");
+
+    auto const& time_step = params.time_step;
+    if (!time_step.adaptive or time_step.max_dt != 0.01 or time_step.min_dt != 0.
+        or time_step.cfl != 0.5)
+        throw std::runtime_error("wrong [time_step] parameters");
+}
+
+
+void invalid_decks()
+{
+    std::cout << "Running invalid_decks test...\n";
+    for (std::string const text : {"[simulation]\nnbr_cell = 10\n", "[simulations]\n",
+                                   "nbr_cells = 10\n", "[fields]\nbx = 1\nbx = 2\n",
+                                   "[population.p]\nbulk_velocity = 1, 2\n", "[simulation\n",
+                                   "[filter]\ncompensate = maybe\n",
+                                   "[histogram.f]\ncomponents = vw\n",
+                                   "[histogram.f]\nwindow = 0, 1, 2\n"})
+    {
+        std::stringstream deck{text};
+        bool thrown = false;
+        try
+        {
+            read_input_deck(deck);
+        }
+        catch (std::exception const&)
+        {
+            thrown = true;
+        }
+        if (!thrown)
+            throw std::runtime_error("invalid deck accepted: " + text);
+    }
+}
+
+
+// numbers must be whole and in range, errors name the line, the section and the key
+void invalid_values()
+{
+    std::cout << "Running invalid_values test...\n";
+    for (std::string const text :
+         {"[simulation]\nnbr_cells = 100abc\n", "[simulation]\nnbr_cells = -1\n",
+          "[simulation]\ncell_size = 0.2x\n", "[simulation]\ndt =\n",
+          "[diagnostics]\nfields_every = 1.5\n", "[population.p]\nmass = 1 2\n",
+          "[population.p]\nthermal_velocity = 0.1, 0.1x, 0.1\n",
+          "[fields]\nby = sine:1,0.1,0.3y\n"})
+    {
+        std::stringstream deck{"# comment\n" + text};
+        std::string message;
+        try
+        {
+            read_input_deck(deck);
+        }
+        catch (std::exception const& e)
+        {
+            message = e.what();
+        }
+        if (message.empty())
+            throw std::runtime_error("invalid value accepted: " + text);
+
+        auto const section = text.substr(0, text.find(']') + 1);
+        auto const key     = text.substr(text.find('\n') + 1, text.find(' ') - text.find('\n') - 1);
+        if (message.find("line 3") == std::string::npos
+            or message.find(section + " " + key) == std::string::npos)
+            throw std::runtime_error("error without its line, section and key: " + message);
+    }
+
+    std::stringstream deck{"[simulation]\nnbr_cells = 12 \ncell_size=0.5\n"};
+    auto const params = read_input_deck(deck);
+    if (params.nbr_cells != 12 or params.cell_size != 0.5)
+        throw std::runtime_error("blanks around a number must be accepted");
+}
+
+
+int main()
+{
+    full_deck();
+    invalid_decks();
+    invalid_values();
+}
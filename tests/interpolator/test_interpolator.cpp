@@ -0,0 +1,141 @@
+#include "interpolator.hpp"
+#include "population.hpp"
+#include "boundary_condition.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+
+std::size_t constexpr dimension  = 1;
+std::size_t constexpr nbr_cells  = 20;
+double constexpr cell_size       = 0.2;
+std::size_t constexpr nbr_ghosts = 2;
+
+
+auto make_layout()
+{
+    return std::make_shared<GridLayout<dimension>>(std::array<std::size_t, dimension>{nbr_cells},
+                                                   std::array<double, dimension>{cell_size},
+                                                   nbr_ghosts);
+}
+
+
+// weights are positive, sum to 1 and reproduce linear functions of the node index
+template<std::size_t order>
+void partition_of_unity()
+{
+    std::cout << "Running partition_of_unity test for order " << order << "...\n";
+    std::mt19937_64 generator{order};
+    std::uniform_real_distribution<> uniform{1.5, 20.};
+
+    for (int iDraw = 0; iDraw < 1000; ++iDraw)
+    {
+        auto const x       = uniform(generator);
+        auto const stencil = Shape<order>::at(x);
+
+        double sum = 0., first_moment = 0.;
+        for (std::size_t point = 0; point < Shape<order>::nbr_points; ++point)
+        {
+            if (stencil.weights[point] < 0.)
+                throw std::runtime_error("negative shape weight");
+            sum += stencil.weights[point];
+            first_moment += stencil.weights[point] * (stencil.first + point);
+        }
+        if (std::abs(sum - 1.) > 1e-12 or std::abs(first_moment - x) > 1e-12)
+            throw std::runtime_error("shape of order " + std::to_string(order)
+                                     + " is not a partition of unity");
+    }
+}
+
+
+// every shape gathers linear fields exactly, on primal and dual nodes
+template<std::size_t order>
+void gather_linear_field()
+{
+    std::cout << "Running gather_linear_field test for order " << order << "...\n";
+    auto const layout  = make_layout();
+    auto const profile = [](double x) { return 0.3 + 1.7 * x; };
+
+    std::mt19937_64 generator{order};
+    std::uniform_real_distribution<> uniform{0., layout->dom_size(Direction::X)};
+
+    for (auto qty : {Quantity::Ex, Quantity::Ey})
+    {
+        Field<dimension> field{layout->allocate(qty), qty};
+        for (auto ix = 0u; ix < layout->allocate(qty)[0]; ++ix)
+            field(ix) = profile(layout->coordinate(Direction::X, qty, ix));
+
+        for (int iDraw = 0; iDraw < 1000; ++iDraw)
+        {
+            std::array<double, dimension> const position{uniform(generator)};
+            if (std::abs(interpolate<order>(field, *layout, position) - profile(position[0]))
+                > 1e-12)
+                throw std::runtime_error("linear field not gathered exactly");
+        }
+    }
+}
+
+
+// once the ghosts are folded, the domain holds the whole weight of the particles, the
+// ghosts at the domain edges included
+template<std::size_t order>
+void deposit_conserves_weight()
+{
+    std::cout << "Running deposit_conserves_weight test for order " << order << "...\n";
+    auto const layout = make_layout();
+    PeriodicBoundaryCondition<dimension> boundary_condition{layout};
+    Population<dimension> population{"protons", layout};
+
+    std::mt19937_64 generator{order};
+    std::uniform_real_distribution<> uniform{0., 1.};
+    double total_weight = 0., total_flux = 0.;
+    for (int iPart = 0; iPart < 1000; ++iPart)
+    {
+        Particle<dimension> particle{};
+        particle.position[0] = (iPart % 2 == 0 ? 0.02 : 0.98) * uniform(generator)
+                               * layout->dom_size(Direction::X);
+        particle.v           = {uniform(generator), 0., 0.};
+        particle.weight      = uniform(generator);
+        total_weight += particle.weight;
+        total_flux += particle.weight * particle.v[0];
+        population.particles().push_back(particle);
+    }
+
+    population.deposit<order>();
+    boundary_condition.fill_all(population.flux(), population.density());
+
+    auto const dsi = layout->dom_start(Quantity::N, Direction::X);
+    auto const dei = layout->dom_end(Quantity::N, Direction::X);
+    double weight = 0., flux = 0.;
+    for (auto ix = dsi; ix < dei; ++ix)
+    {
+        weight += population.density()(ix);
+        flux += population.flux().x(ix);
+    }
+    if (std::abs(weight - total_weight) > 1e-10 * total_weight
+        or std::abs(flux - total_flux) > 1e-10 * total_flux)
+        throw std::runtime_error("deposit of order " + std::to_string(order) + " lost weight");
+
+    for (auto ix = 0u; ix < dsi; ++ix)
+        if (population.density()(ix) != population.density()(ix + nbr_cells))
+            throw std::runtime_error("density ghost differs from its image");
+}
+
+
+int main()
+{
+    partition_of_unity<1>();
+    partition_of_unity<2>();
+    partition_of_unity<3>();
+    gather_linear_field<1>();
+    gather_linear_field<2>();
+    gather_linear_field<3>();
+    deposit_conserves_weight<1>();
+    deposit_conserves_weight<2>();
+    deposit_conserves_weight<3>();
+}
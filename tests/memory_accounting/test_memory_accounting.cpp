@@ -0,0 +1,105 @@
+#include "simulation.hpp"
+#include "memory_accounting.hpp"
+
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+
+
+// fields and particle arrays are counted under their subsystem while they live, in the
+// accounting in use, named arrays under their population too, scopes for as long as they
+// last, and peaks remember the largest footprint
+void allocations_are_counted()
+{
+    std::cout << "Running allocations_are_counted test...\n";
+    auto const global = MemoryAccounting::instance().current();
+    MemoryAccounting accounting;
+    MemoryAccounting::Use const use{accounting};
+    std::size_t const big = 3 * huge_page_bytes / sizeof(double) + 7;
+
+    {
+        Field<1> small{{10}, Quantity::N};
+        Field<1> large{{big}, Quantity::N};
+        ParticleArray<1> array(ParticleArray<1>::allocator_type{"protons"});
+        array.resize(1000);
+        auto const expected
+            = allocated_bytes(10 * sizeof(double)) + allocated_bytes(big * sizeof(double));
+        auto const particles = allocated_bytes(1000 * sizeof(Particle<1>));
+        if (accounting.current(Subsystem::fields) != expected
+            or accounting.current(Subsystem::particles) != particles)
+            throw std::runtime_error("fields or particles are not counted");
+        if (accounting.current("protons") != particles)
+            throw std::runtime_error("particles are not counted under their population");
+        if (accounting.peak(Subsystem::fields) < expected)
+            throw std::runtime_error("the peak is below the current bytes");
+        if (MemoryAccounting::instance().current() != global)
+            throw std::runtime_error("memory is counted outside of the accounting in use");
+    }
+    if (accounting.current(Subsystem::fields) != 0 or accounting.current(Subsystem::particles) != 0
+        or accounting.current("protons") != 0)
+        throw std::runtime_error("released memory is still counted");
+
+    auto const total = accounting.current();
+    accounting.reset_peaks();
+    {
+        MemoryScope const staging{Subsystem::diagnostics, 12345};
+        if (accounting.current(Subsystem::diagnostics) != 12345)
+            throw std::runtime_error("a scope is not counted");
+    }
+    if (accounting.current(Subsystem::diagnostics) != 0 or accounting.peak() != total + 12345)
+        throw std::runtime_error("a scope is not released or missed the peak");
+    accounting.print();
+}
+
+
+// the estimate from the parameters alone is what a simulation then allocates, with or
+// without the moments of each population, and each simulation counts only its own memory
+void estimate_matches_the_simulation(bool single_pass_moments)
+{
+    std::cout << "Running estimate_matches_the_simulation test, single pass "
+              << single_pass_moments << "...\n";
+    SimulationParameters params;
+    params.nbr_cells           = 2000;
+    params.verbose             = false;
+    params.single_pass_moments = single_pass_moments;
+    params.filter.passes       = 2;
+    params.populations.resize(2);
+    params.populations[0].nppc = 100;
+    params.populations[1].name = "alphas";
+    params.populations[1].nppc = 20;
+
+    auto const estimate = memory_estimate(params);
+
+    Simulation<1, Boris<1>, PeriodicBoundaryCondition<1>> simulation{params};
+    auto const& accounting = simulation.memory();
+    if (accounting.current(Subsystem::fields) != estimate[Subsystem::fields])
+        throw std::runtime_error("wrong estimate of the fields");
+    if (accounting.current(Subsystem::particles) != estimate[Subsystem::particles])
+        throw std::runtime_error("wrong estimate of the particles");
+    if (accounting.current(Subsystem::diagnostics) != estimate.resident_diagnostics)
+        throw std::runtime_error("wrong estimate of the spectral store");
+
+    std::size_t per_population = 0;
+    for (auto const& pop : params.populations)
+        per_population += accounting.current(pop.name);
+    if (per_population != accounting.current(Subsystem::particles))
+        throw std::runtime_error("the populations do not add up to the particles");
+
+    {
+        Simulation<1, Boris<1>, PeriodicBoundaryCondition<1>> other{params};
+        if (accounting.current() != other.memory().current())
+            throw std::runtime_error("two simulations count each other's memory");
+    }
+    for (auto const& pop : simulation.populations())
+        if (pop.has_moments() == single_pass_moments)
+            throw std::runtime_error("populations hold moments only without the single pass");
+    estimate.print();
+}
+
+
+int main()
+{
+    allocations_are_counted();
+    estimate_matches_the_simulation(false);
+    estimate_matches_the_simulation(true);
+}
@@ -0,0 +1,104 @@
+#include "moments.hpp"
+#include "boundary_condition.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+
+std::size_t constexpr dimension = 1;
+std::size_t constexpr nbr_cells = 32;
+double constexpr cell_size      = 0.25;
+
+
+auto make_layout()
+{
+    return std::make_shared<GridLayout<dimension>>(std::array<std::size_t, dimension>{nbr_cells},
+                                                   std::array<double, dimension>{cell_size}, 1);
+}
+
+
+// a drifting full f population and a delta f one: the single pass gives the sum of the
+// densities of the populations, and the sum of their fluxes divided by it
+void single_pass_sums_the_populations()
+{
+    std::cout << "Running single_pass_sums_the_populations test...\n";
+    auto const layout = make_layout();
+    PeriodicBoundaryCondition<dimension> boundary_condition{layout};
+
+    std::vector<Population<dimension>> populations;
+    populations.emplace_back("protons", layout);
+    populations.emplace_back("alphas", layout);
+    populations[0].load_particles(50, [](double x) { return 1. + 0.5 * std::sin(x); },
+                                  {0.2, -0.1, 0.05}, {0.3, 0.3, 0.3});
+    populations[1].load_delta_f(20, Maxwellian{0.5, {-0.3, 0., 0.1}, {0.2, 0.2, 0.2}},
+                                [](double x) { return 0.1 * std::cos(x); }, 4., 2.);
+
+    Field<dimension> N{layout->allocate(Quantity::N), Quantity::N};
+    VecField<dimension> V{layout, {Quantity::Vx, Quantity::Vy, Quantity::Vz}};
+    accumulate_moments(populations, N, V);
+    boundary_condition.fill_all(V, N);
+    for (auto const& pop : populations)
+        pop.add_background(N, V);
+    finalize_moments(N, V);
+
+    for (auto& pop : populations)
+    {
+        pop.deposit();
+        boundary_condition.fill_all(pop.flux(), pop.density());
+        pop.add_background();
+    }
+
+    for (std::size_t ix = 0; ix < N.size(); ++ix)
+    {
+        double density = 0.;
+        std::array<double, 3> flux{};
+        for (auto const& pop : populations)
+        {
+            density += pop.density()(ix);
+            flux[0] += pop.flux().x(ix);
+            flux[1] += pop.flux().y(ix);
+            flux[2] += pop.flux().z(ix);
+        }
+
+        auto const tolerance = 1e-12 * std::max(1., density);
+        if (std::abs(N(ix) - density) > tolerance)
+            throw std::runtime_error("the single pass density is not the sum of the populations");
+        if (std::abs(N(ix) * V.x(ix) - flux[0]) > tolerance
+            or std::abs(N(ix) * V.y(ix) - flux[1]) > tolerance
+            or std::abs(N(ix) * V.z(ix) - flux[2]) > tolerance)
+            throw std::runtime_error("the single pass velocity is not the total flux over N");
+    }
+}
+
+
+// nodes without plasma get a zero velocity rather than a division by zero
+void empty_nodes_have_no_velocity()
+{
+    std::cout << "Running empty_nodes_have_no_velocity test...\n";
+    auto const layout = make_layout();
+    std::vector<Population<dimension>> populations;
+    populations.emplace_back("protons", layout);
+    populations[0].load_particles(10, [](double x) { return x < 4. ? 1. : 0.; }, {0.5, 0., 0.});
+
+    Field<dimension> N{layout->allocate(Quantity::N), Quantity::N};
+    VecField<dimension> V{layout, {Quantity::Vx, Quantity::Vy, Quantity::Vz}};
+    accumulate_moments(populations, N, V);
+    finalize_moments(N, V);
+
+    for (std::size_t ix = 0; ix < N.size(); ++ix)
+        if (!std::isfinite(V.x(ix)) or (N(ix) == 0. and V.x(ix) != 0.))
+            throw std::runtime_error("empty nodes must have a zero velocity");
+}
+
+
+int main()
+{
+    single_pass_sums_the_populations();
+    empty_nodes_have_no_velocity();
+}
@@ -0,0 +1,125 @@
+#include "moving_window.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+
+std::size_t constexpr dimension = 1;
+std::size_t constexpr nbr_cells = 32;
+double constexpr cell_size      = 0.5;
+std::size_t constexpr nppc      = 10;
+
+
+auto make_layout()
+{
+    return std::make_shared<GridLayout<dimension>>(std::array<std::size_t, dimension>{nbr_cells},
+                                                   std::array<double, dimension>{cell_size}, 1);
+}
+
+
+// the window moves by whole cells, and the shifted and the new nodes both hold the profile
+// at their lab position; a field without profile extends its last node
+void fields_follow_the_window()
+{
+    std::cout << "Running fields_follow_the_window test...\n";
+    auto const layout  = make_layout();
+    Profile const wave = [](double x) { return std::sin(0.3 * x); };
+
+    for (double const velocity : {0.7, -0.7})
+    {
+        MovingWindow<dimension> window{layout, velocity};
+        Field<dimension> by{layout->allocate(Quantity::By), Quantity::By};
+        Field<dimension> ex{layout->allocate(Quantity::Ex), Quantity::Ex};
+        auto const size = layout->allocate(Quantity::By)[0];
+        for (auto ix = 0u; ix < size; ++ix)
+        {
+            by(ix) = wave(layout->coordinate(Direction::X, Quantity::By, ix));
+            ex(ix) = 1.;
+        }
+
+        double const dt   = 0.3;
+        std::size_t moved = 0;
+        for (int iStep = 1; iStep <= 20; ++iStep)
+        {
+            auto const cells = window.advance(dt);
+            window.shift(by, cells, wave);
+            window.shift(ex, cells);
+            moved += cells;
+
+            auto const expected = std::floor(0.7 * iStep * dt / cell_size + 1e-12);
+            auto const offset   = (velocity > 0. ? 1. : -1.) * moved * cell_size;
+            if (moved != expected or window.offset() != offset)
+                throw std::runtime_error("the window did not move by whole cells");
+        }
+        for (auto ix = 0u; ix < size; ++ix)
+        {
+            auto const x = window.offset() + layout->coordinate(Direction::X, Quantity::By, ix);
+            if (std::abs(by(ix) - wave(x)) > 1e-12 or ex(ix) != 1.)
+                throw std::runtime_error("shifted fields do not follow the window");
+        }
+    }
+}
+
+
+// particles behind the window are dropped, the ones left move by the shift and keep their
+// order, and the new cells get the plasma of the profile: twice as dense past the initial box
+void particles_are_replaced()
+{
+    std::cout << "Running particles_are_replaced test...\n";
+    auto const layout     = make_layout();
+    auto const length     = layout->dom_size(Direction::X);
+    Profile const density = [length](double x) { return x < length ? 1. : 2.; };
+
+    MovingWindow<dimension> window{layout, 1., 42};
+    window.add_plasma({"protons", nppc, density, {0.1, 0., 0.}, {0.2, 0.2, 0.2}});
+    Population<dimension> population{"protons", layout};
+    population.load_particles(nppc, density);
+
+    auto& particles = population.particles();
+    std::map<std::size_t, double> initial;
+    for (auto const& particle : particles)
+        initial[particle.id] = particle.position[0];
+
+    std::size_t moved = 0;
+    for (int iStep = 0; iStep < 4; ++iStep)
+    {
+        auto const cells = window.advance(0.6);
+        window.shift(population, cells);
+        moved += cells;
+    }
+    if (moved != 4)
+        throw std::runtime_error("the window moved by a wrong number of cells");
+
+    if (particles.size() != nbr_cells * nppc)
+        throw std::runtime_error("the window changed the number of particles");
+    for (std::size_t iPart = 0; iPart < particles.size(); ++iPart)
+    {
+        auto const& particle = particles[iPart];
+        auto const x         = particle.position[0];
+        if (x < 0. or x >= length or (iPart > 0 and particle.id <= particles[iPart - 1].id))
+            throw std::runtime_error("particles out of the window or out of order");
+
+        auto const old = initial.find(particle.id);
+        if (old != initial.end())
+        {
+            if (std::abs(x - (old->second - moved * cell_size)) > 1e-12
+                or particle.weight != 1. / nppc)
+                throw std::runtime_error("a particle did not move with the window");
+        }
+        else if (x < length - moved * cell_size or particle.weight != 2. / nppc)
+            throw std::runtime_error("injected particles do not follow the profile");
+    }
+}
+
+
+int main()
+{
+    fields_follow_the_window();
+    particles_are_replaced();
+}
@@ -0,0 +1,207 @@
+#include "mpi_domain.hpp"
+#include "boundary_condition.hpp"
+#include "interpolator.hpp"
+
+#include <mpi.h>
+
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <numbers>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+
+std::size_t constexpr dimension = 1;
+std::size_t constexpr nbr_cells = 42; // not a multiple of 4, ranks differ in size
+double constexpr cell_size      = 0.2;
+
+
+std::vector<Particle<dimension>> global_particles()
+{
+    std::mt19937_64 generator{2024};
+    std::uniform_real_distribution<> uniform{0., nbr_cells * cell_size};
+    std::vector<Particle<dimension>> particles(5000);
+    for (auto& particle : particles)
+    {
+        particle.position[0] = uniform(generator);
+        particle.weight      = uniform(generator);
+    }
+    return particles;
+}
+
+
+// cubic weighting of the particle weights on the primal nodes, it spills over the ghosts
+// that the fill must fold back across the ranks
+void deposit(std::vector<Particle<dimension>> const& particles, GridLayout<dimension> const& layout,
+             Field<dimension>& N)
+{
+    for (auto const& particle : particles)
+    {
+        auto const stencil = Shape<3>::at(node_position(layout, Quantity::N, particle.position[0]));
+        for (std::size_t point = 0; point < Shape<3>::nbr_points; ++point)
+            N(stencil.first + point) += particle.weight * stencil.weights[point];
+    }
+}
+
+
+// the moments of particles spread over the ranks must be those of a single rank
+void moments_match_single_rank(std::shared_ptr<MPIDomain<dimension>> const& domain)
+{
+    if (domain->rank() == 0)
+        std::cout << "Running moments_match_single_rank test...\n";
+
+    auto const& global_layout = domain->global_layout();
+    auto const& layout        = domain->layout();
+    auto const particles      = global_particles();
+
+    Field<dimension> global_N{global_layout->allocate(Quantity::N), Quantity::N};
+    deposit(particles, *global_layout, global_N);
+    PeriodicBoundaryCondition<dimension>{global_layout}.fill(global_N);
+
+    std::vector<Particle<dimension>> local_particles;
+    auto const origin = domain->origin();
+    for (auto particle : particles)
+    {
+        particle.position[0] -= origin;
+        if (particle.position[0] >= 0. and particle.position[0] < layout->dom_size(Direction::X))
+            local_particles.push_back(particle);
+    }
+    Field<dimension> N{layout->allocate(Quantity::N), Quantity::N};
+    deposit(local_particles, *layout, N);
+    MPIBoundaryCondition<dimension>{domain}.fill(N);
+
+    // local and global layouts have the same ghosts, node ix is global node first + ix
+    auto const first = domain->first_cell(domain->rank());
+    for (auto ix = layout->dom_start(Quantity::N, Direction::X);
+         ix <= layout->dom_end(Quantity::N, Direction::X); ++ix)
+    {
+        auto const expected = global_N(first + ix);
+        if (std::abs(N(ix) - expected) > 1e-12 * std::abs(expected))
+            throw std::runtime_error("moments differ from the single rank run");
+    }
+}
+
+
+// ghosts of continuous fields hold the neighbour values, and gather rebuilds the domain
+void fields_and_gather(std::shared_ptr<MPIDomain<dimension>> const& domain)
+{
+    if (domain->rank() == 0)
+        std::cout << "Running fields_and_gather test...\n";
+
+    auto const& layout      = *domain->layout();
+    auto const total_length = nbr_cells * cell_size;
+    auto const profile      = [&](double x) {
+        return std::sin(2 * std::numbers::pi * x / total_length);
+    };
+
+    VecField<dimension> E{domain->layout(), {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
+    for (auto* component : {&E.x, &E.y, &E.z})
+    {
+        auto const qty = component->quantity();
+        for (auto ix = layout.dom_start(qty, Direction::X); ix <= layout.dom_end(qty, Direction::X);
+             ++ix)
+            (*component)(ix) = profile(domain->origin() + layout.coordinate(Direction::X, qty, ix));
+    }
+
+    MPIBoundaryCondition<dimension>{domain}.fill(E);
+
+    for (auto const* component : {&E.x, &E.y, &E.z})
+    {
+        auto const qty = component->quantity();
+        for (auto ix = 0u; ix < layout.allocate(qty)[0]; ++ix)
+        {
+            auto const x = domain->origin() + layout.coordinate(Direction::X, qty, ix);
+            if (std::abs((*component)(ix) - profile(x)) > 1e-12)
+                throw std::runtime_error("ghost does not match the neighbour rank");
+        }
+    }
+
+    VecField<dimension> global_E{domain->global_layout(),
+                                 {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
+    domain->gather(E, global_E);
+    if (domain->rank() == 0)
+    {
+        auto const& global_layout = *domain->global_layout();
+        for (auto const* component : {&global_E.x, &global_E.y, &global_E.z})
+        {
+            auto const qty = component->quantity();
+            for (auto ix = global_layout.dom_start(qty, Direction::X);
+                 ix <= global_layout.dom_end(qty, Direction::X); ++ix)
+            {
+                auto const x = global_layout.coordinate(Direction::X, qty, ix);
+                if (std::abs((*component)(ix) - profile(x)) > 1e-12)
+                    throw std::runtime_error("gathered field does not match the profile");
+            }
+        }
+    }
+}
+
+
+// particles leaving a rank arrive in the neighbour, none is lost, and all keep the ids of
+// the rank that created them, which no other rank hands out
+void migration(std::shared_ptr<MPIDomain<dimension>> const& domain)
+{
+    if (domain->rank() == 0)
+        std::cout << "Running migration test...\n";
+
+    auto const length     = domain->layout()->dom_size(Direction::X);
+    auto const ids        = domain->particle_ids();
+    auto const ids_stride = static_cast<std::size_t>(domain->size());
+    ParticleArray<dimension> particles(1000);
+    double sum = 0.;
+    for (std::size_t iPart = 0; iPart < particles.size(); ++iPart)
+    {
+        particles[iPart].id = ids->next();
+        // half goes one cell left, half one cell right of the rank
+        auto& x = particles[iPart].position[0];
+        x       = (iPart % 2 == 0 ? -0.5 : length + 0.5) * cell_size;
+        auto const total_length = nbr_cells * cell_size;
+        sum += std::fmod(domain->origin() + x + total_length, total_length);
+    }
+
+    MPIBoundaryCondition<dimension> boundary_condition{domain};
+    boundary_condition.particles(particles);
+
+    double local_sum = 0.;
+    for (auto const& particle : particles)
+    {
+        if (particle.position[0] < 0. or particle.position[0] >= length)
+            throw std::runtime_error("particle outside of its rank after migration");
+        auto const from = static_cast<int>(particle.id % ids_stride);
+        if (from != domain->rank() and from != domain->left() and from != domain->right())
+            throw std::runtime_error("particle ids do not tell the rank that created them");
+        local_sum += domain->origin() + particle.position[0];
+    }
+
+    std::array<double, 2> local{static_cast<double>(particles.size()), local_sum - sum};
+    std::array<double, 2> total{0., 0.};
+    MPI_Allreduce(local.data(), total.data(), 2, MPI_DOUBLE, MPI_SUM, domain->comm());
+    if (total[0] != 1000. * domain->size() or std::abs(total[1]) > 1e-8)
+        throw std::runtime_error("particles lost or misplaced by the migration");
+}
+
+
+int main(int argc, char** argv)
+{
+    MPI_Init(&argc, &argv);
+    int status = 0;
+    try
+    {
+        auto domain = std::make_shared<MPIDomain<dimension>>(nbr_cells, cell_size,
+                                                             Shape<3>::nbr_ghosts);
+        moments_match_single_rank(domain);
+        fields_and_gather(domain);
+        migration(domain);
+    }
+    catch (std::exception const& error)
+    {
+        std::cerr << error.what() << "\n";
+        status = 1;
+        MPI_Abort(MPI_COMM_WORLD, status);
+    }
+    MPI_Finalize();
+    return status;
+}
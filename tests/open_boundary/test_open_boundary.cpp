@@ -0,0 +1,110 @@
+#include "boundary_condition.hpp"
+#include "population.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+
+std::shared_ptr<GridLayout<1>> make_layout()
+{
+    std::array<std::size_t, 1> grid_size = {10};
+    std::array<double, 1> cell_size      = {0.2};
+    return std::make_shared<GridLayout<1>>(grid_size, cell_size, 1);
+}
+
+
+// leaving particles are removed, the others keep their order and stay tracked
+void outflow()
+{
+    std::cout << "Running outflow test...\n";
+    auto layout = make_layout();
+    Population<1> population{"protons", layout};
+    population.load_particles(2, [](double) { return 1.0; });
+    population.track([](auto const&) { return true; });
+
+    auto& particles = population.particles();
+    auto const size = particles.size();
+    particles[0].position[0]        = -0.1;
+    particles[3].position[0]        = 2.5;
+    particles[size - 1].position[0] = 2.0;
+
+    OpenBoundaryCondition<1> boundary_condition{layout};
+    boundary_condition.particles(population);
+
+    if (particles.size() != size - 3)
+        throw std::runtime_error("leaving particles were not removed");
+    for (std::size_t iPart = 1; iPart < particles.size(); ++iPart)
+        if (particles[iPart].id <= particles[iPart - 1].id)
+            throw std::runtime_error("compaction must keep the particles order");
+
+    population.update_tracked();
+    auto const& tracked = population.tracked();
+    for (std::size_t iTrack = 0; iTrack < tracked.size(); ++iTrack)
+    {
+        bool const left = iTrack == 0 or iTrack == 3 or iTrack == size - 1;
+        if (left != (tracked[iTrack] == Population<1>::lost_particle))
+            throw std::runtime_error("tracked particles not followed through the compaction");
+        if (!left and particles[tracked[iTrack]].id != iTrack)
+            throw std::runtime_error("tracked index points to the wrong particle");
+    }
+}
+
+
+// particles drifting at v through the left side: about nppc * v dt / dx enter per step
+void inflow()
+{
+    std::cout << "Running inflow test...\n";
+    auto layout         = make_layout();
+    double constexpr dt = 0.1;
+    Population<1> population{"protons", layout};
+
+    OpenBoundaryCondition<1> boundary_condition{layout, dt, 12345};
+    boundary_condition.add_inflow(
+        {"protons", Inflow::Side::left, 1000, 2.0, {1.0, 0., 0.}, {0.01, 0.01, 0.01}});
+    boundary_condition.add_inflow(
+        {"alphas", Inflow::Side::right, 1000, 2.0, {-1.0, 0., 0.}, {0.01, 0.01, 0.01}});
+    boundary_condition.particles(population);
+
+    auto const& particles = population.particles();
+    if (particles.size() < 450 or particles.size() > 550)
+        throw std::runtime_error("wrong number of injected particles");
+    for (auto const& particle : particles)
+        if (particle.position[0] < 0. or particle.position[0] > 1.1 * dt
+            or std::abs(particle.weight - 2.0 / 1000) > 1e-15)
+            throw std::runtime_error("injected particle at the wrong place or weight");
+}
+
+
+// a uniform box is uniform up to its edges once the deposit on the ghosts is folded back
+void edge_density()
+{
+    std::cout << "Running edge_density test...\n";
+    auto layout = std::make_shared<GridLayout<1>>(std::array<std::size_t, 1>{10},
+                                                  std::array<double, 1>{0.2},
+                                                  Shape<interp_order>::nbr_ghosts);
+    Population<1> population{"protons", layout};
+    population.load_particles(100, [](double) { return 1.0; });
+    population.deposit();
+
+    OpenBoundaryCondition<1> boundary_condition{layout};
+    boundary_condition.fill(population.density());
+
+    auto const& density   = population.density();
+    std::size_t const gei = layout->ghost_end(Quantity::N, Direction::X);
+    for (std::size_t ix = 0; ix <= gei; ++ix)
+        if (std::abs(density(ix) - 1.0) > 1e-12)
+            throw std::runtime_error("density of a uniform box is " + std::to_string(density(ix))
+                                     + " at node " + std::to_string(ix));
+}
+
+
+int main()
+{
+    outflow();
+    inflow();
+    edge_density();
+}
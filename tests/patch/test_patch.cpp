@@ -0,0 +1,397 @@
+#include "patch.hpp"
+#include "boundary_condition.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <numbers>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+
+std::size_t constexpr dimension = 1;
+std::size_t constexpr nbr_cells = 40;
+double constexpr cell_size      = 0.2;
+
+
+std::vector<Quantity> quantities()
+{
+    return {Quantity::Ex, Quantity::Ey, Quantity::Ez, Quantity::Bx, Quantity::By,
+            Quantity::Bz, Quantity::Jx, Quantity::Jy, Quantity::Jz, Quantity::N,
+            Quantity::Vx, Quantity::Vy, Quantity::Vz};
+}
+
+
+Field<dimension>& field_of(Patch<dimension>& patch, Quantity qty)
+{
+    switch (qty)
+    {
+        case Quantity::Ex: return patch.E.x;
+        case Quantity::Ey: return patch.E.y;
+        case Quantity::Ez: return patch.E.z;
+        case Quantity::Bx: return patch.B.x;
+        case Quantity::By: return patch.B.y;
+        case Quantity::Bz: return patch.B.z;
+        case Quantity::Jx: return patch.J.x;
+        case Quantity::Jy: return patch.J.y;
+        case Quantity::Jz: return patch.J.z;
+        case Quantity::N: return patch.N;
+        case Quantity::Vx: return patch.V.x;
+        case Quantity::Vy: return patch.V.y;
+        default: return patch.V.z;
+    }
+}
+
+
+// a single patch must do exactly what the periodic boundary condition does
+void one_patch_is_periodic()
+{
+    std::cout << "Running one_patch_is_periodic test...\n";
+    PatchLevel<dimension> level{nbr_cells, cell_size, 2, 1, {}};
+    PeriodicBoundaryCondition<dimension> boundary_condition{level.patches()[0].layout};
+
+    std::mt19937_64 generator{42};
+    std::uniform_real_distribution<> uniform{-1., 1.};
+
+    for (auto qty : quantities())
+    {
+        auto& field = field_of(level.patches()[0], qty);
+        for (auto& node : field)
+            node = uniform(generator);
+        auto expected = field;
+
+        boundary_condition.fill(expected);
+        level.fill_ghosts([qty](auto& patch) -> auto& { return field_of(patch, qty); });
+
+        for (auto ix = 0u; ix < level.patches()[0].layout->allocate(qty)[0]; ++ix)
+            if (field(ix) != expected(ix))
+                throw std::runtime_error("one patch differs from the periodic boundary condition");
+    }
+}
+
+
+// sets the domain nodes of every patch to profile(global x)
+void set_profile(PatchLevel<dimension>& level, Quantity qty, auto const& profile)
+{
+    for (auto& patch : level.patches())
+    {
+        auto const& layout = *patch.layout;
+        for (auto ix = layout.dom_start(qty, Direction::X); ix <= layout.dom_end(qty, Direction::X);
+             ++ix)
+            field_of(patch, qty)(ix)
+                = profile(patch.origin[0] + layout.coordinate(Direction::X, qty, ix));
+    }
+}
+
+
+// every node of every patch, ghosts included, must hold profile(global x)
+void check_profile(PatchLevel<dimension>& level, Quantity qty, auto const& profile)
+{
+    for (auto& patch : level.patches())
+    {
+        auto const& layout = *patch.layout;
+        for (auto ix = 0u; ix < layout.allocate(qty)[0]; ++ix)
+        {
+            auto const x = patch.origin[0] + layout.coordinate(Direction::X, qty, ix);
+            if (std::abs(field_of(patch, qty)(ix) - profile(x)) > 1e-12)
+                throw std::runtime_error("patch node does not match the profile");
+        }
+    }
+}
+
+
+// ghosts of fields continuous across patches must hold the values of the neighbours,
+// here with patches of 11, 11, 10 and 10 cells
+void ghosts_match_neighbours()
+{
+    std::cout << "Running ghosts_match_neighbours test...\n";
+    PatchLevel<dimension> level{nbr_cells + 2, cell_size, 2, 4, {}};
+    auto const total_length = (nbr_cells + 2) * cell_size;
+    auto const profile      = [&](double x) {
+        return std::sin(2 * std::numbers::pi * x / total_length);
+    };
+
+    for (auto qty : {Quantity::Ex, Quantity::Ey, Quantity::Bx, Quantity::By})
+    {
+        set_profile(level, qty, profile);
+        level.fill_ghosts([qty](auto& patch) -> auto& { return field_of(patch, qty); });
+        check_profile(level, qty, profile);
+    }
+}
+
+
+// moments deposited with a cubic shape on patches of 11, 11, 10 and 10 cells must match
+// those of the whole domain, ghosts folded across the patches
+void moments_match_whole_domain()
+{
+    std::cout << "Running moments_match_whole_domain test...\n";
+    auto constexpr nbr_ghosts = Shape<3>::nbr_ghosts;
+    PatchLevel<dimension> level{nbr_cells + 2, cell_size, nbr_ghosts, 4, {"protons"}};
+    auto const layout = std::make_shared<GridLayout<dimension>>(
+        std::array<std::size_t, dimension>{nbr_cells + 2},
+        std::array<double, dimension>{cell_size}, nbr_ghosts);
+
+    std::mt19937_64 generator{7};
+    std::uniform_real_distribution<> uniform{0., layout->dom_size(Direction::X)};
+    Population<dimension> whole{"protons", layout};
+    for (int iPart = 0; iPart < 2000; ++iPart)
+    {
+        Particle<dimension> particle{};
+        particle.position[0] = uniform(generator);
+        particle.weight      = 1. + particle.position[0];
+        whole.particles().push_back(particle);
+
+        for (auto& patch : level.patches())
+            if (particle.position[0] >= patch.origin[0]
+                and particle.position[0] < patch.origin[0] + level.length(patch))
+            {
+                particle.position[0] -= patch.origin[0];
+                patch.populations[0].particles().push_back(particle);
+                break;
+            }
+    }
+
+    whole.deposit<3>();
+    PeriodicBoundaryCondition<dimension>{layout}.fill(whole.density());
+    level.for_each_patch([](auto& patch) { patch.populations[0].template deposit<3>(); });
+    level.fill_ghosts([](auto& patch) -> auto& { return patch.populations[0].density(); });
+
+    // both layouts have the same ghosts, patch node ix is node first_cell + ix of the domain
+    for (auto& patch : level.patches())
+        for (auto ix = 0u; ix < patch.layout->allocate(Quantity::N)[0]; ++ix)
+        {
+            auto const expected = whole.density()(patch.first_cell + ix);
+            if (std::abs(patch.populations[0].density()(ix) - expected) > 1e-12 * expected)
+                throw std::runtime_error("patch moments differ from the whole domain");
+        }
+}
+
+
+// particles leaving a patch end up in the neighbour, at the same global position, with ids
+// unique over the level. Tracked particles that stay are found again among the particles
+// appended out of order by the neighbours.
+void migration()
+{
+    std::cout << "Running migration test...\n";
+    PatchLevel<dimension> level{nbr_cells, cell_size, 1, 4, {"protons"}};
+    level.load_particles(0, 10, [](double) { return 1.0; });
+
+    auto const tracked_id = [](auto const& particle) { return particle.id % 3 == 0; };
+    std::vector<std::set<std::size_t>> loaded_ids;
+    for (auto& patch : level.patches())
+    {
+        auto& population = patch.populations[0];
+        population.track(tracked_id);
+        auto& ids = loaded_ids.emplace_back();
+        for (auto const& particle : population.particles())
+            ids.insert(particle.id);
+    }
+
+    auto const total_length = nbr_cells * cell_size;
+    auto const shift        = 0.7 * level.length(level.patches()[0]);
+    auto const wrap = [&](double x) { return std::fmod(x + 2 * total_length, total_length); };
+
+    std::size_t nbr_particles = 0;
+    double expected_sum       = 0.;
+    for (auto& patch : level.patches())
+        for (auto& particle : patch.populations[0].particles())
+        {
+            particle.position[0] += (particle.id % 2 == 0 ? shift : -shift);
+            expected_sum += wrap(patch.origin[0] + particle.position[0]);
+            ++nbr_particles;
+        }
+
+    level.migrate_particles();
+
+    std::size_t migrated = 0;
+    double sum           = 0.;
+    for (auto const& patch : level.patches())
+        for (auto const& particle : patch.populations[0].particles())
+        {
+            if (particle.position[0] < 0. or particle.position[0] >= level.length(patch))
+                throw std::runtime_error("particle outside of its patch after migration");
+            sum += patch.origin[0] + particle.position[0];
+            ++migrated;
+        }
+
+    if (migrated != nbr_particles or std::abs(sum - expected_sum) > 1e-9 * expected_sum)
+        throw std::runtime_error("particles lost or misplaced by the migration");
+
+    std::set<std::size_t> ids;
+    for (auto& patch : level.patches())
+    {
+        auto& population            = patch.populations[0];
+        auto const& stays           = loaded_ids[patch.index];
+        std::size_t staying_tracked = 0;
+        for (auto const& particle : population.particles())
+        {
+            if (!ids.insert(particle.id).second)
+                throw std::runtime_error("particle ids are not unique over the patches");
+            staying_tracked += tracked_id(particle) and stays.count(particle.id) > 0;
+        }
+
+        population.update_tracked();
+        std::size_t found = 0;
+        for (auto const iPart : population.tracked())
+        {
+            if (iPart == Population<dimension>::lost_particle)
+                continue;
+            auto const id = population.particles()[iPart].id;
+            if (!tracked_id(population.particles()[iPart]) or stays.count(id) == 0)
+                throw std::runtime_error("tracked index points to the wrong particle");
+            ++found;
+        }
+        if (found != staying_tracked)
+            throw std::runtime_error("tracked particles not found after the migration");
+    }
+}
+
+
+// cuts must follow the cost and leave at least min_size items per part
+void partition()
+{
+    std::cout << "Running partition test...\n";
+
+    auto const even = partition_by_cost(std::vector<double>(12, 1.), 3, 2);
+    if (even != std::vector<std::size_t>{4, 4, 4})
+        throw std::runtime_error("uniform costs must give equal parts");
+
+    // all the cost in the first 4 items, one part each, the rest goes to the last part
+    std::vector<double> costs(20, 0.);
+    for (std::size_t iItem = 0; iItem < 4; ++iItem)
+        costs[iItem] = 1.;
+    auto const crowded = partition_by_cost(costs, 4, 1);
+    if (crowded != std::vector<std::size_t>{1, 1, 1, 17})
+        throw std::runtime_error("parts must share the cost, not the items");
+
+    auto const bounded = partition_by_cost(costs, 4, 3);
+    if (bounded != std::vector<std::size_t>{3, 3, 3, 11})
+        throw std::runtime_error("parts must hold at least min_size items");
+}
+
+
+// balancing a level where one patch holds most of the particles must even the particle
+// counts out while keeping every particle and every field value where it was
+void balance()
+{
+    std::cout << "Running balance test...\n";
+    PatchLevel<dimension> level{nbr_cells, cell_size, 1, 4, {"protons"}};
+    level.load_particles(0, 10, [](double) { return 1.0; });
+    level.patches()[0].populations[0].load_particles(50, [](double) { return 1.0; });
+
+    auto const total_length = nbr_cells * cell_size;
+    auto const profile      = [&](double x) {
+        return std::cos(2 * std::numbers::pi * x / total_length);
+    };
+    for (auto qty : quantities())
+    {
+        set_profile(level, qty, profile);
+        level.fill_ghosts([qty](auto& patch) -> auto& { return field_of(patch, qty); });
+    }
+
+    // ignore the time spent loading, costs then are the particle counts
+    for (auto& patch : level.patches())
+        patch.cost = 0.;
+
+    auto const particle_imbalance = [&]() {
+        std::size_t max = 0, total = 0;
+        for (auto const& patch : level.patches())
+        {
+            max = std::max(max, patch.nbr_particles());
+            total += patch.nbr_particles();
+        }
+        return static_cast<double>(max * level.size()) / total;
+    };
+    auto const positions = [&]() {
+        std::size_t count = 0;
+        double sum        = 0.;
+        for (auto const& patch : level.patches())
+            for (auto const& particle : patch.populations[0].particles())
+            {
+                if (particle.position[0] < 0. or particle.position[0] >= level.length(patch))
+                    throw std::runtime_error("particle outside of its patch");
+                sum += patch.origin[0] + particle.position[0];
+                ++count;
+            }
+        return std::pair{count, sum};
+    };
+
+    auto const before           = positions();
+    auto const imbalance_before = particle_imbalance();
+    if (std::abs(level.imbalance() - imbalance_before) > 1e-12)
+        throw std::runtime_error("unmeasured costs must be the particle counts");
+
+    if (!level.balance())
+        throw std::runtime_error("balance did not move the patches");
+
+    auto const after = positions();
+    if (after.first != before.first
+        or std::abs(after.second - before.second) > 1e-9 * before.second)
+        throw std::runtime_error("particles lost or misplaced by the balance");
+    if (particle_imbalance() > 1.3 or particle_imbalance() >= imbalance_before)
+        throw std::runtime_error("balance did not even the particle counts out");
+
+    for (auto qty : quantities())
+        if (qty != Quantity::N and qty != Quantity::Vx and qty != Quantity::Vy
+            and qty != Quantity::Vz)
+            check_profile(level, qty, profile);
+}
+
+
+// particles tracked over the level are followed through the migrations and the balances,
+// and gathered in the order of their ids at their position in the domain
+void tracking()
+{
+    std::cout << "Running tracking test...\n";
+    PatchLevel<dimension> level{nbr_cells, cell_size, 1, 4, {"protons"}};
+    level.load_particles(0, 10, [](double) { return 1.0; });
+    level.patches()[0].populations[0].load_particles(50, [](double) { return 1.0; });
+    level.track(0, [](auto const& particle) { return particle.id % 7 == 0; });
+
+    auto const total_length = nbr_cells * cell_size;
+    auto const shift        = 0.7 * level.length(level.patches()[1]);
+    std::map<std::size_t, double> expected;
+    for (auto& patch : level.patches())
+        for (auto& particle : patch.populations[0].particles())
+        {
+            particle.position[0] += (particle.id % 2 == 0 ? shift : -shift);
+            auto const x          = patch.origin[0] + particle.position[0];
+            expected[particle.id] = std::fmod(x + total_length, total_length);
+        }
+
+    level.migrate_particles();
+    for (auto& patch : level.patches())
+        patch.cost = 0.;
+    if (!level.balance())
+        throw std::runtime_error("balance did not move the patches");
+
+    auto const ids       = level.tracked_ids(0);
+    auto const particles = level.tracked_particles(0);
+    if (ids.empty() or particles.size() != ids.size())
+        throw std::runtime_error("tracked particles not gathered over the patches");
+    for (std::size_t iTrack = 0; iTrack < ids.size(); ++iTrack)
+    {
+        auto const& particle = particles[iTrack];
+        if (ids[iTrack] % 7 != 0 or !particle or particle->id != ids[iTrack])
+            throw std::runtime_error("tracked particle lost by the migration or the balance");
+        if (std::abs(particle->position[0] - expected[particle->id]) > 1e-9)
+            throw std::runtime_error("tracked particle gathered at the wrong position");
+    }
+}
+
+
+int main()
+{
+    one_patch_is_periodic();
+    ghosts_match_neighbours();
+    moments_match_whole_domain();
+    migration();
+    partition();
+    balance();
+    tracking();
+}
@@ -0,0 +1,154 @@
+#include "population.hpp"
+#include "reduced_diagnostics.hpp"
+
+#include "highfive/highfive.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+std::size_t constexpr dimension = 1;
+std::size_t constexpr nbr_cells = 10;
+double constexpr cell_size      = 0.5;
+
+
+auto make_layout()
+{
+    return std::make_shared<GridLayout<dimension>>(std::array<std::size_t, dimension>{nbr_cells},
+                                                   std::array<double, dimension>{cell_size}, 1);
+}
+
+Particle<dimension> make_particle(double x, std::array<double, 3> v, double weight,
+                                  double mass = 1.0)
+{
+    return {{x}, v, weight, 0., mass, 1.0, 0};
+}
+
+bool close(double a, double b)
+{
+    return std::abs(a - b) < 1e-12;
+}
+
+
+// bins are [vmin + i dv, vmin + (i+1) dv[, particles at vmax or beyond are not counted
+void histogram_binning()
+{
+    std::cout << "Running histogram_binning test...\n";
+    VelocityHistogram fvx{"fvx", {0}, {4}, {-1.}, {1.}};
+    for (auto const [vx, weight] : std::vector<std::array<double, 2>>{
+             {-1.0, 1.}, {-0.9, 2.}, {-0.5, 4.}, {0.0, 8.}, {0.99, 16.}, {1.0, 32.}, {-1.5, 64.}})
+        fvx.add(make_particle(1., {vx, 0., 0.}, 1.), weight);
+
+    std::vector<double> const expected{3., 4., 8., 16.};
+    if (fvx.values() != expected)
+        throw std::runtime_error("wrong 1D histogram binning");
+
+    fvx.reset();
+    for (auto const value : fvx.values())
+        if (value != 0.)
+            throw std::runtime_error("reset must empty the histogram");
+
+    // row-major, vy varies fastest
+    VelocityHistogram fvxvy{"fvxvy", {0, 1}, {2, 3}, {-1., 0.}, {1., 3.}};
+    fvxvy.add(make_particle(1., {0.5, 2.5, 0.}, 1.), 1.);
+    fvxvy.add(make_particle(1., {-0.5, 0.5, 0.}, 1.), 2.);
+    fvxvy.add(make_particle(1., {0.5, 3.5, 0.}, 1.), 4.);
+    fvxvy.add(make_particle(1., {1.5, 0.5, 0.}, 1.), 8.);
+
+    std::vector<double> const expected_2d{2., 0., 0., 0., 0., 1.};
+    if (fvxvy.values() != expected_2d)
+        throw std::runtime_error("wrong 2D histogram binning");
+}
+
+
+// a spatial window counts the particles in [xmin, xmax[ only
+void histogram_window()
+{
+    std::cout << "Running histogram_window test...\n";
+    VelocityHistogram fvx{"fvx", {0}, {2}, {-1.}, {1.}, std::array<double, 2>{1., 2.}};
+    fvx.add(make_particle(0.5, {0.5, 0., 0.}, 1.), 1.);
+    fvx.add(make_particle(1.0, {0.5, 0., 0.}, 1.), 2.);
+    fvx.add(make_particle(1.9, {-0.5, 0., 0.}, 1.), 4.);
+    fvx.add(make_particle(2.0, {-0.5, 0., 0.}, 1.), 8.);
+
+    if (fvx.values() != std::vector<double>{4., 2.})
+        throw std::runtime_error("histogram window must count particles in [xmin, xmax[ only");
+}
+
+
+// energies, momentum and histograms are appended to reduced.h5 once per write
+void time_series()
+{
+    std::cout << "Running time_series test...\n";
+    auto layout = make_layout();
+
+    std::vector<Population<dimension>> populations;
+    populations.emplace_back("protons", layout);
+    auto& particles = populations[0].particles();
+    particles.push_back(make_particle(0.2, {0.5, -1.0, 0.}, 2.0));
+    particles.push_back(make_particle(3.1, {-0.25, 0., 2.0}, 1.0, 4.0));
+
+    VecField<dimension> E{layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
+    VecField<dimension> B{layout, {Quantity::Bx, Quantity::By, Quantity::Bz}};
+    for (auto& node : B.y)
+        node = 1.0;
+
+    std::string const prefix = "test_reduced_";
+    ReducedDiagnostics<dimension> reduced{layout, {"protons"}, prefix};
+    reduced.add_histogram("protons", VelocityHistogram{"fvx", {0}, {2}, {-1.}, {1.}});
+    reduced.add_histogram("protons", VelocityHistogram{"fvx_left", {0}, {2}, {-1.}, {1.},
+                                                       std::array<double, 2>{0., 1.}});
+
+    // weights are densities, a particle counts weight * dx physical particles
+    reduced.compute(populations, E, B);
+    auto const kinetic   = 0.5 * 2.0 * cell_size * 1.25 + 0.5 * 4.0 * cell_size * 4.0625;
+    auto const magnetic  = 0.5 * nbr_cells * cell_size;
+    auto const& momentum = reduced.momentum(0);
+    if (!close(reduced.kinetic_energy(0), kinetic) or !close(reduced.magnetic_energy(), magnetic)
+        or !close(reduced.electric_energy(), 0.) or !close(momentum[0], 0.)
+        or !close(momentum[1], -2.0 * cell_size) or !close(momentum[2], 8.0 * cell_size))
+        throw std::runtime_error("wrong energies or momentum");
+
+    // vx = 0.5 at x = 0.2 and vx = -0.25 at x = 3.1, out of the window of fvx_left
+    auto const& histograms = reduced.histograms(0);
+    if (histograms[0].values() != std::vector<double>{cell_size, 2. * cell_size}
+        or histograms[1].values() != std::vector<double>{0., 2. * cell_size})
+        throw std::runtime_error("wrong histograms of the population");
+    reduced.write(0., HighFive::File::Truncate);
+
+    for (auto& particle : particles)
+        particle.v = {0., 0., 0.};
+    reduced.compute(populations, E, B);
+    if (!close(reduced.kinetic_energy(0), 0.) or !close(reduced.total_energy(), magnetic)
+        or !close(reduced.energy_drift(), kinetic / (kinetic + magnetic)))
+        throw std::runtime_error("wrong energies once at rest");
+    reduced.write(0.5);
+
+    // one row per write, one column per value
+    HighFive::File file(prefix + "reduced.h5", HighFive::File::ReadOnly);
+    for (auto const& [name, columns] : std::vector<std::pair<std::string, std::size_t>>{
+             {"/time", 1},
+             {"/energy/magnetic", 1},
+             {"/energy/total", 1},
+             {"/protons/kinetic_energy", 1},
+             {"/protons/momentum", 3},
+             {"/protons/fvx", 2},
+             {"/protons/fvx_left", 2}})
+        if (file.getDataSet(name).getDimensions() != std::vector<std::size_t>{2, columns})
+            throw std::runtime_error("wrong shape of the time series " + name);
+}
+
+
+int main()
+{
+    histogram_binning();
+    histogram_window();
+    time_series();
+}
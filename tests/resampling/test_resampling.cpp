@@ -0,0 +1,168 @@
+#include "resampling.hpp"
+#include "population.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+std::size_t constexpr dimension = 1;
+std::size_t constexpr nbr_cells = 8;
+double constexpr cell_size      = 0.5;
+
+
+auto make_layout()
+{
+    return std::make_shared<GridLayout<dimension>>(std::array<std::size_t, dimension>{nbr_cells},
+                                                   std::array<double, dimension>{cell_size}, 1);
+}
+
+
+// what resampling a cell must conserve
+struct CellMoments
+{
+    std::size_t count = 0;
+    double weight     = 0.;
+    std::array<double, 3> momentum{0., 0., 0.};
+    double energy = 0.;
+};
+
+
+auto cell_moments(ParticleArray<dimension> const& particles)
+{
+    std::vector<CellMoments> cells(nbr_cells);
+    for (auto const& particle : particles)
+    {
+        auto& cell = cells[static_cast<std::size_t>(particle.position[0] / cell_size)];
+        ++cell.count;
+        cell.weight += particle.weight;
+        for (std::size_t iComp = 0; iComp < 3; ++iComp)
+        {
+            cell.momentum[iComp] += particle.weight * particle.v[iComp];
+            cell.energy += 0.5 * particle.weight * particle.v[iComp] * particle.v[iComp];
+        }
+    }
+    return cells;
+}
+
+
+void check_conserved(std::vector<CellMoments> const& before,
+                     std::vector<CellMoments> const& after)
+{
+    auto const close = [](double a, double b) {
+        return std::abs(a - b) <= 1e-12 * (1. + std::abs(b));
+    };
+    for (std::size_t iCell = 0; iCell < nbr_cells; ++iCell)
+    {
+        auto const& b = before[iCell];
+        auto const& a = after[iCell];
+        if (!close(a.weight, b.weight) or !close(a.energy, b.energy))
+            throw std::runtime_error("resampling changed the weight or the energy of a cell");
+        for (std::size_t iComp = 0; iComp < 3; ++iComp)
+            if (!close(a.momentum[iComp], b.momentum[iComp]))
+                throw std::runtime_error("resampling changed the momentum of a cell");
+    }
+}
+
+
+void check_sorted_by_id(ParticleArray<dimension> const& particles)
+{
+    for (std::size_t iPart = 1; iPart < particles.size(); ++iPart)
+        if (particles[iPart].id <= particles[iPart - 1].id)
+            throw std::runtime_error("resampling broke the id order");
+}
+
+
+// cells from 3 to 400 particles with random weights, out of the band on both sides
+void cells_end_in_band()
+{
+    std::cout << "Running cells_end_in_band test...\n";
+    auto const layout = make_layout();
+    Population<dimension> population{"protons", layout};
+    Resampler<dimension> resample{layout, 20, 60};
+
+    std::mt19937_64 generator{5};
+    std::uniform_real_distribution<> uniform{0., 1.};
+    std::normal_distribution<> normal{0., 0.3};
+    std::array<std::size_t, nbr_cells> const counts{3, 400, 40, 19, 61, 150, 1, 0};
+    for (std::size_t iCell = 0; iCell < nbr_cells; ++iCell)
+    {
+        for (std::size_t iPart = 0; iPart < counts[iCell]; ++iPart)
+        {
+            Particle<dimension> particle{};
+            particle.position[0] = (iCell + uniform(generator)) * cell_size;
+            particle.v           = {0.5 + normal(generator), normal(generator), normal(generator)};
+            particle.weight      = uniform(generator);
+            particle.mass        = 1.;
+            particle.charge      = 1.;
+            population.particles().push_back(particle);
+        }
+    }
+    // cells are interleaved in the array
+    std::shuffle(population.particles().begin(), population.particles().end(), generator);
+    for (auto& particle : population.particles())
+        particle.id = population.new_particle_id();
+
+    auto const before = cell_moments(population.particles());
+    resample(population);
+    auto const after = cell_moments(population.particles());
+
+    check_conserved(before, after);
+    check_sorted_by_id(population.particles());
+    for (std::size_t iCell = 0; iCell < nbr_cells; ++iCell)
+    {
+        auto const count    = after[iCell].count;
+        auto const expected = (counts[iCell] == 0 or (counts[iCell] >= 20 and counts[iCell] <= 60))
+                                  ? counts[iCell]
+                                  : 40;
+        if (count != expected)
+            throw std::runtime_error("cell " + std::to_string(iCell) + " has "
+                                     + std::to_string(count) + " particles after resampling");
+    }
+}
+
+
+// three cold beams in one cell must stay three beams after merging
+void merging_keeps_beams_apart()
+{
+    std::cout << "Running merging_keeps_beams_apart test...\n";
+    auto const layout = make_layout();
+    Population<dimension> population{"protons", layout};
+    Resampler<dimension> resample{layout, 10, 30};
+
+    std::mt19937_64 generator{7};
+    std::normal_distribution<> normal{0., 0.01};
+    for (std::size_t iPart = 0; iPart < 300; ++iPart)
+    {
+        Particle<dimension> particle{};
+        particle.position[0] = 2.2;
+        particle.v = {iPart % 3 - 1. + normal(generator), normal(generator), normal(generator)};
+        particle.weight      = 0.01;
+        particle.id          = population.new_particle_id();
+        population.particles().push_back(particle);
+    }
+
+    auto const before = cell_moments(population.particles());
+    resample(population);
+    check_conserved(before, cell_moments(population.particles()));
+
+    if (population.particles().size() != 20)
+        throw std::runtime_error("the crowded cell was not brought to the middle of the band");
+    for (auto const& particle : population.particles())
+        if (std::abs(particle.v[0] - std::round(particle.v[0])) > 0.1)
+            throw std::runtime_error("merging mixed the beams");
+}
+
+
+int main()
+{
+    cells_end_in_band();
+    merging_keeps_beams_apart();
+}
@@ -0,0 +1,151 @@
+#include "time_step.hpp"
+#include "simulation.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <numbers>
+#include <stdexcept>
+
+
+std::size_t constexpr dimension = 1;
+std::size_t constexpr nbr_cells = 32;
+double constexpr cell_size      = 0.2;
+
+
+auto make_layout()
+{
+    return std::make_shared<GridLayout<dimension>>(std::array<std::size_t, dimension>{nbr_cells},
+                                                   std::array<double, dimension>{cell_size}, 1);
+}
+
+
+// the particle limit is a cell per step, the whistler one resolves k = pi / dx with the
+// strongest field and the lightest plasma
+void limits_follow_the_state()
+{
+    std::cout << "Running limits_follow_the_state test...\n";
+    auto const layout = make_layout();
+    TimeStepController<dimension> controller{layout, 0.01, 0.5, 1e-5, 0.1};
+
+    VecField<dimension> B{layout, {Quantity::Bx, Quantity::By, Quantity::Bz}};
+    Field<dimension> N{layout->allocate(Quantity::N), Quantity::N};
+    for (auto& n : N)
+        n = 2.;
+    N(5)   = 0.5;
+    B.x(3) = 0.6;
+    B.y(7) = -0.8;
+
+    if (std::abs(controller.particle_limit(4.) - cell_size / 4.) > 1e-15
+        or !std::isinf(controller.particle_limit(0.)))
+        throw std::runtime_error("wrong particle limit");
+    auto const expected = cell_size * cell_size * 0.5 / std::numbers::pi;
+    if (std::abs(controller.whistler_limit(B, N) - expected) > 1e-15)
+        throw std::runtime_error("wrong whistler limit");
+
+    for (auto& n : N)
+        n = 0.;
+    if (!std::isinf(controller.whistler_limit(B, N)))
+        throw std::runtime_error("no plasma must not limit the time step");
+}
+
+
+// dt drops at once to the limit, holds while the limit stays within the hysteresis band,
+// then grows by max_growth per step up to max_dt; a limit below min_dt stops the run
+void dt_has_hysteresis()
+{
+    std::cout << "Running dt_has_hysteresis test...\n";
+    auto const layout = make_layout();
+    TimeStepController<dimension> controller{layout, 0.01, 1., 1e-3, 0.02, 1.5, 1.2};
+    VecField<dimension> B{layout, {Quantity::Bx, Quantity::By, Quantity::Bz}};
+    Field<dimension> N{layout->allocate(Quantity::N), Quantity::N};
+    auto const speed_for = [](double limit) { return cell_size / limit; };
+
+    if (controller.update(speed_for(0.005), B, N) != 0.005)
+        throw std::runtime_error("dt must shrink to the limit at once");
+    if (controller.update(speed_for(0.007), B, N) != 0.005)
+        throw std::runtime_error("dt must hold within the hysteresis band");
+    if (std::abs(controller.update(speed_for(1.), B, N) - 0.006) > 1e-15)
+        throw std::runtime_error("dt must grow by max_growth at most");
+    for (int iStep = 0; iStep < 20; ++iStep)
+        controller.update(0., B, N);
+    if (controller.dt() != 0.02)
+        throw std::runtime_error("dt must stop at max_dt");
+
+    bool stopped = false;
+    try
+    {
+        controller.update(speed_for(1e-4), B, N);
+    }
+    catch (std::runtime_error const&)
+    {
+        stopped = true;
+    }
+    if (!stopped)
+        throw std::runtime_error("a limit below min_dt must stop the run");
+}
+
+
+// the particle limit takes the fastest particle of all the pushes of a step, i.e. of all the
+// populations, and starts again from zero at the next step
+void max_speed_spans_the_pushes()
+{
+    std::cout << "Running max_speed_spans_the_pushes test...\n";
+    auto const layout = make_layout();
+    VecField<dimension> E{layout, {Quantity::Ex, Quantity::Ey, Quantity::Ez}};
+    VecField<dimension> B{layout, {Quantity::Bx, Quantity::By, Quantity::Bz}};
+    Boris<dimension> push{layout, 0.01};
+
+    auto const particles_at = [](double vx) {
+        ParticleArray<dimension> particles(3, Particle<dimension>{});
+        for (auto& particle : particles)
+            particle.position[0] = 1.;
+        particles[1].v[0] = vx;
+        return particles;
+    };
+    auto fast = particles_at(-3.);
+    auto slow = particles_at(0.5);
+
+    push.reset_max_speed();
+    push(fast, E, B);
+    push(slow, E, B);
+    if (push.max_speed() != 3. or push.nbr_pushed() != 6)
+        throw std::runtime_error("the max speed must span all the pushes of the step");
+    push.reset_max_speed();
+    if (push.max_speed() != 0. or push.nbr_pushed() != 0)
+        throw std::runtime_error("the max speed must start again at each step");
+}
+
+
+// with nothing to limit it dt grows, and the run still ends exactly at final_time
+void run_lands_on_final_time()
+{
+    std::cout << "Running run_lands_on_final_time test...\n";
+    SimulationParameters params;
+    params.nbr_cells                  = nbr_cells;
+    params.cell_size                  = cell_size;
+    params.dt                         = 0.001;
+    params.final_time                 = 0.0537;
+    params.verbose                    = false;
+    params.populations[0].nppc        = 10;
+    params.time_step.adaptive         = true;
+    params.diagnostics.spectral_every = 3;
+
+    Simulation<1, Boris<1>, PeriodicBoundaryCondition<1>> simulation{params};
+    simulation.run();
+    if (simulation.time() != params.final_time)
+        throw std::runtime_error("the run did not end at final_time");
+    if (simulation.dt() <= params.dt)
+        throw std::runtime_error("dt did not grow");
+}
+
+
+int main()
+{
+    limits_follow_the_state();
+    dt_has_hysteresis();
+    max_speed_spans_the_pushes();
+    run_lands_on_final_time();
+}
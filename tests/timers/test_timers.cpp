@@ -0,0 +1,111 @@
+#include "timers.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+
+void wait_ms(int milliseconds)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+
+// outer { inner { } } twice: the total of outer includes inner, its self time does not
+void nested_scopes()
+{
+    std::cout << "Running nested_scopes test...\n";
+    auto& timers     = Timers::instance();
+    auto const outer = timers.phase_id("test_outer");
+    auto const inner = timers.phase_id("test_inner");
+    timers.reset();
+
+    for (int iCall = 0; iCall < 2; ++iCall)
+    {
+        ScopedTimer const outer_timer{outer};
+        wait_ms(5);
+        {
+            ScopedTimer const inner_timer{inner};
+            wait_ms(10);
+        }
+    }
+
+    auto const stats = timers.summary();
+    auto const& o    = stats[outer];
+    auto const& i    = stats[inner];
+    if (o.count != 2 or i.count != 2)
+        throw std::runtime_error("wrong number of calls");
+    if (i.self != i.total or o.self + i.total != o.total)
+        throw std::runtime_error("self time of a phase must leave out its nested phases");
+    if (o.self < 10'000'000 or i.total < 20'000'000)
+        throw std::runtime_error("timers shorter than the scopes they timed");
+}
+
+
+// the % column shares the self times, so it adds up to 100 with nested phases
+void report()
+{
+    std::cout << "Running report test...\n";
+    std::ostringstream out;
+    Timers::instance().print_summary(out);
+
+    std::istringstream lines{out.str()};
+    std::string line;
+    std::getline(lines, line);
+    if (line.find("self (s)") == std::string::npos)
+        throw std::runtime_error("report without a self time column");
+
+    double percent_sum = 0.;
+    std::size_t rows   = 0;
+    while (std::getline(lines, line))
+    {
+        percent_sum += std::stod(line.substr(line.find_last_of(' ') + 1));
+        ++rows;
+    }
+    if (rows != 2 or std::abs(percent_sum - 100.) > 0.2)
+        throw std::runtime_error("report percentages add up to " + std::to_string(percent_sum));
+}
+
+
+// events are recorded only while tracing, from any thread
+void trace()
+{
+    std::cout << "Running trace test...\n";
+    auto& timers     = Timers::instance();
+    auto const phase = timers.phase_id("test_traced");
+    timers.reset();
+
+    auto const time_scope = [phase]() { ScopedTimer const timer{phase}; };
+    time_scope();
+    timers.enable_trace();
+    std::thread worker{time_scope};
+    worker.join();
+    time_scope();
+    timers.enable_trace(false);
+
+    std::string const filename = "test_timers_trace.json";
+    timers.write_chrome_trace(filename);
+    std::ifstream file{filename};
+    std::string const json{std::istreambuf_iterator<char>{file}, {}};
+
+    std::size_t events = 0;
+    for (auto at = json.find("\"test_traced\""); at != std::string::npos; ++events)
+        at = json.find("\"test_traced\"", at + 1);
+    if (events != 2 or timers.summary()[phase].count != 3)
+        throw std::runtime_error("trace must hold the scopes timed while tracing only");
+}
+
+
+int main()
+{
+    nested_scopes();
+    report();
+    trace();
+}
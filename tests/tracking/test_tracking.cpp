@@ -0,0 +1,129 @@
+#include "diagnostics.hpp"
+#include "population.hpp"
+
+#include "highfive/highfive.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+std::size_t constexpr dimension = 1;
+std::size_t constexpr nbr_cells = 10;
+double constexpr cell_size      = 0.5;
+
+
+auto make_population()
+{
+    auto layout = std::make_shared<GridLayout<dimension>>(
+        std::array<std::size_t, dimension>{nbr_cells}, std::array<double, dimension>{cell_size},
+        1);
+    std::vector<Population<dimension>> populations;
+    populations.emplace_back("protons", layout);
+    auto& particles = populations[0].particles();
+    for (std::size_t id = 0; id < 8; ++id)
+        particles.push_back({{0.5 * id}, {0.1 * id, 0., 0.}, 1., 0., 1., 1., id});
+    return populations;
+}
+
+
+// removes a particle the way boundaries do, the last one takes its place
+void remove_particle(Population<dimension>& population, std::size_t id)
+{
+    auto& particles = population.particles();
+    for (std::size_t iPart = 0; iPart < particles.size(); ++iPart)
+    {
+        if (particles[iPart].id == id)
+        {
+            particles[iPart] = particles.back();
+            particles.pop_back();
+            return;
+        }
+    }
+}
+
+
+// tracked indexes follow the particles when the array is reordered, and the particles
+// removed are marked lost
+void follow_particles()
+{
+    std::cout << "Running follow_particles test...\n";
+    auto populations = make_population();
+    auto& population = populations[0];
+    population.track([](auto const& particle) { return particle.id % 2 == 0; });
+    if (population.tracked_ids() != std::vector<std::size_t>{0, 2, 4, 6})
+        throw std::runtime_error("wrong particles tracked");
+
+    remove_particle(population, 2);
+    population.update_tracked();
+    auto& particles     = population.particles();
+    auto const& tracked = population.tracked();
+    for (std::size_t iTrack = 0; iTrack < tracked.size(); ++iTrack)
+    {
+        auto const id = population.tracked_ids()[iTrack];
+        if ((id == 2) != (tracked[iTrack] == Population<dimension>::lost_particle))
+            throw std::runtime_error("removed particle not marked lost");
+        if (id != 2 and particles[tracked[iTrack]].id != id)
+            throw std::runtime_error("tracked index points to the wrong particle");
+    }
+
+    // ids tracked before their particle is in the population are found once it arrives
+    population.track_ids({7, 9});
+    particles.push_back({{1.}, {0., 0., 0.}, 1., 0., 1., 1., 9});
+    population.find_tracked_from(particles.size() - 1);
+    if (particles[tracked[0]].id != 7 or tracked[1] != particles.size() - 1)
+        throw std::runtime_error("tracked ids not found in the population");
+}
+
+
+// one row per write in files kept open between writes, lost particles are NaN and
+// /lost_time tells when each left
+void write_tracked()
+{
+    std::cout << "Running write_tracked test...\n";
+    auto populations = make_population();
+    auto& population = populations[0];
+    population.track([](auto const& particle) { return particle.id < 3; });
+
+    std::string const prefix = "test_tracking_";
+    {
+        TrackedDiagnostics tracked{prefix};
+        tracked.write(populations, 0., HighFive::File::Truncate);
+        remove_particle(population, 1);
+        tracked.write(populations, 0.5);
+        remove_particle(population, 0);
+        tracked.write(populations, 1.0);
+
+        auto const& lost_times = tracked.lost_times("protons");
+        if (lost_times.size() != 3 or lost_times[0] != 1.0 or lost_times[1] != 0.5
+            or !std::isnan(lost_times[2]))
+            throw std::runtime_error("wrong times of loss");
+
+        // a truncated file restarts the time series and the losses
+        tracked.write(populations, 0., HighFive::File::Truncate);
+        if (tracked.lost_times("protons")[1] != 0.)
+            throw std::runtime_error("truncate must restart the tracked file");
+        tracked.write(populations, 0.5);
+    }
+
+    HighFive::File file(prefix + "tracked_protons.h5", HighFive::File::ReadOnly);
+    for (auto const& [name, columns] : std::vector<std::pair<std::string, std::size_t>>{
+             {"/time", 1}, {"/x", 3}, {"/vx", 3}, {"/vy", 3}, {"/vz", 3}})
+        if (file.getDataSet(name).getDimensions() != std::vector<std::size_t>{2, columns})
+            throw std::runtime_error("wrong shape of the time series " + name);
+    if (file.getDataSet("/lost_time").getDimensions() != std::vector<std::size_t>{3})
+        throw std::runtime_error("wrong shape of /lost_time");
+}
+
+
+int main()
+{
+    follow_particles();
+    write_tracked();
+}